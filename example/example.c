@@ -286,10 +286,7 @@ void handle_event(struct wiimote_t* wm) {
 	} else if (wm->exp.type == EXP_WII_BOARD) {
 		/* wii balance board */
 		struct wii_board_t* wb = (wii_board_t*)&wm->exp.wb;
-		float total = wb->tl + wb->tr + wb->bl + wb->br;
-		float x = ((wb->tr + wb->br) / total) * 2 - 1;
-		float y = ((wb->tl + wb->tr) / total) * 2 - 1;
-		printf("Weight: %f kg @ (%f, %f)\n", total, x, y);
+		printf("Weight: %f kg @ (%f, %f)\n", wb->total, wb->cop_x, wb->cop_y);
 		printf("Interpolated weight: TL:%f  TR:%f  BL:%f  BR:%f\n", wb->tl, wb->tr, wb->bl, wb->br);
 		printf("Raw: TL:%d  TR:%d  BL:%d  BR:%d\n", wb->rtl, wb->rtr, wb->rbl, wb->rbr); 
 	}
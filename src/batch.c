@@ -0,0 +1,312 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Batched decoding of reports from many wiimotes.
+ *
+ *	Instead of pushing every report through its own wiimote_t, a block
+ *	of raw reports is decoded into structure-of-arrays planes.  Unpacking
+ *	the report bytes is done in a single scalar pass; the calibration
+ *	math then runs over whole planes with the SIMD kernels.
+ */
+
+#include "wiiuse_internal.h"
+#include "dynamics.h" /* for calculate_gforce_plane */
+#include "ir.h"       /* for decode_basic_ir, decode_extended_ir */
+#include "simd.h"     /* for WIIUSE_SIMD_ALIGN */
+
+#include <stdlib.h> /* for malloc */
+#include <string.h> /* for memset */
+
+/* scratch planes: raw accel, zero calibration and 1g calibration, x/y/z each */
+#define BATCH_SCRATCH_PLANES 9
+
+/* round a plane size up so every plane starts on its own cache line */
+#define BATCH_PLANE_SIZE(capacity, type)                                                                     \
+    (((capacity) * sizeof(type) + WIIUSE_SIMD_ALIGN - 1) & ~(size_t)(WIIUSE_SIMD_ALIGN - 1))
+
+/**
+ *	@brief Carve the next plane out of the batch memory block.
+ */
+static void *batch_take_plane(byte **cursor, size_t size)
+{
+    void *plane = *cursor;
+    *cursor += size;
+    return plane;
+}
+
+/**
+ *	@brief Allocate a batch able to hold \a capacity decoded reports.
+ *
+ *	@param capacity		Maximum number of reports decoded at once.
+ *
+ *	@return A batch to pass to wiiuse_decode_batch(), or NULL on failure.
+ *
+ *	All planes live in a single memory block, each one starting on its
+ *	own cache line.  Release it with wiiuse_batch_free().
+ */
+struct wiiuse_batch_t *wiiuse_batch_alloc(int capacity)
+{
+    struct wiiuse_batch_t *batch;
+    size_t header, size;
+    byte *block, *cursor;
+    int i;
+
+    if (capacity <= 0)
+    {
+        return NULL;
+    }
+
+    header = BATCH_PLANE_SIZE(1, struct wiiuse_batch_t);
+    size   = header;
+    size += BATCH_PLANE_SIZE(capacity, int);
+    size += 2 * BATCH_PLANE_SIZE(capacity, byte);                   /* report, fields */
+    size += BATCH_PLANE_SIZE(capacity, uint16_t);                   /* btns */
+    size += 3 * BATCH_PLANE_SIZE(capacity, byte);                   /* accel */
+    size += 3 * BATCH_PLANE_SIZE(capacity, float);                  /* gforce */
+    size += 8 * BATCH_PLANE_SIZE(capacity, int16_t);                /* ir rx, ry */
+    size += 5 * BATCH_PLANE_SIZE(capacity, byte);                   /* ir size, visible */
+    size += BATCH_SCRATCH_PLANES * BATCH_PLANE_SIZE(capacity, float); /* scratch */
+
+    /* over-allocate so the planes can be aligned regardless of malloc */
+    block = (byte *)malloc(size + WIIUSE_SIMD_ALIGN);
+    if (!block)
+    {
+        WIIUSE_ERROR("Unable to allocate a batch of %i reports.", capacity);
+        return NULL;
+    }
+
+    cursor = (byte *)(((uintptr_t)block + WIIUSE_SIMD_ALIGN) & ~(uintptr_t)(WIIUSE_SIMD_ALIGN - 1));
+    /*
+     * remember where the block really starts, just in front of the aligned
+     * header - malloc alignment guarantees there is room for a pointer
+     */
+    ((byte **)cursor)[-1] = block;
+
+    batch = (struct wiiuse_batch_t *)batch_take_plane(&cursor, header);
+    memset(batch, 0, sizeof(struct wiiuse_batch_t));
+    batch->capacity = capacity;
+
+    batch->wiimote = (int *)batch_take_plane(&cursor, BATCH_PLANE_SIZE(capacity, int));
+    batch->report  = (byte *)batch_take_plane(&cursor, BATCH_PLANE_SIZE(capacity, byte));
+    batch->fields  = (byte *)batch_take_plane(&cursor, BATCH_PLANE_SIZE(capacity, byte));
+    batch->btns    = (uint16_t *)batch_take_plane(&cursor, BATCH_PLANE_SIZE(capacity, uint16_t));
+
+    batch->accel_x = (byte *)batch_take_plane(&cursor, BATCH_PLANE_SIZE(capacity, byte));
+    batch->accel_y = (byte *)batch_take_plane(&cursor, BATCH_PLANE_SIZE(capacity, byte));
+    batch->accel_z = (byte *)batch_take_plane(&cursor, BATCH_PLANE_SIZE(capacity, byte));
+
+    batch->gforce_x = (float *)batch_take_plane(&cursor, BATCH_PLANE_SIZE(capacity, float));
+    batch->gforce_y = (float *)batch_take_plane(&cursor, BATCH_PLANE_SIZE(capacity, float));
+    batch->gforce_z = (float *)batch_take_plane(&cursor, BATCH_PLANE_SIZE(capacity, float));
+
+    for (i = 0; i < 4; ++i)
+    {
+        batch->ir_rx[i]   = (int16_t *)batch_take_plane(&cursor, BATCH_PLANE_SIZE(capacity, int16_t));
+        batch->ir_ry[i]   = (int16_t *)batch_take_plane(&cursor, BATCH_PLANE_SIZE(capacity, int16_t));
+        batch->ir_size[i] = (byte *)batch_take_plane(&cursor, BATCH_PLANE_SIZE(capacity, byte));
+    }
+    batch->ir_visible = (byte *)batch_take_plane(&cursor, BATCH_PLANE_SIZE(capacity, byte));
+
+    batch->scratch =
+        (float *)batch_take_plane(&cursor, BATCH_SCRATCH_PLANES * BATCH_PLANE_SIZE(capacity, float));
+
+    return batch;
+}
+
+/**
+ *	@brief Free a batch allocated by wiiuse_batch_alloc().
+ *
+ *	@param batch		The batch to free, may be NULL.
+ */
+void wiiuse_batch_free(struct wiiuse_batch_t *batch)
+{
+    if (!batch)
+    {
+        return;
+    }
+
+    free(((byte **)batch)[-1]);
+}
+
+/**
+ *	@brief Decode a block of raw reports from many wiimotes.
+ *
+ *	@param wm			An array of pointers to wiimote_t structures.
+ *	@param wiimotes		The number of wiimote_t structures in the \a wm array.
+ *	@param reports		The raw reports to decode.
+ *	@param count		The number of reports.
+ *	@param batch		[out] Batch that receives the decoded data.
+ *
+ *	@return The number of decoded entries, at most the batch capacity.
+ *
+ *	Buttons, acceleration and IR dots are decoded from the data reports
+ *	(0x30 - 0x37) into the planes of \a batch, entry \a i belonging to
+ *	report \a i.  The g-force is calibrated with the accelerometer
+ *	calibration of the sending wiimote.  Reports of unknown wiimotes or
+ *	of other types are kept with no fields set.
+ *
+ *	The wiimote structures are only read, so this does not replace
+ *	wiiuse_poll(): held/released buttons, smoothing and expansions are
+ *	not handled here.
+ */
+int wiiuse_decode_batch(struct wiimote_t **wm, int wiimotes, const struct wiiuse_raw_report_t *reports,
+                        int count, struct wiiuse_batch_t *batch)
+{
+    float *raw[3], *zero[3], *g[3];
+    struct ir_dot_t dot[4];
+    size_t stride;
+    int i, j, plane;
+
+    if (!wm || !reports || !batch || count <= 0)
+    {
+        return 0;
+    }
+
+    if (count > batch->capacity)
+    {
+        WIIUSE_WARNING("Batch too small for %i reports, only decoding %i.", count, batch->capacity);
+        count = batch->capacity;
+    }
+
+    stride = BATCH_PLANE_SIZE(batch->capacity, float) / sizeof(float);
+    for (plane = 0; plane < 3; ++plane)
+    {
+        raw[plane]  = batch->scratch + (plane * 3 + 0) * stride;
+        zero[plane] = batch->scratch + (plane * 3 + 1) * stride;
+        g[plane]    = batch->scratch + (plane * 3 + 2) * stride;
+    }
+
+    /* pass 1: unpack the report bytes */
+    for (i = 0; i < count; ++i)
+    {
+        const struct wiiuse_raw_report_t *rpt = &reports[i];
+        const byte *msg                       = rpt->data + 1;
+        struct wiimote_t *src                 = NULL;
+        const byte *ir                        = NULL;
+        int extended_ir                       = 0;
+        byte fields                           = 0;
+
+        if (rpt->wiimote >= 0 && rpt->wiimote < wiimotes)
+        {
+            src = wm[rpt->wiimote];
+        }
+
+        batch->wiimote[i]    = rpt->wiimote;
+        batch->report[i]     = rpt->data[0];
+        batch->btns[i]       = 0;
+        batch->ir_visible[i] = 0;
+
+        /* no acceleration: normalize 0 to 0 */
+        batch->accel_x[i] = batch->accel_y[i] = batch->accel_z[i] = 0;
+        raw[0][i] = raw[1][i] = raw[2][i] = 0.0f;
+        zero[0][i] = zero[1][i] = zero[2][i] = 0.0f;
+        g[0][i] = g[1][i] = g[2][i] = 1.0f;
+
+        if (src && rpt->data[0] >= WM_RPT_BTN && rpt->data[0] <= WM_RPT_BTN_ACC_IR_EXP)
+        {
+            batch->btns[i] = from_big_endian_uint16_t((byte *)msg) & WIIMOTE_BUTTON_ALL;
+            fields |= WIIUSE_BATCH_BUTTONS;
+
+            switch (rpt->data[0])
+            {
+            case WM_RPT_BTN_ACC:
+            case WM_RPT_BTN_ACC_EXP:
+                fields |= WIIUSE_BATCH_ACCEL;
+                break;
+            case WM_RPT_BTN_ACC_IR:
+                fields |= WIIUSE_BATCH_ACCEL;
+                ir          = msg + 5;
+                extended_ir = 1;
+                break;
+            case WM_RPT_BTN_IR_EXP:
+                ir = msg + 2;
+                break;
+            case WM_RPT_BTN_ACC_IR_EXP:
+                fields |= WIIUSE_BATCH_ACCEL;
+                ir = msg + 5;
+                break;
+            default:
+                break;
+            }
+        }
+
+        if (fields & WIIUSE_BATCH_ACCEL)
+        {
+            batch->accel_x[i] = msg[2];
+            batch->accel_y[i] = msg[3];
+            batch->accel_z[i] = msg[4];
+
+            raw[0][i]  = (float)msg[2];
+            raw[1][i]  = (float)msg[3];
+            raw[2][i]  = (float)msg[4];
+            zero[0][i] = (float)src->accel_calib.cal_zero.x;
+            zero[1][i] = (float)src->accel_calib.cal_zero.y;
+            zero[2][i] = (float)src->accel_calib.cal_zero.z;
+            g[0][i]    = (float)src->accel_calib.cal_g.x;
+            g[1][i]    = (float)src->accel_calib.cal_g.y;
+            g[2][i]    = (float)src->accel_calib.cal_g.z;
+        }
+
+        if (ir)
+        {
+            if (extended_ir)
+            {
+                decode_extended_ir(dot, ir);
+            } else
+            {
+                decode_basic_ir(dot, ir);
+            }
+
+            for (j = 0; j < 4; ++j)
+            {
+                batch->ir_rx[j][i]   = dot[j].rx;
+                batch->ir_ry[j][i]   = dot[j].ry;
+                batch->ir_size[j][i] = dot[j].visible ? dot[j].size : 0;
+                if (dot[j].visible)
+                {
+                    batch->ir_visible[i] |= (byte)(1 << j);
+                }
+            }
+            fields |= WIIUSE_BATCH_IR;
+        } else
+        {
+            for (j = 0; j < 4; ++j)
+            {
+                batch->ir_rx[j][i]   = 0;
+                batch->ir_ry[j][i]   = 0;
+                batch->ir_size[j][i] = 0;
+            }
+        }
+
+        batch->fields[i] = fields;
+    }
+
+    /* pass 2: calibrate all samples at once */
+    calculate_gforce_plane(raw[0], zero[0], g[0], batch->gforce_x, count);
+    calculate_gforce_plane(raw[1], zero[1], g[1], batch->gforce_y, count);
+    calculate_gforce_plane(raw[2], zero[2], g[2], batch->gforce_z, count);
+
+    batch->count = count;
+    return count;
+}
@@ -32,7 +32,7 @@
  */
 
 #include "classic.h"
-#include "dynamics.h" /* for calc_joystick_state */
+#include "dynamics.h" /* for calc_joystick_state, joystick_build_lut */
 #include "events.h"   /* for handshake_expansion */
 
 #include <stdlib.h> /* for malloc */
@@ -101,6 +101,9 @@ int classic_ctrl_handshake(struct wiimote_t *wm, struct classic_ctrl_t *cc, byte
     cc->rjs.min.y    = data[10] / 8;
     cc->rjs.center.y = data[11] / 8;
 
+    joystick_build_lut(&cc->ljs);
+    joystick_build_lut(&cc->rjs);
+
     /* handshake done */
     wm->exp.type = EXP_CLASSIC;
 
@@ -116,7 +119,12 @@ int classic_ctrl_handshake(struct wiimote_t *wm, struct classic_ctrl_t *cc, byte
  *
  *	@param cc		A pointer to a classic_ctrl_t structure.
  */
-void classic_ctrl_disconnected(struct classic_ctrl_t *cc) { memset(cc, 0, sizeof(struct classic_ctrl_t)); }
+void classic_ctrl_disconnected(struct classic_ctrl_t *cc)
+{
+    joystick_free_lut(&cc->ljs);
+    joystick_free_lut(&cc->rjs);
+    memset(cc, 0, sizeof(struct classic_ctrl_t));
+}
 
 /**
  *	@brief Handle classic controller event.
@@ -148,8 +156,8 @@ void classic_ctrl_event(struct classic_ctrl_t *cc, byte *msg)
     rx = ((msg[0] & 0xC0) >> 3) | ((msg[1] & 0xC0) >> 5) | ((msg[2] & 0x80) >> 7);
     ry = (msg[2] & 0x1F);
 
-    calc_joystick_state(&cc->ljs, (float)lx, (float)ly);
-    calc_joystick_state(&cc->rjs, (float)rx, (float)ry);
+    calc_joystick_state(&cc->ljs, (byte)lx, (byte)ly);
+    calc_joystick_state(&cc->rjs, (byte)rx, (byte)ry);
 }
 
 /**
@@ -0,0 +1,345 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Command queue.
+ *
+ *	The wiiuse_*() functions are not thread safe, they touch the state
+ *	of the wiimote, its request lists and its socket.  The
+ *	wiiuse_submit_*() functions can be called from any thread instead:
+ *	they only put a command in a bounded ring buffer of the wiimote,
+ *	and wiiuse_poll() applies it with the matching wiiuse_*() function.
+ *
+ *	Every slot carries a sequence number that says whose turn it is.
+ *	Producers claim a slot by advancing the tail with a compare and
+ *	swap, and hand it over by bumping its sequence number; the polling
+ *	thread gives it back the same way.  Nobody waits: a producer that
+ *	finds the ring full gets 0 back.
+ */
+
+#include "cmdq.h"
+
+#include <string.h> /* for memcpy */
+
+#if defined(_MSC_VER)
+#include <windows.h> /* for InterlockedCompareExchange, MemoryBarrier */
+
+static long load_acquire(volatile long *p)
+{
+    long v = *p;
+    MemoryBarrier();
+    return v;
+}
+
+static void store_release(volatile long *p, long v)
+{
+    MemoryBarrier();
+    *p = v;
+}
+
+static int compare_and_swap(volatile long *p, long expected, long desired)
+{
+    return InterlockedCompareExchange(p, desired, expected) == expected;
+}
+
+#elif defined(__ATOMIC_ACQUIRE)
+
+static long load_acquire(volatile long *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+
+static void store_release(volatile long *p, long v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+static int compare_and_swap(volatile long *p, long expected, long desired)
+{
+    return __atomic_compare_exchange_n(p, &expected, desired, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+#elif defined(__GNUC__)
+
+static long load_acquire(volatile long *p)
+{
+    long v = *p;
+    __sync_synchronize();
+    return v;
+}
+
+static void store_release(volatile long *p, long v)
+{
+    __sync_synchronize();
+    *p = v;
+}
+
+static int compare_and_swap(volatile long *p, long expected, long desired)
+{
+    return __sync_bool_compare_and_swap(p, expected, desired);
+}
+
+#else
+#error "No atomic operations known for this compiler."
+#endif
+
+#define CMDQ_MASK (WIIUSE_CMDQ_LEN - 1)
+
+/**
+ *	@brief Add to a sequence number, wrapping around instead of overflowing.
+ */
+static long seq_add(long seq, unsigned long n) { return (long)((unsigned long)seq + n); }
+
+/**
+ *	@brief Put a command in the queue, from any thread.
+ *
+ *	@return 1 if the command was queued, 0 if the queue is full.
+ */
+static int cmdq_push(struct wiimote_t *wm, const struct cmdq_cmd_t *cmd)
+{
+    struct cmdq_t *q = &wm->cmdq;
+    struct cmdq_cell_t *cell;
+    long pos = load_acquire(&q->tail);
+    long dif;
+
+    for (;;)
+    {
+        cell = &q->cell[(unsigned long)pos & CMDQ_MASK];
+        dif  = (long)((unsigned long)load_acquire(&cell->seq) - (unsigned long)pos);
+
+        if (dif == 0)
+        {
+            /* the slot is free in this turn, claim it */
+            if (compare_and_swap(&q->tail, pos, seq_add(pos, 1)))
+            {
+                break;
+            }
+            pos = load_acquire(&q->tail);
+        } else if (dif < 0)
+        {
+            /* the slot still holds the command of the previous turn */
+            return 0;
+        } else
+        {
+            /* another thread claimed the slot first */
+            pos = load_acquire(&q->tail);
+        }
+    }
+
+    cell->cmd = *cmd;
+    store_release(&cell->seq, seq_add(pos, 1));
+
+    return 1;
+}
+
+/**
+ *	@brief Run a command with the wiiuse_*() function it stands for.
+ */
+static void cmdq_run(struct wiimote_t *wm, struct cmdq_cmd_t *cmd)
+{
+    switch (cmd->type)
+    {
+    case WIIUSE_CMD_LEDS:
+        wiiuse_set_leds(wm, cmd->value);
+        break;
+
+    case WIIUSE_CMD_RUMBLE:
+        wiiuse_rumble(wm, cmd->value);
+        break;
+
+    case WIIUSE_CMD_MOTION_SENSING:
+        wiiuse_motion_sensing(wm, cmd->value);
+        break;
+
+    case WIIUSE_CMD_IR:
+        wiiuse_set_ir(wm, cmd->value);
+        break;
+
+    case WIIUSE_CMD_WRITE:
+        wiiuse_write_data(wm, cmd->addr, cmd->data, (byte)cmd->len);
+        break;
+
+    case WIIUSE_CMD_READ:
+        wiiuse_read_data(wm, cmd->buffer, cmd->addr, cmd->len);
+        break;
+
+    default:
+        WIIUSE_WARNING("Unknown command %i for wiimote id %i.", cmd->type, wm->unid);
+        break;
+    }
+}
+
+/**
+ *	@brief Empty the command queue of a wiimote.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *
+ *	Not thread safe, called by wiiuse_init() before any thread can push.
+ */
+void cmdq_init(struct wiimote_t *wm)
+{
+    int i;
+
+    for (i = 0; i < WIIUSE_CMDQ_LEN; ++i)
+    {
+        wm->cmdq.cell[i].seq = i;
+    }
+    wm->cmdq.tail = 0;
+    wm->cmdq.head = 0;
+}
+
+/**
+ *	@brief Apply the commands other threads pushed, in the order they were pushed.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *
+ *	Called from wiiuse_poll().  At most CMDQ_APPLY_MAX commands are
+ *	applied, the rest wait for the next poll.
+ */
+void cmdq_apply(struct wiimote_t *wm)
+{
+    struct cmdq_t *q = &wm->cmdq;
+    struct cmdq_cmd_t cmd;
+    int n;
+
+    for (n = 0; n < CMDQ_APPLY_MAX; ++n)
+    {
+        struct cmdq_cell_t *cell = &q->cell[(unsigned long)q->head & CMDQ_MASK];
+
+        if (load_acquire(&cell->seq) != seq_add(q->head, 1))
+        {
+            return;
+        }
+
+        /* give the slot back before running, the producers need not wait for the socket */
+        cmd = cell->cmd;
+        store_release(&cell->seq, seq_add(q->head, WIIUSE_CMDQ_LEN));
+        q->head = seq_add(q->head, 1);
+
+        cmdq_run(wm, &cmd);
+    }
+}
+
+/**
+ *	@brief Queue a command that takes one value.
+ */
+static int submit_value(struct wiimote_t *wm, byte type, int value)
+{
+    struct cmdq_cmd_t cmd;
+
+    if (!wm)
+    {
+        return 0;
+    }
+
+    cmd.type  = type;
+    cmd.value = value;
+    return cmdq_push(wm, &cmd);
+}
+
+/**
+ *	@brief	Thread safe wiiuse_set_leds().
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *	@param leds		What LEDs to enable.
+ *
+ *	@return 1 if the command was queued, 0 if the command queue is full.
+ *
+ *	Can be called from any thread, also while another thread is in
+ *	wiiuse_poll().  The command is applied by the next wiiuse_poll().
+ *	The other wiiuse_submit_*() functions work the same way, commands
+ *	to one wiimote are applied in the order they were queued.
+ */
+int wiiuse_submit_leds(struct wiimote_t *wm, int leds) { return submit_value(wm, WIIUSE_CMD_LEDS, leds); }
+
+/**
+ *	@brief	Thread safe wiiuse_rumble(), see wiiuse_submit_leds().
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *	@param status	1 to enable, 0 to disable.
+ */
+int wiiuse_submit_rumble(struct wiimote_t *wm, int status)
+{
+    return submit_value(wm, WIIUSE_CMD_RUMBLE, status);
+}
+
+/**
+ *	@brief	Thread safe wiiuse_motion_sensing(), see wiiuse_submit_leds().
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *	@param status	1 to enable, 0 to disable.
+ */
+int wiiuse_submit_motion_sensing(struct wiimote_t *wm, int status)
+{
+    return submit_value(wm, WIIUSE_CMD_MOTION_SENSING, status);
+}
+
+/**
+ *	@brief	Thread safe wiiuse_set_ir(), see wiiuse_submit_leds().
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *	@param status	1 to enable, 0 to disable.
+ */
+int wiiuse_submit_ir(struct wiimote_t *wm, int status) { return submit_value(wm, WIIUSE_CMD_IR, status); }
+
+/**
+ *	@brief	Thread safe wiiuse_write_data(), see wiiuse_submit_leds().
+ *
+ *	@param wm			Pointer to a wiimote_t structure.
+ *	@param addr			The address to write to.
+ *	@param data			The data to be written, copied into the queue.
+ *	@param len			The length of the block to be written, at most 16.
+ */
+int wiiuse_submit_write(struct wiimote_t *wm, unsigned int addr, const byte *data, byte len)
+{
+    struct cmdq_cmd_t cmd;
+
+    if (!wm || !data || !len || len > sizeof(cmd.data))
+    {
+        return 0;
+    }
+
+    cmd.type = WIIUSE_CMD_WRITE;
+    cmd.addr = addr;
+    cmd.len  = len;
+    memcpy(cmd.data, data, len);
+    return cmdq_push(wm, &cmd);
+}
+
+/**
+ *	@brief	Thread safe wiiuse_read_data(), see wiiuse_submit_leds().
+ *
+ *	@param wm			Pointer to a wiimote_t structure.
+ *	@param buffer		Where the data goes, must stay valid until the WIIUSE_READ_DATA event.
+ *	@param offset		The address to start reading from.
+ *	@param len			The number of bytes to read.
+ */
+int wiiuse_submit_read(struct wiimote_t *wm, byte *buffer, unsigned int offset, uint16_t len)
+{
+    struct cmdq_cmd_t cmd;
+
+    if (!wm || !buffer || !len)
+    {
+        return 0;
+    }
+
+    cmd.type   = WIIUSE_CMD_READ;
+    cmd.addr   = offset;
+    cmd.len    = len;
+    cmd.buffer = buffer;
+    return cmdq_push(wm, &cmd);
+}
@@ -0,0 +1,50 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Command queue.
+ */
+
+#ifndef CMDQ_H_INCLUDED
+#define CMDQ_H_INCLUDED
+
+#include "wiiuse_internal.h"
+
+/* commands applied per wiimote and poll, so a busy producer can not stall wiiuse_poll() */
+#define CMDQ_APPLY_MAX WIIUSE_CMDQ_LEN
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup internal_cmdq Internal: Command queue */
+/** @{ */
+void cmdq_init(struct wiimote_t *wm);
+void cmdq_apply(struct wiimote_t *wm);
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CMDQ_H_INCLUDED */
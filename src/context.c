@@ -0,0 +1,284 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Library context.
+ *
+ *	A context owns everything a set of wiimotes shares: the log targets,
+ *	the memory allocator, the device registry and the rumble timers.
+ *	Contexts share no mutable state, so each can be driven from its own
+ *	thread.  The log macros have no wiimote at hand, they write to the
+ *	context bound to the calling thread, see wiiuse_context_bind().
+ *
+ *	wiiuse_init() and the other functions that take a plain array of
+ *	wiimotes keep using the process wide state.
+ */
+
+#include "context.h"
+
+#include "registry.h" /* for registry_new, registry_free */
+
+#include <stdlib.h> /* for malloc, free */
+#include <string.h> /* for memset */
+
+/* context of the calling thread */
+static WIIUSE_THREAD_LOCAL struct wiiuse_context_t *bound_ctx;
+
+/**
+ *	@brief Output of a log level.
+ *
+ *	@param loglevel		A wiiuse_loglevel.
+ *
+ *	@return The target of the context bound to the calling thread, or
+ *	the one set with wiiuse_set_output().
+ */
+FILE *wiiuse_log_target(int loglevel)
+{
+    return bound_ctx ? bound_ctx->logtarget[loglevel] : logtarget[loglevel];
+}
+
+/**
+ *	@brief Allocate memory with the allocator of a context.
+ *
+ *	@param ctx		The context, or NULL for malloc().
+ *	@param size		Bytes to allocate.
+ */
+void *context_alloc(struct wiiuse_context_t *ctx, size_t size)
+{
+    return ctx ? ctx->allocator.alloc(size, ctx->allocator.user) : malloc(size);
+}
+
+/**
+ *	@brief Release memory of context_alloc().
+ *
+ *	@param ctx		The context, or NULL for free().
+ *	@param ptr		The memory, may be NULL.
+ */
+void context_free(struct wiiuse_context_t *ctx, void *ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    if (ctx)
+    {
+        ctx->allocator.free(ptr, ctx->allocator.user);
+    } else
+    {
+        free(ptr);
+    }
+}
+
+static void *default_alloc(size_t size, void *user)
+{
+    (void)user;
+    return malloc(size);
+}
+
+static void default_free(void *ptr, void *user)
+{
+    (void)user;
+    free(ptr);
+}
+
+/**
+ *	@brief	Create a library context.
+ *
+ *	@param allocator	Allocator for the context and its wiimotes, NULL for malloc().
+ *
+ *	@return The context, or NULL if out of memory.  Free it with
+ *	wiiuse_context_free().
+ *
+ *	The wiimotes of a context live in its registry, see
+ *	wiiuse_context_registry(), and are polled with
+ *	wiiuse_context_poll() or wiiuse_context_update().  All log levels
+ *	go to stderr until wiiuse_context_set_output() is called.
+ */
+struct wiiuse_context_t *wiiuse_context_new(const struct wiiuse_allocator_t *allocator)
+{
+    struct wiiuse_context_t *ctx;
+    struct wiiuse_allocator_t a;
+
+    if (allocator)
+    {
+        if (!allocator->alloc || !allocator->free)
+        {
+            return NULL;
+        }
+        a = *allocator;
+    } else
+    {
+        a.alloc = default_alloc;
+        a.free  = default_free;
+        a.user  = NULL;
+    }
+
+    ctx = (struct wiiuse_context_t *)a.alloc(sizeof(struct wiiuse_context_t), a.user);
+    if (!ctx)
+    {
+        return NULL;
+    }
+
+    memset(ctx, 0, sizeof(struct wiiuse_context_t));
+    ctx->allocator    = a;
+    ctx->logtarget[0] = stderr;
+    ctx->logtarget[1] = stderr;
+    ctx->logtarget[2] = stderr;
+    ctx->logtarget[3] = stderr;
+
+    ctx->registry = registry_new(ctx);
+    if (!ctx->registry)
+    {
+        a.free(ctx, a.user);
+        return NULL;
+    }
+
+    wiiuse_print_banner();
+
+    return ctx;
+}
+
+/**
+ *	@brief	Disconnect and free every wiimote of a context, and the context.
+ *
+ *	@param ctx		The context.
+ */
+void wiiuse_context_free(struct wiiuse_context_t *ctx)
+{
+    struct wiiuse_context_t *prev;
+    struct wiiuse_allocator_t a;
+
+    if (!ctx)
+    {
+        return;
+    }
+
+    prev = wiiuse_context_bind(ctx);
+    registry_free(ctx->registry);
+    wiiuse_context_bind(prev == ctx ? NULL : prev);
+
+    a = ctx->allocator;
+    a.free(ctx, a.user);
+}
+
+/**
+ *	@brief	Specify an alternate FILE stream for a log level of a context.
+ *
+ *	@param ctx			The context.
+ *	@param loglevel		The loglevel, for which the output should be set.
+ *	@param logtarget	A valid, writeable <code>FILE*</code>, or 0, if output should be disabled.
+ */
+void wiiuse_context_set_output(struct wiiuse_context_t *ctx, enum wiiuse_loglevel loglevel, FILE *logtarget)
+{
+    if (ctx)
+    {
+        ctx->logtarget[(int)loglevel] = logtarget;
+    }
+}
+
+/**
+ *	@brief	Bind a context to the calling thread.
+ *
+ *	@param ctx		The context, or NULL to go back to the process wide state.
+ *
+ *	@return The context that was bound before.
+ *
+ *	Only decides where the wiiuse_*() functions called from this thread
+ *	log to.  wiiuse_context_poll() and wiiuse_context_update() bind
+ *	their context while they run.
+ */
+struct wiiuse_context_t *wiiuse_context_bind(struct wiiuse_context_t *ctx)
+{
+    struct wiiuse_context_t *prev = bound_ctx;
+
+    bound_ctx = ctx;
+    return prev;
+}
+
+/**
+ *	@brief	Get the device registry of a context.
+ *
+ *	@param ctx		The context.
+ *
+ *	@return The registry, owned by the context.  Add wiimotes with
+ *	wiiuse_registry_add(), they use the allocator and log targets of
+ *	the context.
+ */
+struct wiiuse_registry_t *wiiuse_context_registry(struct wiiuse_context_t *ctx)
+{
+    return ctx ? ctx->registry : NULL;
+}
+
+/**
+ *	@brief	Poll the wiimotes of a context, see wiiuse_poll().
+ *
+ *	@param ctx		The context.
+ *
+ *	@return Number of wiimotes that had an event.
+ */
+int wiiuse_context_poll(struct wiiuse_context_t *ctx)
+{
+    struct wiiuse_context_t *prev;
+    struct wiimote_t **wm;
+    int wiimotes, evnt;
+
+    wm = wiiuse_registry_devices(wiiuse_context_registry(ctx), &wiimotes);
+    if (!wiimotes)
+    {
+        return 0;
+    }
+
+    prev = wiiuse_context_bind(ctx);
+    evnt = wiiuse_poll(wm, wiimotes);
+    wiiuse_context_bind(prev);
+
+    return evnt;
+}
+
+/**
+ *	@brief	Poll the wiimotes of a context and call back for each event, see wiiuse_update().
+ *
+ *	@param ctx			The context.
+ *	@param callback		Called for each wiimote that had an event.
+ *
+ *	@return Number of wiimotes that had an event.
+ */
+int wiiuse_context_update(struct wiiuse_context_t *ctx, wiiuse_update_cb callback)
+{
+    struct wiiuse_context_t *prev;
+    struct wiimote_t **wm;
+    int wiimotes, evnt;
+
+    wm = wiiuse_registry_devices(wiiuse_context_registry(ctx), &wiimotes);
+    if (!wiimotes)
+    {
+        return 0;
+    }
+
+    prev = wiiuse_context_bind(ctx);
+    evnt = wiiuse_update(wm, wiimotes, callback);
+    wiiuse_context_bind(prev);
+
+    return evnt;
+}
@@ -0,0 +1,59 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Library context.
+ */
+
+#ifndef CONTEXT_H_INCLUDED
+#define CONTEXT_H_INCLUDED
+
+#include "rumble.h"
+#include "wiiuse_internal.h"
+
+/**
+ *	@brief Library context, see wiiuse_context_new().
+ */
+struct wiiuse_context_t
+{
+    FILE *logtarget[4];                  /**< output of each wiiuse_loglevel	*/
+    struct wiiuse_allocator_t allocator; /**< memory of the context and its wiimotes */
+    struct wiiuse_registry_t *registry;  /**< the wiimotes					*/
+    struct rumble_wheel_t wheel;         /**< rumble timers of the wiimotes	*/
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup internal_context Internal: Context */
+/** @{ */
+void *context_alloc(struct wiiuse_context_t *ctx, size_t size);
+void context_free(struct wiiuse_context_t *ctx, void *ptr);
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONTEXT_H_INCLUDED */
@@ -45,11 +45,13 @@
 /* #define WITH_WIIUSE_DEBUG */
 
 extern FILE *logtarget[];
+FILE *wiiuse_log_target(int loglevel);
 
-#define OUTF_ERROR logtarget[0]
-#define OUTF_WARNING logtarget[1]
-#define OUTF_INFO logtarget[2]
-#define OUTF_DEBUG logtarget[3]
+/* the targets of the context bound to the thread, see wiiuse_context_bind(), else logtarget[] */
+#define OUTF_ERROR wiiuse_log_target(0)
+#define OUTF_WARNING wiiuse_log_target(1)
+#define OUTF_INFO wiiuse_log_target(2)
+#define OUTF_DEBUG wiiuse_log_target(3)
 
 /* Error output macros */
 #define WIIUSE_ERROR(fmt, ...)                                       \
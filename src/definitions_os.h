@@ -50,4 +50,11 @@
 #endif
 #endif
 
+/* storage class of a variable each thread has its own copy of */
+#ifdef _MSC_VER
+#define WIIUSE_THREAD_LOCAL __declspec(thread)
+#else
+#define WIIUSE_THREAD_LOCAL __thread
+#endif
+
 #endif /* DEFINITIONS_OS_H_INCLUDED */
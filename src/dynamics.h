@@ -47,10 +47,27 @@ extern "C" {
 /** @defgroup internal_dynamics Internal: Dynamics Functions */
 /** @{ */
 
-void calculate_orientation(struct accel_t *ac, struct vec3b_t *accel, struct orient_t *orient, int smooth);
+/* entries per axis of the joystick tables, raw axes are at most 8 bits */
+#define JOYSTICK_LUT_SIZE 256
+
+/* the accelerometer only corrects the fused orientation when its magnitude is within these (g) */
+#define AHRS_ACCEL_MIN 0.5f
+#define AHRS_ACCEL_MAX 1.5f
+
+
+void calculate_orientation(struct accel_t *ac, struct vec3b_t *accel, struct orient_t *orient, int smooth,
+                           uint64_t ns);
 void calculate_gforce(struct accel_t *ac, struct vec3b_t *accel, struct gforce_t *gforce);
-void calc_joystick_state(struct joystick_t *js, float x, float y);
-void apply_smoothing(struct accel_t *ac, struct orient_t *orient, int type);
+void calculate_gforce_plane(const float *raw, const float *zero, const float *g, float *gforce, int count);
+void calc_joystick_state(struct joystick_t *js, byte x, byte y);
+void joystick_build_lut(struct joystick_t *js);
+void joystick_free_lut(struct joystick_t *js);
+void apply_smoothing(struct accel_t *ac, struct orient_t *orient, int type, float dt);
+void accel_build_orient_lut(struct accel_t *ac);
+void accel_free_orient_lut(struct accel_t *ac);
+void quat_from_gforce(struct quat_t *q, const struct gforce_t *g);
+void quat_to_orient(const struct quat_t *q, struct orient_t *orient);
+void ahrs_update(struct quat_t *q, float beta, const float gyro[3], const struct gforce_t *accel, float dt);
 /** @} */
 
 #ifdef __cplusplus
@@ -38,15 +38,19 @@
 #include "events.h"
 
 #include "classic.h"       /* for classic_ctrl_disconnected, etc */
+#include "cmdq.h"          /* for cmdq_apply */
 #include "dynamics.h"      /* for calculate_gforce, etc */
 #include "guitar_hero_3.h" /* for guitar_hero_3_disconnected, etc */
 #include "io.h"            /* for wiiuse_read_data_sync, etc */
 #include "ir.h"            /* for calculate_basic_ir, etc */
 #include "motion_plus.h"   /* for motion_plus_disconnected, etc */
 #include "nunchuk.h"       /* for nunchuk_disconnected, etc */
+#include "outqueue.h"      /* for outqueue_pump */
+#include "rumble.h"        /* for rumble_pump */
+#include "speaker.h"       /* for speaker_pump */
 #include "wiiboard.h"      /* for wii_board_disconnected, etc */
 
-#include "os.h" /* for wiiuse_os_poll */
+#include "os.h" /* for wiiuse_os_poll, wiiuse_os_ticks */
 
 #include <stdio.h>  /* for printf, perror */
 #include <stdlib.h> /* for free, malloc */
@@ -71,15 +75,43 @@ static int state_changed(struct wiimote_t *wm);
  *	It is necessary to poll the wiimote devices for events
  *	that occur.  If an event occurs on a particular wiimote,
  *	the event variable will be set.
+ *
+ *	Speaker audio that has become due is sent as well, see
+ *	wiiuse_speaker_deadline().  Report type changes caused by the
+ *	reports of this poll are sent once, at the end, and output reports
+ *	held back by the rate limit go out as it allows.
  */
-int wiiuse_poll(struct wiimote_t **wm, int wiimotes) { return wiiuse_os_poll(wm, wiimotes); }
+int wiiuse_poll(struct wiimote_t **wm, int wiimotes)
+{
+    int evnt = wiiuse_os_poll(wm, wiimotes);
+    unsigned long ticks;
+    int i;
+
+    if (!wm)
+    {
+        return evnt;
+    }
+
+    /* apply the commands of other threads, send the reports, audio and rumble switches that are due */
+    ticks = wiiuse_os_ticks();
+    for (i = 0; i < wiimotes; ++i)
+    {
+        cmdq_apply(wm[i]);
+        outqueue_pump(wm[i], ticks);
+        wiiuse_flush_output(wm[i]);
+        speaker_pump(wm[i], ticks);
+        rumble_pump(wm[i], ticks);
+    }
+
+    return evnt;
+}
 
 int wiiuse_update(struct wiimote_t **wiimotes, int nwiimotes, wiiuse_update_cb callback)
 {
     int evnt = 0;
     if (wiiuse_poll(wiimotes, nwiimotes))
     {
-        static struct wiimote_callback_data_t s;
+        struct wiimote_callback_data_t s;
         int i = 0;
         for (; i < nwiimotes; ++i)
         {
@@ -102,6 +134,7 @@ int wiiuse_update(struct wiimote_t **wiimotes, int nwiimotes, wiiuse_update_cb c
                 s.event            = wiimotes[i]->event;
                 s.state            = wiimotes[i]->state;
                 s.expansion        = wiimotes[i]->exp;
+                s.report_ns        = wiimotes[i]->report_ns;
                 callback(&s);
                 evnt++;
                 break;
@@ -118,23 +151,6 @@ int wiiuse_update(struct wiimote_t **wiimotes, int nwiimotes, wiiuse_update_cb c
  */
 void idle_cycle(struct wiimote_t *wm)
 {
-    /*
-     *	Smooth the angles.
-     *
-     *	This is done to make sure that on every cycle the orientation
-     *	angles are smoothed.  Normally when an event occurs the angles
-     *	are updated and smoothed, but if no packet comes in then the
-     *	angles remain the same.  This means the angle wiiuse reports
-     *	is still an old value.  Smoothing needs to be applied in this
-     *	case in order for the angle it reports to converge to the true
-     *	angle of the device.
-     */
-    if (WIIUSE_USING_ACC(wm) && WIIMOTE_IS_FLAG_SET(wm, WIIUSE_SMOOTHING))
-    {
-        apply_smoothing(&wm->accel_calib, &wm->orient, SMOOTH_ROLL);
-        apply_smoothing(&wm->accel_calib, &wm->orient, SMOOTH_PITCH);
-    }
-
     /* clear out any old read requests */
     clear_dirty_reads(wm);
 }
@@ -172,7 +188,7 @@ static void handle_wm_accel(struct wiimote_t *wm, byte *msg)
 
     /* calculate the remote orientation */
     calculate_orientation(&wm->accel_calib, &wm->accel, &wm->orient,
-                          WIIMOTE_IS_FLAG_SET(wm, WIIUSE_SMOOTHING));
+                          WIIMOTE_IS_FLAG_SET(wm, WIIUSE_SMOOTHING), wm->report_ns);
 
     /* calculate the gforces on each axis */
     calculate_gforce(&wm->accel_calib, &wm->accel, &wm->gforce);
@@ -189,6 +205,21 @@ static void handle_wm_accel(struct wiimote_t *wm, byte *msg)
  */
 void propagate_event(struct wiimote_t *wm, byte event, byte *msg)
 {
+    /* the platform stamped the report as it arrived */
+    wm->report_ticks = (unsigned long)(wm->report_ns / 1000000);
+
+    wm->reports++;
+    if (wm->report_ns - wm->rate_ns >= WIIMOTE_RATE_WINDOW_NS)
+    {
+        if (wm->rate_ns)
+        {
+            wm->report_rate = (unsigned int)((uint64_t)(wm->reports - wm->rate_reports) * 1000000000ULL
+                                             / (wm->report_ns - wm->rate_ns));
+        }
+        wm->rate_ns      = wm->report_ns;
+        wm->rate_reports = wm->reports;
+    }
+
     save_state(wm);
 
     switch (event)
@@ -233,6 +264,13 @@ void propagate_event(struct wiimote_t *wm, byte event, byte *msg)
 
         break;
     }
+    case WM_RPT_EXP:
+    {
+        /* expansion only, the buttons keep their last state */
+        handle_expansion(wm, msg);
+
+        break;
+    }
     case WM_RPT_BTN_ACC_EXP:
     {
         /* button - motion - expansion */
@@ -281,6 +319,44 @@ void propagate_event(struct wiimote_t *wm, byte event, byte *msg)
 
         break;
     }
+    case WM_RPT_BTN_ACC_IR_1:
+    {
+        /* first half of a full IR frame, wait for the second */
+        memcpy(wm->ir_full_half, msg, sizeof(wm->ir_full_half));
+        wm->ir_full_pending = 1;
+
+        return;
+    }
+    case WM_RPT_BTN_ACC_IR_2:
+    {
+        byte accel[5];
+        byte ir[36];
+
+        /* a second half without its first is dropped */
+        if (!wm->ir_full_pending)
+        {
+            return;
+        }
+        wm->ir_full_pending = 0;
+
+        /* button - motion - ir, the accel is split over both halves */
+        wiiuse_pressed_buttons(wm, msg);
+
+        accel[0] = msg[0];
+        accel[1] = msg[1];
+        accel[2] = wm->ir_full_half[2];
+        accel[3] = msg[2];
+        accel[4] = ((wm->ir_full_half[0] & 0x60) >> 1) | ((wm->ir_full_half[1] & 0x60) << 1)
+                   | ((msg[0] & 0x60) >> 5) | ((msg[1] & 0x60) >> 3);
+        handle_wm_accel(wm, accel);
+
+        /* ir */
+        memcpy(ir, wm->ir_full_half + 3, 18);
+        memcpy(ir + 18, msg + 3, 18);
+        calculate_full_ir(wm, ir);
+
+        break;
+    }
 
     /*
      * FIXME: this gets triggered only when the Wiimote sends 0x22
@@ -542,6 +618,11 @@ static void event_status(struct wiimote_t *wm, byte *msg)
 
     wiiuse_pressed_buttons(wm, msg);
 
+    /* the report type has to be sent again, the LEDs are known now */
+    wm->out.known &= ~WM_OUT_REPORT;
+    wm->out.leds = msg[2] & 0xF0;
+    wm->out.known |= WM_OUT_LEDS;
+
     /* find what LEDs are lit */
     if (msg[2] & WM_CTRL_STATUS_BYTE1_LED_1)
     {
@@ -628,7 +709,7 @@ static void event_status(struct wiimote_t *wm, byte *msg)
         }
     } else
     {
-        wiiuse_set_report_type(wm);
+        wiiuse_defer_report_type(wm);
         return;
     }
 
@@ -658,7 +739,7 @@ static void handle_expansion(struct wiimote_t *wm, byte *msg)
     switch (wm->exp.type)
     {
     case EXP_NUNCHUK:
-        nunchuk_event(&wm->exp.nunchuk, msg);
+        nunchuk_event(&wm->exp.nunchuk, msg, wm->report_ns);
         break;
     case EXP_CLASSIC:
         classic_ctrl_event(&wm->exp.classic, msg);
@@ -672,7 +753,8 @@ static void handle_expansion(struct wiimote_t *wm, byte *msg)
     case EXP_MOTION_PLUS:
     case EXP_MOTION_PLUS_CLASSIC:
     case EXP_MOTION_PLUS_NUNCHUK:
-        motion_plus_event(&wm->exp.mp, wm->exp.type, msg);
+        motion_plus_event(&wm->exp.mp, wm->exp.type, msg, WIIUSE_USING_ACC(wm) ? &wm->gforce : NULL,
+                          wm->report_ns);
         break;
     default:
         break;
@@ -827,7 +909,7 @@ void handshake_expansion(struct wiimote_t *wm, byte *data, uint16_t len)
     }
 
     wiiuse_set_ir_mode(wm);
-    wiiuse_set_report_type(wm);
+    wiiuse_defer_report_type(wm);
 }
 
 /**
@@ -0,0 +1,199 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Q16.16 fixed-point math.
+ *
+ *	Square root, atan2 and sin/cos using integer operations only.
+ */
+
+#include "fixed.h"
+
+/* atan polynomial of dynamics.c in Q16 */
+#define FIXED_ATAN_C1 65527
+#define FIXED_ATAN_C3 (-21646)
+#define FIXED_ATAN_C5 11806
+#define FIXED_ATAN_C7 (-5579)
+#define FIXED_ATAN_C9 1365
+
+#define FIXED_PI          205887  /* pi in Q16 */
+#define FIXED_RAD_TO_DEG  3754937 /* 180 / pi in Q16 */
+#define FIXED_DEG_90      (90 * FIXED_ONE)
+#define FIXED_DEG_360     (360 * FIXED_ONE)
+
+/* sin of 0 to 90 degrees in Q16 */
+static const fixed_t sin_table[91] = {
+    0,     1144,  2287,  3430,  4572,  5712,  6850,  7987,  9121,  10252, 11380, 12505, 13626,
+    14742, 15855, 16962, 18064, 19161, 20252, 21336, 22415, 23486, 24550, 25607, 26656, 27697,
+    28729, 29753, 30767, 31772, 32768, 33754, 34729, 35693, 36647, 37590, 38521, 39441, 40348,
+    41243, 42126, 42995, 43852, 44695, 45525, 46341, 47143, 47930, 48703, 49461, 50203, 50931,
+    51643, 52339, 53020, 53684, 54332, 54963, 55578, 56175, 56756, 57319, 57865, 58393, 58903,
+    59396, 59870, 60326, 60764, 61183, 61584, 61966, 62328, 62672, 62997, 63303, 63589, 63856,
+    64104, 64332, 64540, 64729, 64898, 65048, 65177, 65287, 65376, 65446, 65496, 65526, 65536};
+
+/**
+ *	@brief Integer square root.
+ *
+ *	@param v	The value.
+ *
+ *	@return floor(sqrt(v))
+ */
+uint32_t fixed_isqrt64(uint64_t v)
+{
+    uint64_t res = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while (bit > v)
+    {
+        bit >>= 2;
+    }
+
+    while (bit)
+    {
+        if (v >= res + bit)
+        {
+            v -= res + bit;
+            res = (res >> 1) + bit;
+        } else
+        {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return (uint32_t)res;
+}
+
+/**
+ *	@brief Square root of a non-negative Q16 value.
+ */
+fixed_t fixed_sqrt(fixed_t a)
+{
+    if (a <= 0)
+    {
+        return 0;
+    }
+
+    return (fixed_t)fixed_isqrt64((uint64_t)a << FIXED_SHIFT);
+}
+
+/**
+ *	@brief atan2 of two Q16 values, in Q16 degrees.
+ *
+ *	Same polynomial as the float kernels, the error is about 1e-3 degrees.
+ */
+fixed_t fixed_atan2_deg(fixed_t y, fixed_t x)
+{
+    int64_t ax = (x < 0) ? -(int64_t)x : x;
+    int64_t ay = (y < 0) ? -(int64_t)y : y;
+    int64_t mn = (ax < ay) ? ax : ay;
+    int64_t mx = (ax < ay) ? ay : ax;
+    int64_t a, s, r;
+
+    if (!mx)
+    {
+        return 0;
+    }
+
+    a = (mn << FIXED_SHIFT) / mx;
+    s = (a * a) >> FIXED_SHIFT;
+
+    r = FIXED_ATAN_C9;
+    r = ((r * s) >> FIXED_SHIFT) + FIXED_ATAN_C7;
+    r = ((r * s) >> FIXED_SHIFT) + FIXED_ATAN_C5;
+    r = ((r * s) >> FIXED_SHIFT) + FIXED_ATAN_C3;
+    r = ((r * s) >> FIXED_SHIFT) + FIXED_ATAN_C1;
+    r = (r * a) >> FIXED_SHIFT;
+
+    if (ay > ax)
+    {
+        r = FIXED_PI / 2 - r;
+    }
+    if (x < 0)
+    {
+        r = FIXED_PI - r;
+    }
+    if (y < 0)
+    {
+        r = -r;
+    }
+
+    return (fixed_t)((r * FIXED_RAD_TO_DEG) >> FIXED_SHIFT);
+}
+
+/**
+ *	@brief sin of 0 to 90 degrees, interpolated from the table.
+ */
+static fixed_t sin_quadrant(fixed_t deg)
+{
+    int i        = deg >> FIXED_SHIFT;
+    fixed_t frac = deg & (FIXED_ONE - 1);
+
+    if (i >= 90)
+    {
+        return sin_table[90];
+    }
+
+    return sin_table[i] + (fixed_t)(((int64_t)(sin_table[i + 1] - sin_table[i]) * frac) >> FIXED_SHIFT);
+}
+
+/**
+ *	@brief sin of any angle in Q16 degrees.
+ */
+static fixed_t sin_deg(fixed_t deg)
+{
+    deg %= FIXED_DEG_360;
+    if (deg < 0)
+    {
+        deg += FIXED_DEG_360;
+    }
+
+    if (deg < FIXED_DEG_90)
+    {
+        return sin_quadrant(deg);
+    } else if (deg < 2 * FIXED_DEG_90)
+    {
+        return sin_quadrant(2 * FIXED_DEG_90 - deg);
+    } else if (deg < 3 * FIXED_DEG_90)
+    {
+        return -sin_quadrant(deg - 2 * FIXED_DEG_90);
+    } else
+    {
+        return -sin_quadrant(FIXED_DEG_360 - deg);
+    }
+}
+
+/**
+ *	@brief sin and cos of an angle in Q16 degrees.
+ *
+ *	@param deg		The angle.
+ *	@param s		[out] Sine, Q16.
+ *	@param c		[out] Cosine, Q16.
+ *
+ *	Linear interpolation of a 1 degree table, the error is below 4e-5.
+ */
+void fixed_sincos_deg(fixed_t deg, fixed_t *s, fixed_t *c)
+{
+    *s = sin_deg(deg);
+    *c = sin_deg((fixed_t)(((int64_t)deg + FIXED_DEG_90) % FIXED_DEG_360));
+}
@@ -0,0 +1,70 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Q16.16 fixed-point math.
+ *
+ *	Used instead of float math when the library is built with
+ *	WIIUSE_FIXED_POINT, for targets without a hardware FPU.  Values are
+ *	only converted to float when they are stored in the public structures.
+ */
+
+#ifndef FIXED_H_INCLUDED
+#define FIXED_H_INCLUDED
+
+#include "wiiuse_internal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup internal_fixed Internal: Fixed-Point Math */
+/** @{ */
+
+typedef int32_t fixed_t;
+
+#define FIXED_SHIFT 16
+#define FIXED_ONE   ((fixed_t)1 << FIXED_SHIFT)
+
+INLINE_UTIL fixed_t fixed_from_int(int i) { return (fixed_t)(i * FIXED_ONE); }
+
+INLINE_UTIL fixed_t fixed_mul(fixed_t a, fixed_t b) { return (fixed_t)(((int64_t)a * b) >> FIXED_SHIFT); }
+
+INLINE_UTIL fixed_t fixed_div(fixed_t a, fixed_t b) { return (fixed_t)(((int64_t)a * FIXED_ONE) / b); }
+
+/* a multiply, no float divide */
+INLINE_UTIL float fixed_to_float(fixed_t a) { return (float)a * (1.0f / FIXED_ONE); }
+
+INLINE_UTIL fixed_t fixed_from_float(float f) { return (fixed_t)(f * FIXED_ONE); }
+
+uint32_t fixed_isqrt64(uint64_t v);
+fixed_t fixed_sqrt(fixed_t a);
+fixed_t fixed_atan2_deg(fixed_t y, fixed_t x);
+void fixed_sincos_deg(fixed_t deg, fixed_t *s, fixed_t *c);
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FIXED_H_INCLUDED */
@@ -33,7 +33,7 @@
 
 #include "guitar_hero_3.h"
 
-#include "dynamics.h" /* for calc_joystick_state */
+#include "dynamics.h" /* for calc_joystick_state, joystick_build_lut */
 #include "events.h"   /* for handshake_expansion */
 
 #include <stdlib.h> /* for malloc */
@@ -102,6 +102,7 @@ int guitar_hero_3_handshake(struct wiimote_t *wm, struct guitar_hero_3_t *gh3, b
     gh3->js.max.y    = GUITAR_HERO_3_JS_MAX_Y;
     gh3->js.min.y    = GUITAR_HERO_3_JS_MIN_Y;
     gh3->js.center.y = GUITAR_HERO_3_JS_CENTER_Y;
+    joystick_build_lut(&gh3->js);
 
     /* handshake done */
     wm->exp.type = EXP_GUITAR_HERO_3;
@@ -120,6 +121,7 @@ int guitar_hero_3_handshake(struct wiimote_t *wm, struct guitar_hero_3_t *gh3, b
  */
 void guitar_hero_3_disconnected(struct guitar_hero_3_t *gh3)
 {
+    joystick_free_lut(&gh3->js);
     memset(gh3, 0, sizeof(struct guitar_hero_3_t));
 }
 
@@ -32,14 +32,165 @@
  */
 
 #include "io.h"
-#include "events.h" /* for propagate_event */
-#include "ir.h"     /* for wiiuse_set_ir_mode */
+#include "dynamics.h" /* for accel_build_orient_lut */
+#include "events.h"   /* for propagate_event */
+#include "ir.h"       /* for wiiuse_set_ir_mode */
+#include "outqueue.h" /* for outqueue_flush */
+#include "registry.h" /* for registry_update */
 #include "wiiuse_internal.h"
 
 #include "os.h" /* for wiiuse_os_* */
 
 #include <stdlib.h> /* for free, malloc */
 
+/**
+ *  @brief Number of wiimotes of an array connected through an adapter.
+ */
+static int adapter_load(struct wiimote_t **wm, int wiimotes, int adapter)
+{
+    int i, load = 0;
+
+    for (i = 0; i < wiimotes; ++i)
+    {
+        if (wm[i] && WIIMOTE_IS_CONNECTED(wm[i]) && wm[i]->adapter == adapter)
+        {
+            ++load;
+        }
+    }
+
+    return load;
+}
+
+/**
+ *  @brief Sort adapters by the number of wiimotes connected through them.
+ *
+ *  @param wm         An array of wiimote_t structures.
+ *  @param wiimotes   The number of wiimote structures in \a wm.
+ *  @param adapters   The adapters, sorted in place, least loaded first.
+ *  @param count      The number of adapters.
+ *
+ *  Only the wiimotes of \a wm count.
+ */
+void wiiuse_sort_adapters(struct wiimote_t **wm, int wiimotes, int *adapters, int count)
+{
+    int load[WIIUSE_MAX_ADAPTERS];
+    int i, j, a, l;
+
+    for (i = 0; i < count; ++i)
+    {
+        load[i] = adapter_load(wm, wiimotes, adapters[i]);
+    }
+
+    /* a handful of adapters at most, a stable insertion sort keeps hci0 first on a tie */
+    for (i = 1; i < count; ++i)
+    {
+        a = adapters[i];
+        l = load[i];
+        for (j = i; j > 0 && load[j - 1] > l; --j)
+        {
+            adapters[j] = adapters[j - 1];
+            load[j]     = load[j - 1];
+        }
+        adapters[j] = a;
+        load[j]     = l;
+    }
+}
+
+/**
+ *  @brief If wiiuse_os_connect() will try to connect a wiimote.
+ */
+static int about_to_connect(struct wiimote_t *wm)
+{
+    return wm && !WIIMOTE_IS_CONNECTED(wm) && WIIMOTE_IS_SET(wm, WIIMOTE_STATE_DEV_FOUND);
+}
+
+/**
+ *  @brief Position of an adapter in a list, -1 if it is not in it.
+ */
+static int adapter_index(const int *adapters, int count, int adapter)
+{
+    int k;
+
+    for (k = 0; k < count; ++k)
+    {
+        if (adapters[k] == adapter)
+        {
+            return k;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ *  @brief Pick the adapter of each wiimote about to connect.
+ *
+ *  A wiimote goes to the adapter with the fewest wiimotes of \a wm,
+ *  unless wiiuse_set_adapter() pinned it to one that is up.  A wiimote
+ *  pinned to an adapter that is down keeps its pin for the next time.
+ *
+ *  This function is not part of the wiiuse API.
+ */
+void wiiuse_assign_adapters(struct wiimote_t **wm, int wiimotes)
+{
+    int adapters[WIIUSE_MAX_ADAPTERS];
+    int load[WIIUSE_MAX_ADAPTERS];
+    int count, i, k, best;
+
+    count = wiiuse_os_adapters(adapters, WIIUSE_MAX_ADAPTERS);
+    if (!count)
+    {
+        /* the platform picks */
+        return;
+    }
+
+    for (k = 0; k < count; ++k)
+    {
+        load[k] = adapter_load(wm, wiimotes, adapters[k]);
+    }
+
+    /* the pinned wiimotes go first, the others fill up around them */
+    for (i = 0; i < wiimotes; ++i)
+    {
+        if (!about_to_connect(wm[i]) || wm[i]->adapter_pin < 0)
+        {
+            continue;
+        }
+
+        k = adapter_index(adapters, count, wm[i]->adapter_pin);
+        if (k >= 0)
+        {
+            wm[i]->adapter = wm[i]->adapter_pin;
+            load[k]++;
+        } else
+        {
+            WIIUSE_WARNING("Adapter hci%i of wiimote id %i is not up, using another one.", wm[i]->adapter_pin,
+                           wm[i]->unid);
+        }
+    }
+
+    for (i = 0; i < wiimotes; ++i)
+    {
+        if (!about_to_connect(wm[i])
+            || (wm[i]->adapter_pin >= 0 && adapter_index(adapters, count, wm[i]->adapter_pin) >= 0))
+        {
+            continue;
+        }
+
+        best = 0;
+        for (k = 1; k < count; ++k)
+        {
+            if (load[k] < load[best])
+            {
+                best = k;
+            }
+        }
+
+        wm[i]->adapter = adapters[best];
+        load[best]++;
+    }
+}
+
 /**
  *  @brief Find a wiimote or wiimotes.
  *
@@ -57,14 +208,23 @@
  *  You can then call wiiuse_connect() to connect to the found       \n
  *  devices.
  *
- *  This function only delegates to the platform-specific implementation
+ *  This function delegates to the platform-specific implementation
  *  wiiuse_os_find.
  *
  *  This function is declared in wiiuse.h
  */
 int wiiuse_find(struct wiimote_t **wm, int max_wiimotes, int timeout)
 {
-    return wiiuse_os_find(wm, max_wiimotes, timeout);
+    int found = wiiuse_os_find(wm, max_wiimotes, timeout);
+    int i;
+
+    /* a registry indexes the wiimotes by the address they were found at */
+    for (i = 0; wm && i < found; ++i)
+    {
+        registry_update(wm[i]);
+    }
+
+    return found;
 }
 
 /**
@@ -83,12 +243,34 @@ int wiiuse_find(struct wiimote_t **wm, int max_wiimotes, int timeout)
  *  in the wiimote_t structures.  These addresses are normally set
  *  by the wiiuse_find() function, but can also be set manually.
  *
- *  This function only delegates to the platform-specific implementation
+ *  Where the platform lets us pick the bluetooth adapter (Linux), each
+ *  wiimote goes through the adapter with the fewest connected wiimotes
+ *  of \a wm, see wiiuse_set_adapter().
+ *
+ *  This function delegates to the platform-specific implementation
  *  wiiuse_os_connect.
  *
  *  This function is declared in wiiuse.h
  */
-int wiiuse_connect(struct wiimote_t **wm, int wiimotes) { return wiiuse_os_connect(wm, wiimotes); }
+int wiiuse_connect(struct wiimote_t **wm, int wiimotes)
+{
+    int connected, i;
+
+    if (!wm)
+    {
+        return 0;
+    }
+
+    wiiuse_assign_adapters(wm, wiimotes);
+    connected = wiiuse_os_connect(wm, wiimotes);
+
+    for (i = 0; i < wiimotes; ++i)
+    {
+        registry_update(wm[i]);
+    }
+
+    return connected;
+}
 
 /**
  *  @brief Disconnect a wiimote.
@@ -100,12 +282,106 @@ int wiiuse_connect(struct wiimote_t **wm, int wiimotes) { return wiiuse_os_conne
  *
  *  Note that this will not free the wiimote structure.
  *
- *  This function only delegates to the platform-specific implementation
+ *  This function delegates to the platform-specific implementation
  *  wiiuse_os_disconnect.
  *
  *  This function is declared in wiiuse.h
  */
-void wiiuse_disconnect(struct wiimote_t *wm) { wiiuse_os_disconnect(wm); }
+void wiiuse_disconnect(struct wiimote_t *wm)
+{
+    wiiuse_os_disconnect(wm);
+    registry_update(wm);
+}
+
+/**
+ *  @brief Choose the bluetooth adapter a wiimote connects through.
+ *
+ *  @param wm       Pointer to a wiimote_t structure.
+ *  @param adapter  The HCI device id (0 for hci0), or WIIUSE_ADAPTER_DEFAULT
+ *                  to let wiiuse_connect() balance the wiimotes again.
+ *
+ *  Takes effect the next time the wiimote connects.  Linux only, the
+ *  other platforms leave the choice to the system.
+ *
+ *  This function is declared in wiiuse.h
+ */
+void wiiuse_set_adapter(struct wiimote_t *wm, int adapter)
+{
+    if (!wm)
+    {
+        return;
+    }
+
+    wm->adapter_pin = (adapter < 0) ? WIIUSE_ADAPTER_DEFAULT : adapter;
+}
+
+/**
+ *  @brief Get the load of each bluetooth adapter.
+ *
+ *  @param wm         An array of wiimote_t structures.
+ *  @param wiimotes   The number of wiimote structures in \a wm.
+ *  @param stats      Array that receives one entry per adapter.
+ *  @param max        Room in \a stats.
+ *
+ *  @return The number of entries put in \a stats.
+ *
+ *  Every adapter that is up gets an entry, idle ones too, followed by
+ *  any other adapter a wiimote of \a wm is connected through
+ *  (WIIUSE_ADAPTER_DEFAULT where the system picks).  Only the wiimotes
+ *  of \a wm count.  A wiimote that sent nothing for two rate windows
+ *  counts with a rate of 0.
+ *
+ *  This function is declared in wiiuse.h
+ */
+int wiiuse_adapter_stats(struct wiimote_t **wm, int wiimotes, struct wiiuse_adapter_stats_t *stats, int max)
+{
+    int adapters[WIIUSE_MAX_ADAPTERS];
+    uint64_t now = wiiuse_os_ticks_ns();
+    int count, i, k;
+
+    if (!wm || !stats || max <= 0)
+    {
+        return 0;
+    }
+
+    count = wiiuse_os_adapters(adapters, max < WIIUSE_MAX_ADAPTERS ? max : WIIUSE_MAX_ADAPTERS);
+    for (k = 0; k < count; ++k)
+    {
+        stats[k].adapter     = adapters[k];
+        stats[k].devices     = 0;
+        stats[k].report_rate = 0;
+    }
+
+    for (i = 0; i < wiimotes; ++i)
+    {
+        if (!wm[i] || !WIIMOTE_IS_CONNECTED(wm[i]))
+        {
+            continue;
+        }
+
+        for (k = 0; k < count && stats[k].adapter != wm[i]->adapter; ++k)
+            ;
+        if (k == count)
+        {
+            if (count == max)
+            {
+                continue;
+            }
+            stats[k].adapter     = wm[i]->adapter;
+            stats[k].devices     = 0;
+            stats[k].report_rate = 0;
+            ++count;
+        }
+
+        stats[k].devices++;
+        if (now - wm[i]->report_ns < 2 * WIIMOTE_RATE_WINDOW_NS)
+        {
+            stats[k].report_rate += wm[i]->report_rate;
+        }
+    }
+
+    return count;
+}
 
 /**
 *    @brief Wait until specified report arrives and return it
@@ -197,8 +473,9 @@ void wiiuse_read_data_sync(struct wiimote_t *wm, byte memory, unsigned addr, uns
     done = 0;
     while (!done)
     {
-        /* send */
+        /* send, the answer is awaited without polling */
         wiiuse_send(wm, WM_CMD_READ_DATA, pkt, sizeof(pkt));
+        outqueue_flush(wm);
 
         /* calculate how many 16B packets we have to get back */
         n_full_reports = size / 16;
@@ -265,6 +542,9 @@ void wiiuse_handshake(struct wiimote_t *wm, byte *data, uint16_t len)
         WIIMOTE_DISABLE_STATE(wm, WIIMOTE_STATE_EXP);
         WIIMOTE_DISABLE_FLAG(wm, WIIUSE_CONTINUOUS);
 
+        /* the wiimote may still have the outputs of an earlier connection */
+        wm->out.known = 0;
+
         wiiuse_set_report_type(wm);
         wiiuse_millisleep(500);
 
@@ -300,6 +580,11 @@ void wiiuse_handshake(struct wiimote_t *wm, byte *data, uint16_t len)
         accel->cal_g.y = buf[5] - accel->cal_zero.y;
         accel->cal_g.z = buf[6] - accel->cal_zero.z;
 
+        if (WIIMOTE_IS_FLAG_SET(wm, WIIUSE_ORIENT_LUT))
+        {
+            accel_build_orient_lut(accel);
+        }
+
         WIIUSE_DEBUG("Calibrated wiimote acc\n");
     }
 
@@ -357,6 +642,9 @@ void wiiuse_handshake(struct wiimote_t *wm, byte *data, uint16_t len)
 
         /* continuous reporting off, report to buttons only */
         WIIMOTE_ENABLE_STATE(wm, WIIMOTE_STATE_HANDSHAKE);
+
+        /* the wiimote may still have the outputs of an earlier connection */
+        wm->out.known = 0;
         wiiuse_set_leds(wm, WIIMOTE_LED_NONE);
 
         WIIMOTE_DISABLE_STATE(wm, WIIMOTE_STATE_ACC);
@@ -391,6 +679,11 @@ void wiiuse_handshake(struct wiimote_t *wm, byte *data, uint16_t len)
         accel->cal_g.y = req->buf[5] - accel->cal_zero.y;
         accel->cal_g.z = req->buf[6] - accel->cal_zero.z;
 
+        if (WIIMOTE_IS_FLAG_SET(wm, WIIUSE_ORIENT_LUT))
+        {
+            accel_build_orient_lut(accel);
+        }
+
         /* done with the buffer */
         free(req->buf);
 
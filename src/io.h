@@ -43,6 +43,8 @@ extern "C" {
 /** @defgroup internal_io Internal: Device I/O */
 /** @{ */
 void wiiuse_handshake(struct wiimote_t *wm, byte *data, uint16_t len);
+void wiiuse_sort_adapters(struct wiimote_t **wm, int wiimotes, int *adapters, int count);
+void wiiuse_assign_adapters(struct wiimote_t **wm, int wiimotes);
 
 int wiiuse_wait_report(struct wiimote_t *wm, int report, byte *buffer, int bufferLength,
                        unsigned long timeout_ms);
@@ -32,14 +32,18 @@
  */
 
 #include "ir.h"
+#include "fixed.h"
 
 #include <math.h> /* for atanf, cos, sin, sqrt */
 
 static int get_ir_sens(struct wiimote_t *wm, const byte **block1, const byte **block2);
 static void interpret_ir_data(struct wiimote_t *wm);
-static void fix_rotated_ir_dots(struct ir_dot_t *dot, float ang);
+static void fix_rotated_ir_dots(struct ir_t *ir, float ang);
 static void get_ir_dot_avg(struct ir_dot_t *dot, int *x, int *y);
 static void reorder_ir_dots(struct ir_dot_t *dot);
+static int track_ir_dots(struct ir_t *ir);
+static void store_ir_track_order(struct ir_t *ir);
+static void update_ir_prediction(struct ir_t *ir, uint64_t ns);
 static float ir_distance(struct ir_dot_t *dot);
 static int ir_correct_for_bounds(int *x, int *y, enum aspect_t aspect, int offset_x, int offset_y);
 static void ir_convert_to_vres(int *x, int *y, enum aspect_t aspect, int vx, int vy);
@@ -56,6 +60,30 @@ static const byte WM_IR_BLOCK2_LEVEL4[] = "\x35\x03";
 static const byte WM_IR_BLOCK1_LEVEL5[] = "\x07\x00\x00\x71\x01\x00\x72\x00\x20";
 static const byte WM_IR_BLOCK2_LEVEL5[] = "\x1f\x03";
 
+/**
+ *	@brief	Get the IR mode for the current wiimote state.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *
+ *	@return WM_IR_TYPE_BASIC, WM_IR_TYPE_EXTENDED or WM_IR_TYPE_FULL.
+ *
+ *	The basic mode leaves room for expansion data, so it always
+ *	wins over WIIUSE_IR_FULL while an expansion is attached.
+ */
+byte wiiuse_ir_type(struct wiimote_t *wm)
+{
+    if (WIIMOTE_IS_SET(wm, WIIMOTE_STATE_EXP))
+    {
+        return WM_IR_TYPE_BASIC;
+    } else if (WIIMOTE_IS_FLAG_SET(wm, WIIUSE_IR_FULL))
+    {
+        return WM_IR_TYPE_FULL;
+    } else
+    {
+        return WM_IR_TYPE_EXTENDED;
+    }
+}
+
 void wiiuse_set_ir_mode(struct wiimote_t *wm)
 {
     byte buf = 0x00;
@@ -69,13 +97,7 @@ void wiiuse_set_ir_mode(struct wiimote_t *wm)
         return;
     }
 
-    if (WIIMOTE_IS_SET(wm, WIIMOTE_STATE_EXP))
-    {
-        buf = WM_IR_TYPE_BASIC;
-    } else
-    {
-        buf = WM_IR_TYPE_EXTENDED;
-    }
+    buf = wiiuse_ir_type(wm);
     wiiuse_write_data(wm, WM_REG_IR_MODENUM, &buf, 1);
 }
 /**
@@ -164,13 +186,7 @@ void wiiuse_set_ir(struct wiimote_t *wm, int status)
     wiiuse_write_data(wm, WM_REG_IR_BLOCK2, (byte *)block2, 2);
 
     /* set the IR mode */
-    if (WIIMOTE_IS_SET(wm, WIIMOTE_STATE_EXP))
-    {
-        buf = WM_IR_TYPE_BASIC;
-    } else
-    {
-        buf = WM_IR_TYPE_EXTENDED;
-    }
+    buf = wiiuse_ir_type(wm);
     wiiuse_write_data(wm, WM_REG_IR_MODENUM, &buf, 1);
 
     wiiuse_millisleep(50);
@@ -381,14 +397,15 @@ void wiiuse_set_ir_sensitivity(struct wiimote_t *wm, int level)
 }
 
 /**
- *	@brief Calculate the data from the IR spots.  Basic IR mode.
+ *	@brief Decode the raw IR spots of a basic IR report.
  *
- *	@param wm		Pointer to a wiimote_t structure.
+ *	@param dot		[out] Array of four ir_dot_t structures to fill.
  *	@param data		Data returned by the wiimote for the IR spots.
+ *
+ *	Only the raw coordinates, size and visibility are set.
  */
-void calculate_basic_ir(struct wiimote_t *wm, byte *data)
+void decode_basic_ir(struct ir_dot_t *dot, const byte *data)
 {
-    struct ir_dot_t *dot = wm->ir.dot;
     int i;
 
     dot[0].rx = 1023 - (data[0] | ((data[2] & 0x30) << 4));
@@ -415,19 +432,18 @@ void calculate_basic_ir(struct wiimote_t *wm, byte *data)
             dot[i].size    = 0; /* since we don't know the size, set it as 0 */
         }
     }
-
-    interpret_ir_data(wm);
 }
 
 /**
- *	@brief Calculate the data from the IR spots.  Extended IR mode.
+ *	@brief Decode the raw IR spots of an extended IR report.
  *
- *	@param wm		Pointer to a wiimote_t structure.
+ *	@param dot		[out] Array of four ir_dot_t structures to fill.
  *	@param data		Data returned by the wiimote for the IR spots.
+ *
+ *	Only the raw coordinates, size and visibility are set.
  */
-void calculate_extended_ir(struct wiimote_t *wm, byte *data)
+void decode_extended_ir(struct ir_dot_t *dot, const byte *data)
 {
-    struct ir_dot_t *dot = wm->ir.dot;
     int i;
 
     for (i = 0; i < 4; ++i)
@@ -446,7 +462,78 @@ void calculate_extended_ir(struct wiimote_t *wm, byte *data)
             dot[i].visible = 1;
         }
     }
+}
+
+/**
+ *	@brief Decode the raw IR spots of a full IR report pair.
+ *
+ *	@param dot		[out] Array of four ir_dot_t structures to fill.
+ *	@param data		IR data of the 0x3E report followed by that of the 0x3F report, 36 bytes.
+ *
+ *	Like decode_extended_ir(), plus the bounding box and intensity.
+ *	The bounding box is mirrored in X like the raw coordinates.
+ */
+void decode_full_ir(struct ir_dot_t *dot, const byte *data)
+{
+    int i;
+
+    for (i = 0; i < 4; ++i, data += 9)
+    {
+        dot[i].rx = 1023 - (data[0] | ((data[2] & 0x30) << 4));
+        dot[i].ry = data[1] | ((data[2] & 0xC0) << 2);
+
+        dot[i].size = data[2] & 0x0F;
+
+        dot[i].bb_xmin   = 127 - (data[5] & 0x7F);
+        dot[i].bb_ymin   = data[4] & 0x7F;
+        dot[i].bb_xmax   = 127 - (data[3] & 0x7F);
+        dot[i].bb_ymax   = data[6] & 0x7F;
+        dot[i].intensity = data[8];
+
+        /* if in range set to visible */
+        if (dot[i].ry == 1023)
+        {
+            dot[i].visible = 0;
+        } else
+        {
+            dot[i].visible = 1;
+        }
+    }
+}
+
+/**
+ *	@brief Calculate the data from the IR spots.  Basic IR mode.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *	@param data		Data returned by the wiimote for the IR spots.
+ */
+void calculate_basic_ir(struct wiimote_t *wm, byte *data)
+{
+    decode_basic_ir(wm->ir.dot, data);
+    interpret_ir_data(wm);
+}
+
+/**
+ *	@brief Calculate the data from the IR spots.  Extended IR mode.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *	@param data		Data returned by the wiimote for the IR spots.
+ */
+void calculate_extended_ir(struct wiimote_t *wm, byte *data)
+{
+    decode_extended_ir(wm->ir.dot, data);
+    interpret_ir_data(wm);
+}
 
+/**
+ *	@brief Calculate the data from the IR spots.  Full IR mode.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *	@param data		IR data of a reassembled 0x3E/0x3F pair, 36 bytes.
+ */
+void calculate_full_ir(struct wiimote_t *wm, byte *data)
+{
+    decode_full_ir(wm->ir.dot, data);
     interpret_ir_data(wm);
 }
 
@@ -459,8 +546,7 @@ static void interpret_ir_data(struct wiimote_t *wm)
 {
     struct ir_dot_t *dot = wm->ir.dot;
     int i;
-    float roll        = 0.0f;
-    int last_num_dots = wm->ir.num_dots;
+    float roll = 0.0f;
 
     if (WIIMOTE_IS_SET(wm, WIIMOTE_STATE_ACC))
     {
@@ -489,15 +575,21 @@ static void interpret_ir_data(struct wiimote_t *wm)
             dot[i].order = 0;
         }
 
+        /* age the tracks */
+        track_ir_dots(&wm->ir);
+
         wm->ir.x = 0;
         wm->ir.y = 0;
         wm->ir.z = 0.0f;
 
+        wm->ir.pred_valid = 0;
+
         return;
     }
     case 1:
     {
-        fix_rotated_ir_dots(wm->ir.dot, roll);
+        fix_rotated_ir_dots(&wm->ir, roll);
+        track_ir_dots(&wm->ir);
 
         if (wm->ir.state < 2)
         {
@@ -535,6 +627,12 @@ static void interpret_ir_data(struct wiimote_t *wm)
                     int ox = 0;
                     int x, y;
 
+                    if (!dot[i].order)
+                    {
+                        /* a new source, not one of the two: keep the last cursor */
+                        break;
+                    }
+
                     if (dot[i].order == 1)
                     /* visible is the left dot - estimate where the right is */
                     {
@@ -577,12 +675,13 @@ static void interpret_ir_data(struct wiimote_t *wm)
         int x, y;
         wm->ir.state = 2;
 
-        fix_rotated_ir_dots(wm->ir.dot, roll);
+        fix_rotated_ir_dots(&wm->ir, roll);
 
-        /* if there is at least 1 new dot, reorder them all */
-        if (wm->ir.num_dots > last_num_dots)
+        /* if there is at least 1 new IR source, reorder them all */
+        if (track_ir_dots(&wm->ir))
         {
             reorder_ir_dots(dot);
+            store_ir_track_order(&wm->ir);
             wm->ir.x = 0;
             wm->ir.y = 0;
         }
@@ -611,6 +710,11 @@ static void interpret_ir_data(struct wiimote_t *wm)
     }
     }
 
+    if (WIIMOTE_IS_FLAG_SET(wm, WIIUSE_IR_PREDICT))
+    {
+        update_ir_prediction(&wm->ir, wm->report_ns);
+    }
+
 #ifdef WITH_WIIUSE_DEBUG
     {
         int ir_level;
@@ -628,10 +732,123 @@ static void interpret_ir_data(struct wiimote_t *wm)
 #endif
 }
 
+/**
+ *	@brief Feed the new cursor position to the prediction filter.
+ *
+ *	@param ir		Pointer to an ir_t structure.
+ *	@param ns		Time the report was received (ns).
+ *
+ *	A constant velocity alpha-beta filter, i.e. the steady state of the
+ *	matching Kalman filter, using the actual time between reports.
+ */
+static void update_ir_prediction(struct ir_t *ir, uint64_t ns)
+{
+    float dt = (float)(int64_t)(ns - ir->pred_ns) * 1e-9f;
+    float px, py, rx, ry;
+
+    if (!ir->pred_valid || dt < 0.0f || dt > IR_PREDICT_RESET)
+    {
+        ir->pred_x     = (float)ir->x;
+        ir->pred_y     = (float)ir->y;
+        ir->pred_vx    = 0.0f;
+        ir->pred_vy    = 0.0f;
+        ir->pred_ns    = ns;
+        ir->pred_valid = 1;
+        return;
+    }
+
+    px = ir->pred_x + ir->pred_vx * dt;
+    py = ir->pred_y + ir->pred_vy * dt;
+    rx = (float)ir->x - px;
+    ry = (float)ir->y - py;
+
+    ir->pred_x = px + IR_PREDICT_ALPHA * rx;
+    ir->pred_y = py + IR_PREDICT_ALPHA * ry;
+
+    /* two reports with the same stamp say nothing about the velocity */
+    if (dt > 0.0f)
+    {
+        ir->pred_vx += IR_PREDICT_BETA * rx / dt;
+        ir->pred_vy += IR_PREDICT_BETA * ry / dt;
+    }
+
+    ir->pred_ns = ns;
+}
+
+/**
+ *	@brief Extrapolate the IR cursor to a given time.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *	@param ticks	The time to predict the cursor for, usually
+ *					wiiuse_ticks() plus the display latency.
+ *	@param x		[out] Predicted X coordinate.
+ *	@param y		[out] Predicted Y coordinate.
+ *
+ *	@return 1 if the position was extrapolated, 0 if \a x and \a y are
+ *	just the last measured position (WIIUSE_IR_PREDICT not set, or no
+ *	IR source in view).
+ *
+ *	Needs the WIIUSE_IR_PREDICT flag, see wiiuse_set_flags().  The
+ *	prediction is never more than IR_PREDICT_MAX_MS ahead of the last
+ *	report and stays within the virtual resolution.
+ */
+int wiiuse_ir_predict(struct wiimote_t *wm, unsigned long ticks, int *x, int *y)
+{
+    float ahead;
+    float px, py;
+
+    if (!wm || !x || !y)
+    {
+        return 0;
+    }
+
+    *x = wm->ir.x;
+    *y = wm->ir.y;
+
+    if (!WIIMOTE_IS_FLAG_SET(wm, WIIUSE_IR_PREDICT) || !wm->ir.pred_valid)
+    {
+        return 0;
+    }
+
+    /* ticks is in ms on the clock of wiimote_t::report_ns, see wiiuse_ticks() */
+    ahead = (float)(long)(ticks - (unsigned long)(wm->ir.pred_ns / 1000000)) * 0.001f;
+    if (ahead < 0.0f)
+    {
+        ahead = 0.0f;
+    } else if (ahead > IR_PREDICT_MAX_MS * 0.001f)
+    {
+        ahead = IR_PREDICT_MAX_MS * 0.001f;
+    }
+
+    px = wm->ir.pred_x + wm->ir.pred_vx * ahead;
+    py = wm->ir.pred_y + wm->ir.pred_vy * ahead;
+
+    *x = (int)(px + 0.5f);
+    *y = (int)(py + 0.5f);
+
+    /* clamp to the virtual screen */
+    if (*x < 0)
+    {
+        *x = 0;
+    } else if (*x >= (int)wm->ir.vres[0])
+    {
+        *x = (int)wm->ir.vres[0] - 1;
+    }
+    if (*y < 0)
+    {
+        *y = 0;
+    } else if (*y >= (int)wm->ir.vres[1])
+    {
+        *y = (int)wm->ir.vres[1] - 1;
+    }
+
+    return 1;
+}
+
 /**
  *	@brief Fix the rotation of the IR dots.
  *
- *	@param dot		An array of 4 ir_dot_t objects.
+ *	@param ir		Pointer to an ir_t structure holding the dots.
  *	@param ang		The roll angle to correct by (-180, 180)
  *
  *	If there is roll then the dots are rotated
@@ -642,9 +859,14 @@ static void interpret_ir_data(struct wiimote_t *wm)
  *	this will not do anything and the cursor
  *	position may be inaccurate.
  */
-static void fix_rotated_ir_dots(struct ir_dot_t *dot, float ang)
+static void fix_rotated_ir_dots(struct ir_t *ir, float ang)
 {
+    struct ir_dot_t *dot = ir->dot;
+#ifdef WIIUSE_FIXED_POINT
+    fixed_t s, c;
+#else
     float s, c;
+#endif
     int x, y;
     int i;
 
@@ -658,8 +880,24 @@ static void fix_rotated_ir_dots(struct ir_dot_t *dot, float ang)
         return;
     }
 
-    s = sinf(DEGREE_TO_RAD(ang));
-    c = cosf(DEGREE_TO_RAD(ang));
+#ifdef WIIUSE_FIXED_POINT
+    /* the table lookup is already cheap, nothing to cache */
+    fixed_sincos_deg(fixed_from_float(ang), &s, &c);
+#else
+    /*
+     *	The roll rarely moves by more than a fraction of a degree between
+     *	two reports, so only redo sin/cos when it has moved by more than
+     *	IR_ROT_EPSILON: at the edge of the sensor that is below 0.1 pixel.
+     */
+    if (fabsf(ang - ir->rot_ang) > IR_ROT_EPSILON || !ir->rot_cos)
+    {
+        ir->rot_ang = ang;
+        ir->rot_sin = sinf(DEGREE_TO_RAD(ang));
+        ir->rot_cos = cosf(DEGREE_TO_RAD(ang));
+    }
+    s = ir->rot_sin;
+    c = ir->rot_cos;
+#endif
 
     /*
      *	[ cos(theta)  -sin(theta) ][ ir->rx ]
@@ -676,8 +914,14 @@ static void fix_rotated_ir_dots(struct ir_dot_t *dot, float ang)
         x = dot[i].rx - (1024 / 2);
         y = dot[i].ry - (768 / 2);
 
-        dot[i].x = (uint32_t)((c * x) + (-s * y));
-        dot[i].y = (uint32_t)((s * x) + (c * y));
+#ifdef WIIUSE_FIXED_POINT
+        /* truncate toward zero like the float conversion */
+        dot[i].x = (uint32_t)((int32_t)((c * x) + (-s * y)) / FIXED_ONE);
+        dot[i].y = (uint32_t)((int32_t)((s * x) + (c * y)) / FIXED_ONE);
+#else
+        dot[i].x = (uint32_t)((int)((c * x) + (-s * y)));
+        dot[i].y = (uint32_t)((int)((s * x) + (c * y)));
+#endif
 
         dot[i].x += (1024 / 2);
         dot[i].y += (768 / 2);
@@ -749,6 +993,201 @@ static void reorder_ir_dots(struct ir_dot_t *dot)
     }
 }
 
+/**
+ *	@brief Match the visible IR dots to the tracks of the previous reports.
+ *
+ *	@param ir		Pointer to an ir_t structure holding the rotated dots.
+ *
+ *	@return 1 if a new track was started, 0 if not.
+ *
+ *	Each dot continues the track whose predicted position is the closest,
+ *	so it keeps its id and order when dots cross or slots are shuffled.
+ *	With at most 4 dots and 4 tracks this is a fixed number of steps.
+ *	Tracks whose dot is gone are extrapolated for IR_TRACK_MAX_MISSED
+ *	reports before they are dropped.
+ */
+static int track_ir_dots(struct ir_t *ir)
+{
+    struct ir_dot_t *dot     = ir->dot;
+    struct ir_track_t *track = ir->track;
+    float dot_x[4], dot_y[4];
+    float dist[4][4];
+    int dot_track[4]  = {-1, -1, -1, -1};
+    int track_used[4] = {0, 0, 0, 0};
+    int i, j, n, started = 0;
+
+    /* the roll correction can rotate a dot to negative coordinates */
+    for (i = 0; i < 4; ++i)
+    {
+        dot_x[i] = (float)(int32_t)dot[i].x;
+        dot_y[i] = (float)(int32_t)dot[i].y;
+    }
+
+    /* distance of every visible dot to the prediction of every track */
+    for (i = 0; i < 4; ++i)
+    {
+        for (j = 0; j < 4; ++j)
+        {
+            if (dot[i].visible && track[j].id)
+            {
+                float dx   = dot_x[i] - (track[j].x + track[j].vx);
+                float dy   = dot_y[i] - (track[j].y + track[j].vy);
+                dist[i][j] = dx * dx + dy * dy;
+            } else
+            {
+                dist[i][j] = IR_TRACK_GATE + 1;
+            }
+        }
+    }
+
+    /* pair the closest dot and track first */
+    for (n = 0; n < 4; ++n)
+    {
+        int bi = -1, bj = -1;
+        float best = IR_TRACK_GATE + 1;
+
+        for (i = 0; i < 4; ++i)
+        {
+            if (dot_track[i] >= 0)
+            {
+                continue;
+            }
+            for (j = 0; j < 4; ++j)
+            {
+                if (!track_used[j] && dist[i][j] < best)
+                {
+                    best = dist[i][j];
+                    bi   = i;
+                    bj   = j;
+                }
+            }
+        }
+
+        if (bi < 0)
+        {
+            break;
+        }
+
+        dot_track[bi]  = bj;
+        track_used[bj] = 1;
+    }
+
+    /* update the matched tracks, age the others */
+    for (j = 0; j < 4; ++j)
+    {
+        if (!track[j].id || track_used[j])
+        {
+            continue;
+        }
+
+        if (++track[j].missed > IR_TRACK_MAX_MISSED)
+        {
+            track[j].id = 0;
+        } else
+        {
+            track[j].x += track[j].vx;
+            track[j].y += track[j].vy;
+        }
+    }
+
+    for (i = 0; i < 4; ++i)
+    {
+        struct ir_track_t *t;
+
+        if (!dot[i].visible)
+        {
+            dot[i].id = 0;
+            dot[i].vx = 0.0f;
+            dot[i].vy = 0.0f;
+            continue;
+        }
+
+        if (dot_track[i] >= 0)
+        {
+            /* the track was extrapolated while the dot was missing */
+            float steps;
+
+            t     = &track[dot_track[i]];
+            steps = (float)(t->missed + 1);
+
+            t->vx += IR_TRACK_VEL_ALPHA * ((dot_x[i] - t->x) / steps - t->vx);
+            t->vy += IR_TRACK_VEL_ALPHA * ((dot_y[i] - t->y) / steps - t->vy);
+
+            dot[i].order = t->order;
+        } else
+        {
+            /* start a new track in a free slot, or replace the oldest unmatched one */
+            int slot = -1;
+
+            for (j = 0; j < 4; ++j)
+            {
+                if (!track[j].id)
+                {
+                    slot = j;
+                    break;
+                }
+                if (!track_used[j] && (slot < 0 || track[j].missed > track[slot].missed))
+                {
+                    slot = j;
+                }
+            }
+            j = slot;
+            t = &track[j];
+
+            if (!++ir->next_track_id)
+            {
+                ir->next_track_id = 1;
+            }
+            t->id    = ir->next_track_id;
+            t->order = 0;
+            t->vx    = 0.0f;
+            t->vy    = 0.0f;
+
+            dot[i].order = 0;
+
+            dot_track[i]  = j;
+            track_used[j] = 1;
+            started       = 1;
+        }
+
+        t->x      = dot_x[i];
+        t->y      = dot_y[i];
+        t->missed = 0;
+
+        dot[i].id = t->id;
+        dot[i].vx = t->vx;
+        dot[i].vy = t->vy;
+    }
+
+    return started;
+}
+
+/**
+ *	@brief Copy the order of the visible dots to their tracks.
+ *
+ *	@param ir		Pointer to an ir_t structure.
+ */
+static void store_ir_track_order(struct ir_t *ir)
+{
+    int i, j;
+
+    for (i = 0; i < 4; ++i)
+    {
+        if (!ir->dot[i].visible)
+        {
+            continue;
+        }
+        for (j = 0; j < 4; ++j)
+        {
+            if (ir->track[j].id == ir->dot[i].id)
+            {
+                ir->track[j].order = ir->dot[i].order;
+                break;
+            }
+        }
+    }
+}
+
 /**
  *	@brief Calculate the distance between the first 2 visible IR dots.
  *
@@ -782,7 +1221,11 @@ static float ir_distance(struct ir_dot_t *dot)
     xd = dot[i2].x - dot[i1].x;
     yd = dot[i2].y - dot[i1].y;
 
+#ifdef WIIUSE_FIXED_POINT
+    return (float)fixed_isqrt64((uint64_t)(xd * xd + yd * yd));
+#else
     return sqrtf((float)(xd * xd + yd * yd));
+#endif
 }
 
 /**
@@ -848,8 +1291,13 @@ static void ir_convert_to_vres(int *x, int *y, enum aspect_t aspect, int vx, int
     *x -= ((1024 - xs) / 2);
     *y -= ((768 - ys) / 2);
 
+#ifdef WIIUSE_FIXED_POINT
+    *x = (int)(((int64_t)*x * vx) / xs);
+    *y = (int)(((int64_t)*y * vy) / ys);
+#else
     *x = (int)((*x / (float)xs) * vx);
     *y = (int)((*y / (float)ys) * vy);
+#endif
 }
 
 /**
@@ -859,10 +1307,15 @@ static void ir_convert_to_vres(int *x, int *y, enum aspect_t aspect, int vx, int
  */
 float calc_yaw(struct ir_t *ir)
 {
+#ifdef WIIUSE_FIXED_POINT
+    /* the distance cancels out: atan((ax - 512) / 1024) */
+    return fixed_to_float(fixed_atan2_deg(fixed_from_int(ir->ax - 512), fixed_from_int(1024)));
+#else
     float x;
 
     x = (float)(ir->ax - 512);
     x = x * (ir->z / 1024.0f);
 
     return RAD_TO_DEGREE(atanf(x / ir->z));
+#endif
 }
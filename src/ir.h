@@ -39,15 +39,42 @@
 #define WII_VRES_X 560
 #define WII_VRES_Y 340
 
+/* roll change, in degrees, before the rotation of the dots is recomputed */
+#define IR_ROT_EPSILON 0.01f
+
+/* squared distance, in pixels, from the predicted position for a dot to continue a track */
+#define IR_TRACK_GATE (128 * 128)
+
+/* reports a track is kept (and extrapolated) after its dot disappeared */
+#define IR_TRACK_MAX_MISSED 5
+
+/* weight of the newest displacement in the track velocity */
+#define IR_TRACK_VEL_ALPHA 0.5f
+
+/* gains of the alpha-beta filter behind wiiuse_ir_predict() */
+#define IR_PREDICT_ALPHA 0.7f
+#define IR_PREDICT_BETA  0.3f
+
+/* restart the filter after a gap longer than this (s) */
+#define IR_PREDICT_RESET 0.1f
+
+/* never extrapolate further than this (ms) */
+#define IR_PREDICT_MAX_MS 50
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /** @defgroup internal_ir Internal: IR Sensor */
 /** @{ */
+byte wiiuse_ir_type(struct wiimote_t *wm);
 void wiiuse_set_ir_mode(struct wiimote_t *wm);
 void calculate_basic_ir(struct wiimote_t *wm, byte *data);
 void calculate_extended_ir(struct wiimote_t *wm, byte *data);
+void calculate_full_ir(struct wiimote_t *wm, byte *data);
+void decode_basic_ir(struct ir_dot_t *dot, const byte *data);
+void decode_extended_ir(struct ir_dot_t *dot, const byte *data);
+void decode_full_ir(struct ir_dot_t *dot, const byte *data);
 float calc_yaw(struct ir_t *ir);
 /** @} */
 
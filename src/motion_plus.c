@@ -32,6 +32,7 @@
 
 #include "dynamics.h" /* for calc_joystick_state, etc */
 #include "events.h"   /* for disable_expansion */
+#include "fixed.h"    /* for fixed_t */
 #include "io.h"       /* for wiiuse_read */
 #include "ir.h"       /* for wiiuse_set_ir_mode */
 #include "nunchuk.h"  /* for nunchuk_pressed_buttons */
@@ -41,6 +42,8 @@
 
 static void wiiuse_calibrate_motion_plus(struct motion_plus_t *mp);
 static void calculate_gyro_rates(struct motion_plus_t *mp);
+static void update_orientation(struct motion_plus_t *mp, const struct gforce_t *accel, uint64_t ns);
+static void update_gyro_bias(struct motion_plus_t *mp, const struct gforce_t *accel);
 
 void wiiuse_probe_motion_plus(struct wiimote_t *wm)
 {
@@ -92,6 +95,8 @@ void wiiuse_probe_motion_plus(struct wiimote_t *wm)
     wm->exp.mp.orient.pitch       = 0.0;
     wm->exp.mp.orient.yaw         = 0.0;
     wm->exp.mp.raw_gyro_threshold = 10;
+    wm->exp.mp.ahrs_beta          = MOTION_PLUS_AHRS_BETA;
+    wm->exp.mp.ahrs_valid         = 0;
 
     wm->exp.mp.nc         = &(wm->exp.nunchuk);
     wm->exp.mp.classic    = &(wm->exp.classic);
@@ -100,7 +105,7 @@ void wiiuse_probe_motion_plus(struct wiimote_t *wm)
     wm->exp.mp.ext = 0;
 
     wiiuse_set_ir_mode(wm);
-    wiiuse_set_report_type(wm);
+    wiiuse_defer_report_type(wm);
 }
 
 void wiiuse_motion_plus_handshake(struct wiimote_t *wm, byte *data, unsigned short len)
@@ -154,6 +159,8 @@ void wiiuse_motion_plus_handshake(struct wiimote_t *wm, byte *data, unsigned sho
             wm->exp.mp.orient.pitch       = 0.0;
             wm->exp.mp.orient.yaw         = 0.0;
             wm->exp.mp.raw_gyro_threshold = 10;
+            wm->exp.mp.ahrs_beta          = MOTION_PLUS_AHRS_BETA;
+            wm->exp.mp.ahrs_valid         = 0;
 
             wm->exp.mp.nc         = &(wm->exp.nunchuk);
             wm->exp.mp.classic    = &(wm->exp.classic);
@@ -162,7 +169,7 @@ void wiiuse_motion_plus_handshake(struct wiimote_t *wm, byte *data, unsigned sho
             wm->exp.mp.ext = 0;
 
             wiiuse_set_ir_mode(wm);
-            wiiuse_set_report_type(wm);
+            wiiuse_defer_report_type(wm);
         }
     }
 }
@@ -241,7 +248,8 @@ void motion_plus_disconnected(struct motion_plus_t *mp)
     memset(mp, 0, sizeof(struct motion_plus_t));
 }
 
-void motion_plus_event(struct motion_plus_t *mp, int exp_type, byte *msg)
+void motion_plus_event(struct motion_plus_t *mp, int exp_type, byte *msg, const struct gforce_t *accel,
+                       uint64_t ns)
 {
     /*
      * Pass-through modes interleave data from the gyro
@@ -266,10 +274,17 @@ void motion_plus_event(struct motion_plus_t *mp, int exp_type, byte *msg)
             && !(mp->cal_gyro.roll) && !(mp->cal_gyro.pitch) && !(mp->cal_gyro.yaw))
         {
             wiiuse_calibrate_motion_plus(mp);
+        } else if (mp->cal_gyro.roll || mp->cal_gyro.pitch || mp->cal_gyro.yaw)
+        {
+            /* follow the temperature drift of the zero-rate values */
+            update_gyro_bias(mp, accel);
         }
 
         /* Calculate angular rates in deg/sec and performs some simple filtering */
         calculate_gyro_rates(mp);
+
+        /* fuse them with the wiimote accelerometer */
+        update_orientation(mp, accel, ns);
     }
 
     else
@@ -291,7 +306,7 @@ void motion_plus_event(struct motion_plus_t *mp, int exp_type, byte *msg)
             mp->nc->accel.z = (msg[4] & 0xFE) | ((msg[5] >> 5) & 0x04);
 
             calculate_orientation(&(mp->nc->accel_calib), &(mp->nc->accel), &(mp->nc->orient),
-                                  NUNCHUK_IS_FLAG_SET(mp->nc, WIIUSE_SMOOTHING));
+                                  NUNCHUK_IS_FLAG_SET(mp->nc, WIIUSE_SMOOTHING), ns);
 
             calculate_gforce(&(mp->nc->accel_calib), &(mp->nc->accel), &(mp->nc->gforce));
 
@@ -325,8 +340,112 @@ void wiiuse_calibrate_motion_plus(struct motion_plus_t *mp)
     mp->orient.roll    = 0.0;
     mp->orient.pitch   = 0.0;
     mp->orient.yaw     = 0.0;
+    mp->ahrs_valid     = 0;
+
+    mp->gyro_mean.roll  = mp->gyro_bias.roll = mp->raw_gyro.roll;
+    mp->gyro_mean.pitch = mp->gyro_bias.pitch = mp->raw_gyro.pitch;
+    mp->gyro_mean.yaw   = mp->gyro_bias.yaw = mp->raw_gyro.yaw;
+    mp->gyro_var.roll   = 0.0f;
+    mp->gyro_var.pitch  = 0.0f;
+    mp->gyro_var.yaw    = 0.0f;
+    mp->still_count     = 0;
+}
+
+/**
+ *	@brief Update the running mean and variance of one gyro axis.
+ *
+ *	@return 1 if the axis looks still, 0 if not.
+ */
+static int track_gyro_axis(float *mean, float *var, float bias, int16_t raw)
+{
+    float d = (float)raw - *mean;
+
+    *mean += MOTION_PLUS_STILL_ALPHA * d;
+    *var += MOTION_PLUS_STILL_ALPHA * (d * d - *var);
+
+    return (*var < MOTION_PLUS_STILL_VAR) && (fabsf(*mean - bias) < MOTION_PLUS_STILL_OFFSET);
+}
+
+/**
+ *	@brief Re-estimate the gyro zero-rate values while the wiimote is still.
+ *
+ *	@param mp		Pointer to a motion_plus_t structure.
+ *	@param accel	Gravity measured by the wiimote, NULL if not reported.
+ *
+ *	Still means all three gyros in slow mode with a low variance and a
+ *	mean close to the current bias (so a slow steady turn is not taken
+ *	for drift), and the accelerometer reading 1 g.  After
+ *	MOTION_PLUS_STILL_FRAMES such frames the bias moves a little toward
+ *	the running mean on every frame.  O(1) per frame.
+ */
+static void update_gyro_bias(struct motion_plus_t *mp, const struct gforce_t *accel)
+{
+    int still = (mp->acc_mode & 0x07) == 0x07;
+
+    still &= track_gyro_axis(&mp->gyro_mean.roll, &mp->gyro_var.roll, mp->gyro_bias.roll, mp->raw_gyro.roll);
+    still &= track_gyro_axis(&mp->gyro_mean.pitch, &mp->gyro_var.pitch, mp->gyro_bias.pitch,
+                             mp->raw_gyro.pitch);
+    still &= track_gyro_axis(&mp->gyro_mean.yaw, &mp->gyro_var.yaw, mp->gyro_bias.yaw, mp->raw_gyro.yaw);
+
+    if (still && accel)
+    {
+        float g = sqrtf(accel->x * accel->x + accel->y * accel->y + accel->z * accel->z);
+
+        still = fabsf(g - 1.0f) < MOTION_PLUS_STILL_ACCEL;
+    }
+
+    if (!still)
+    {
+        mp->still_count = 0;
+        return;
+    }
+
+    if (mp->still_count < MOTION_PLUS_STILL_FRAMES)
+    {
+        ++mp->still_count;
+        return;
+    }
+
+    mp->gyro_bias.roll += MOTION_PLUS_BIAS_RATE * (mp->gyro_mean.roll - mp->gyro_bias.roll);
+    mp->gyro_bias.pitch += MOTION_PLUS_BIAS_RATE * (mp->gyro_mean.pitch - mp->gyro_bias.pitch);
+    mp->gyro_bias.yaw += MOTION_PLUS_BIAS_RATE * (mp->gyro_mean.yaw - mp->gyro_bias.yaw);
+
+    mp->cal_gyro.roll  = (int16_t)(mp->gyro_bias.roll + 0.5f);
+    mp->cal_gyro.pitch = (int16_t)(mp->gyro_bias.pitch + 0.5f);
+    mp->cal_gyro.yaw   = (int16_t)(mp->gyro_bias.yaw + 0.5f);
+}
+
+#ifdef WIIUSE_FIXED_POINT
+/**
+ *	@brief Convert one gyro axis to degree/sec, in Q16.
+ */
+static fixed_t gyro_rate_fixed(short int tmp, int slow)
+{
+    fixed_t rate = slow ? fixed_from_int(tmp) / 20 : fixed_from_int(tmp) / 4;
+
+    /* Simple filtering */
+    if (rate > -FIXED_ONE / 2 && rate < FIXED_ONE / 2)
+    {
+        return 0;
+    }
+    return rate;
 }
 
+static void calculate_gyro_rates(struct motion_plus_t *mp)
+{
+    short int tmp_r, tmp_p, tmp_y;
+
+    /* We consider calibration data */
+    tmp_r = mp->raw_gyro.roll - mp->cal_gyro.roll;
+    tmp_p = mp->raw_gyro.pitch - mp->cal_gyro.pitch;
+    tmp_y = mp->raw_gyro.yaw - mp->cal_gyro.yaw;
+
+    /* We convert to degree/sec according to fast/slow mode */
+    mp->angle_rate_gyro.roll  = fixed_to_float(gyro_rate_fixed(tmp_r, mp->acc_mode & 0x04));
+    mp->angle_rate_gyro.pitch = fixed_to_float(gyro_rate_fixed(tmp_p, mp->acc_mode & 0x02));
+    mp->angle_rate_gyro.yaw   = fixed_to_float(gyro_rate_fixed(tmp_y, mp->acc_mode & 0x01));
+}
+#else
 static void calculate_gyro_rates(struct motion_plus_t *mp)
 {
     short int tmp_r, tmp_p, tmp_y;
@@ -380,3 +499,72 @@ static void calculate_gyro_rates(struct motion_plus_t *mp)
     mp->angle_rate_gyro.pitch = tmp_pitch;
     mp->angle_rate_gyro.yaw   = tmp_yaw;
 }
+#endif
+
+/**
+ *	@brief Update the fused orientation with a new gyro frame.
+ *
+ *	@param mp		Pointer to a motion_plus_t structure.
+ *	@param accel	Gravity measured by the wiimote, NULL if not reported.
+ *	@param ns		Time the frame was received (ns).
+ *
+ *	The wiimote axes are x to the left, y forward and z up: pitch turns
+ *	around x, roll around y and yaw around z.
+ */
+static void update_orientation(struct motion_plus_t *mp, const struct gforce_t *accel, uint64_t ns)
+{
+    float dt = (float)(int64_t)(ns - mp->ahrs_ns) * 1e-9f;
+    float gyro[3];
+
+    if (!mp->ahrs_valid)
+    {
+        if (accel)
+        {
+            quat_from_gforce(&mp->quat, accel);
+        } else
+        {
+            mp->quat.w = 1.0f;
+            mp->quat.x = mp->quat.y = mp->quat.z = 0.0f;
+        }
+        mp->ahrs_ns    = ns;
+        mp->ahrs_valid = 1;
+        quat_to_orient(&mp->quat, &mp->orient);
+        return;
+    }
+
+    /* a stamp older than the last one integrates nothing */
+    if (dt < 0.0f)
+    {
+        dt = 0.0f;
+    } else if (dt > MOTION_PLUS_AHRS_MAX_DT)
+    {
+        dt = MOTION_PLUS_AHRS_MAX_DT;
+    }
+
+    gyro[0] = DEGREE_TO_RAD(mp->angle_rate_gyro.pitch);
+    gyro[1] = DEGREE_TO_RAD(mp->angle_rate_gyro.roll);
+    gyro[2] = DEGREE_TO_RAD(mp->angle_rate_gyro.yaw);
+
+    ahrs_update(&mp->quat, mp->ahrs_beta, gyro, accel, dt);
+    mp->ahrs_ns = ns;
+
+    quat_to_orient(&mp->quat, &mp->orient);
+}
+
+/**
+ *	@brief Set the accelerometer correction gain of the Motion+ orientation.
+ *
+ *	@param wm		Pointer to a wiimote_t structure with a Motion+.
+ *	@param beta		The gain, in rad/s.  Higher values correct the gyro
+ *					drift faster but let more accelerometer noise through,
+ *					0 only integrates the gyroscopes.  Default is 0.1.
+ */
+void wiiuse_set_motion_plus_ahrs_gain(struct wiimote_t *wm, float beta)
+{
+    if (!wm)
+    {
+        return;
+    }
+
+    wm->exp.mp.ahrs_beta = beta;
+}
@@ -45,7 +45,32 @@ extern "C" {
 /** @{ */
 void motion_plus_disconnected(struct motion_plus_t *mp);
 
-void motion_plus_event(struct motion_plus_t *mp, int exp_type, byte *msg);
+/* default accelerometer correction gain of the orientation fusion (rad/s) */
+#define MOTION_PLUS_AHRS_BETA 0.1f
+
+/* longest time (s) integrated from a single gyro frame */
+#define MOTION_PLUS_AHRS_MAX_DT 0.05f
+
+/* weight of the newest gyro frame in the running mean and variance */
+#define MOTION_PLUS_STILL_ALPHA 0.05f
+
+/* the wiimote is still while the variance of every gyro axis is below this (raw counts squared) */
+#define MOTION_PLUS_STILL_VAR 16.0f
+
+/* ... the gyro mean is within this of the bias (raw counts, 20 per deg/s in slow mode) */
+#define MOTION_PLUS_STILL_OFFSET 60.0f
+
+/* ... and the accelerometer measures 1 g within this */
+#define MOTION_PLUS_STILL_ACCEL 0.05f
+
+/* still gyro frames needed before the bias is updated */
+#define MOTION_PLUS_STILL_FRAMES 50
+
+/* weight of the running mean in the bias, per still frame */
+#define MOTION_PLUS_BIAS_RATE 0.01f
+
+void motion_plus_event(struct motion_plus_t *mp, int exp_type, byte *msg, const struct gforce_t *accel,
+                       uint64_t ns);
 
 void wiiuse_motion_plus_handshake(struct wiimote_t *wm, byte *data, unsigned short len);
 
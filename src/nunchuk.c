@@ -55,8 +55,10 @@ int nunchuk_handshake(struct wiimote_t *wm, struct nunchuk_t *nc, byte *data, un
     nc->btns_released = 0;
 
     /* set the smoothing to the same as the wiimote */
-    nc->flags                = &wm->flags;
-    nc->accel_calib.st_alpha = wm->accel_calib.st_alpha;
+    nc->flags                     = &wm->flags;
+    nc->accel_calib.st_alpha      = wm->accel_calib.st_alpha;
+    nc->accel_calib.st_min_cutoff = wm->accel_calib.st_min_cutoff;
+    nc->accel_calib.st_beta       = wm->accel_calib.st_beta;
 
     if (data[0] == 0xFF || len < HANDSHAKE_BYTES_USED)
     {
@@ -91,6 +93,10 @@ int nunchuk_handshake(struct wiimote_t *wm, struct nunchuk_t *nc, byte *data, un
     nc->accel_calib.cal_g.x    = data[4];
     nc->accel_calib.cal_g.y    = data[5];
     nc->accel_calib.cal_g.z    = data[6];
+    if (*nc->flags & WIIUSE_ORIENT_LUT)
+    {
+        accel_build_orient_lut(&nc->accel_calib);
+    }
     nc->js.max.x               = data[8];
     nc->js.min.x               = data[9];
     nc->js.center.x            = data[10];
@@ -111,6 +117,8 @@ int nunchuk_handshake(struct wiimote_t *wm, struct nunchuk_t *nc, byte *data, un
         nc->js.max.y = 255;
     }
 
+    joystick_build_lut(&nc->js);
+
     /* default the thresholds to the same as the wiimote */
     nc->orient_threshold = wm->orient_threshold;
     nc->accel_threshold  = wm->accel_threshold;
@@ -130,15 +138,21 @@ int nunchuk_handshake(struct wiimote_t *wm, struct nunchuk_t *nc, byte *data, un
  *
  *	@param nc		A pointer to a nunchuk_t structure.
  */
-void nunchuk_disconnected(struct nunchuk_t *nc) { memset(nc, 0, sizeof(struct nunchuk_t)); }
+void nunchuk_disconnected(struct nunchuk_t *nc)
+{
+    accel_free_orient_lut(&nc->accel_calib);
+    joystick_free_lut(&nc->js);
+    memset(nc, 0, sizeof(struct nunchuk_t));
+}
 
 /**
  *	@brief Handle nunchuk event.
  *
  *	@param nc		A pointer to a nunchuk_t structure.
  *	@param msg		The message specified in the event packet.
+ *	@param ns		Time the report arrived (ns).
  */
-void nunchuk_event(struct nunchuk_t *nc, byte *msg)
+void nunchuk_event(struct nunchuk_t *nc, byte *msg, uint64_t ns)
 {
 
     /* get button states */
@@ -153,7 +167,7 @@ void nunchuk_event(struct nunchuk_t *nc, byte *msg)
     nc->accel.z = msg[4];
 
     calculate_orientation(&nc->accel_calib, &nc->accel, &nc->orient,
-                          NUNCHUK_IS_FLAG_SET(nc, WIIUSE_SMOOTHING));
+                          NUNCHUK_IS_FLAG_SET(nc, WIIUSE_SMOOTHING), ns);
     calculate_gforce(&nc->accel_calib, &nc->accel, &nc->gforce);
 }
 
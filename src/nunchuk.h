@@ -46,7 +46,7 @@ int nunchuk_handshake(struct wiimote_t *wm, struct nunchuk_t *nc, byte *data, un
 
 void nunchuk_disconnected(struct nunchuk_t *nc);
 
-void nunchuk_event(struct nunchuk_t *nc, byte *msg);
+void nunchuk_event(struct nunchuk_t *nc, byte *msg, uint64_t ns);
 
 void nunchuk_pressed_buttons(struct nunchuk_t *nc, byte now);
 /** @} */
@@ -36,6 +36,12 @@
 
 #include "wiiuse_internal.h"
 
+/* wiiuse_os_write() did not send, the report has to be sent again later */
+#define WIIUSE_OS_WOULD_BLOCK (-2)
+
+/* a kernel receive stamp older than this (ns) is not trusted */
+#define WIIUSE_OS_MAX_STAMP_AGE 1000000000LL
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -44,8 +50,13 @@ extern "C" {
 /** @{ */
 void wiiuse_init_platform_fields(struct wiimote_t *wm);
 void wiiuse_cleanup_platform_fields(struct wiimote_t *wm);
+void wiiuse_os_set_bdaddr(struct wiimote_t *wm, const char *bdaddr);
+/* the address found or set, NULL if none or where the platform does not use it */
+const char *wiiuse_os_get_bdaddr(struct wiimote_t *wm);
 
 int wiiuse_os_find(struct wiimote_t **wm, int max_wiimotes, int timeout);
+/* the adapters that are up, 0 where the platform does not let us pick one */
+int wiiuse_os_adapters(int *adapters, int max);
 
 int wiiuse_os_connect(struct wiimote_t **wm, int wiimotes);
 void wiiuse_os_disconnect(struct wiimote_t *wm);
@@ -53,9 +64,12 @@ void wiiuse_os_disconnect(struct wiimote_t *wm);
 int wiiuse_os_poll(struct wiimote_t **wm, int wiimotes);
 /* buf[0] will be the report type, buf+1 the rest of the report */
 int wiiuse_os_read(struct wiimote_t *wm, byte *buf, int len);
+/* returns WIIUSE_OS_WOULD_BLOCK if the report can not be sent without waiting */
 int wiiuse_os_write(struct wiimote_t *wm, byte report_type, byte *buf, int len);
 
+/* monotonic clocks, wiiuse_os_read() stamps wiimote_t::report_ns on the second one */
 unsigned long wiiuse_os_ticks();
+uint64_t wiiuse_os_ticks_ns();
 /** @} */
 
 #ifdef __cplusplus
@@ -30,19 +30,20 @@
 #include "../os.h"
 
 #ifdef __MACH__
-	#include <mach/clock.h>
-	#include <mach/mach.h>
+	#include <mach/mach_time.h>
 #endif
 
 unsigned long wiiuse_os_ticks() {
-	struct timespec ts;
-  	clock_serv_t cclock;
-  	mach_timespec_t mts;
-  	host_get_clock_service(mach_host_self(), CALENDAR_CLOCK, &cclock);
-  	clock_get_time(cclock, &mts);
-  	mach_port_deallocate(mach_task_self(), cclock);
-  	ts.tv_sec = mts.tv_sec;
-  	ts.tv_nsec = mts.tv_nsec;
-  	unsigned long ms = 1000 * ts.tv_sec + ts.tv_nsec / 1e6;
-  	return ms;
+	return (unsigned long)(wiiuse_os_ticks_ns() / 1000000);
+}
+
+uint64_t wiiuse_os_ticks_ns() {
+	static mach_timebase_info_data_t timebase;
+	uint64_t t = mach_absolute_time();
+
+	if (!timebase.denom)
+		mach_timebase_info(&timebase);
+
+	/* split to keep the multiplication from overflowing */
+	return (t / timebase.denom) * timebase.numer + (t % timebase.denom) * timebase.numer / timebase.denom;
 }
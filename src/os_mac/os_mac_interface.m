@@ -177,6 +177,7 @@ int wiiuse_os_read(struct wiimote_t* wm, byte* buf, int len) {
 	
 	WiiuseWiimote* objc_wm = (WiiuseWiimote*) wm->objc_wm;
 	int result = [objc_wm readBuffer: buf length: len];
+	if(result > 0) wm->report_ns = wiiuse_os_ticks_ns();
 	
 	[pool drain];
 	return result;
@@ -219,4 +220,22 @@ void wiiuse_cleanup_platform_fields(struct wiimote_t* wm) {
 	wm->objc_wm = NULL;
 }
 
+int wiiuse_os_adapters(int* adapters, int max) {
+	// IOBluetooth only drives the host controller it picked
+	(void)adapters;
+	(void)max;
+	return 0;
+}
+
+void wiiuse_os_set_bdaddr(struct wiimote_t* wm, const char* bdaddr) {
+	// devices are found by the IOBluetooth inquiry, the address is not used
+	(void)wm;
+	(void)bdaddr;
+}
+
+const char* wiiuse_os_get_bdaddr(struct wiimote_t* wm) {
+	(void)wm;
+	return NULL;
+}
+
 #endif // __APPLE__
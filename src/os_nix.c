@@ -54,13 +54,57 @@
 
 static int wiiuse_os_connect_single(struct wiimote_t *wm, char *address);
 
+/** @brief Adapters collected by wiiuse_os_adapters(). */
+struct adapter_list_t
+{
+    int *adapters;
+    int count;
+    int max;
+};
+
+static int add_adapter(int sock, int dev_id, long arg)
+{
+    struct adapter_list_t *list = (struct adapter_list_t *)arg;
+
+    (void)sock;
+    if (list->count < list->max)
+    {
+        list->adapters[list->count++] = dev_id;
+    }
+
+    /* 0 goes on to the next adapter */
+    return 0;
+}
+
+/**
+ *	@brief List the bluetooth adapters that are up.
+ *
+ *	@param adapters		Array that receives the HCI device ids.
+ *	@param max			Room in \a adapters.
+ *
+ *	@return The number of adapters.
+ */
+int wiiuse_os_adapters(int *adapters, int max)
+{
+    struct adapter_list_t list;
+
+    list.adapters = adapters;
+    list.count    = 0;
+    list.max      = max;
+    hci_for_each_dev(HCI_UP, add_adapter, (long)&list);
+
+    return list.count;
+}
+
 int wiiuse_os_find(struct wiimote_t **wm, int max_wiimotes, int timeout)
 {
+    int adapters[WIIUSE_MAX_ADAPTERS];
+    int adapter_count;
     int device_id;
     int device_sock;
     inquiry_info scan_info_arr[128];
     inquiry_info *scan_info = scan_info_arr;
-    int found_devices;
+    int found_devices = -1;
     int found_wiimotes;
     int i = 0;
 
@@ -72,40 +116,46 @@ int wiiuse_os_find(struct wiimote_t **wm, int max_wiimotes, int timeout)
     }
     found_wiimotes = 0;
 
-    /* get the id of the first bluetooth device. */
-    device_id = hci_get_route(NULL);
-    if (device_id < 0)
+    adapter_count = wiiuse_os_adapters(adapters, WIIUSE_MAX_ADAPTERS);
+    if (!adapter_count)
     {
-        if (errno == ENODEV)
-        {
-            WIIUSE_ERROR("Could not detect a Bluetooth adapter!");
-        } else
-        {
-            perror("hci_get_route");
-        }
+        WIIUSE_ERROR("Could not detect a Bluetooth adapter!");
         return 0;
     }
 
-    /* create a socket to the device */
-    device_sock = hci_open_dev(device_id);
-    if (device_sock < 0)
+    /* an inquiry holds up the links of its adapter, use the least loaded one that works */
+    wiiuse_sort_adapters(wm, max_wiimotes, adapters, adapter_count);
+    for (i = 0; i < adapter_count; ++i)
     {
-        perror("hci_open_dev");
-        return 0;
-    }
+        device_id = adapters[i];
 
-    memset(&scan_info_arr, 0, sizeof(scan_info_arr));
+        /* create a socket to the device */
+        device_sock = hci_open_dev(device_id);
+        if (device_sock < 0)
+        {
+            perror("hci_open_dev");
+            continue;
+        }
+
+        memset(&scan_info_arr, 0, sizeof(scan_info_arr));
+
+        /* scan for bluetooth devices for 'timeout' seconds */
+        found_devices = hci_inquiry(device_id, timeout, 128, NULL, &scan_info, IREQ_CACHE_FLUSH);
+        if (found_devices >= 0)
+        {
+            break;
+        }
 
-    /* scan for bluetooth devices for 'timeout' seconds */
-    found_devices = hci_inquiry(device_id, timeout, 128, NULL, &scan_info, IREQ_CACHE_FLUSH);
-    if (found_devices < 0)
-    {
         perror("hci_inquiry");
         close(device_sock);
+    }
+
+    if (found_devices < 0)
+    {
         return 0;
     }
 
-    WIIUSE_INFO("Found %i bluetooth device(s).", found_devices);
+    WIIUSE_INFO("Found %i bluetooth device(s) with hci%i.", found_devices, device_id);
 
     /* display discovered devices */
     for (i = 0; (i < found_devices) && (found_wiimotes < max_wiimotes); ++i)
@@ -172,6 +222,30 @@ int wiiuse_os_connect(struct wiimote_t **wm, int wiimotes)
     return connected;
 }
 
+/**
+ *	@brief Make a socket go out through the adapter of its wiimote.
+ *
+ *	@return 0 on success, -1 on failure.
+ */
+static int bind_adapter(struct wiimote_t *wm, int sock)
+{
+    struct sockaddr_l2 local;
+
+    if (wm->adapter < 0)
+    {
+        return 0;
+    }
+
+    memset(&local, 0, sizeof(local));
+    local.l2_family = AF_BLUETOOTH;
+    if (hci_devba(wm->adapter, &local.l2_bdaddr) < 0)
+    {
+        return -1;
+    }
+
+    return bind(sock, (struct sockaddr *)&local, sizeof(local));
+}
+
 /**
  *	@brief Connect to a wiimote with a known address.
  *
@@ -216,6 +290,14 @@ static int wiiuse_os_connect_single(struct wiimote_t *wm, char *address)
 
     addr.l2_psm = htobs(WM_OUTPUT_CHANNEL);
 
+    if (bind_adapter(wm, wm->out_sock) < 0)
+    {
+        perror("bind() output sock");
+        close(wm->out_sock);
+        wm->out_sock = -1;
+        return 0;
+    }
+
     /* connect to wiimote */
     if (connect(wm->out_sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
     {
@@ -236,6 +318,16 @@ static int wiiuse_os_connect_single(struct wiimote_t *wm, char *address)
 
     addr.l2_psm = htobs(WM_INPUT_CHANNEL);
 
+    if (bind_adapter(wm, wm->in_sock) < 0)
+    {
+        perror("bind() interrupt sock");
+        close(wm->in_sock);
+        close(wm->out_sock);
+        wm->in_sock  = -1;
+        wm->out_sock = -1;
+        return 0;
+    }
+
     /* connect to wiimote */
     if (connect(wm->in_sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
     {
@@ -245,7 +337,21 @@ static int wiiuse_os_connect_single(struct wiimote_t *wm, char *address)
         return 0;
     }
 
-    WIIUSE_INFO("Connected to wiimote [id %i].", wm->unid);
+    if (wm->adapter < 0)
+    {
+        WIIUSE_INFO("Connected to wiimote [id %i].", wm->unid);
+    } else
+    {
+        WIIUSE_INFO("Connected to wiimote [id %i] with hci%i.", wm->unid, wm->adapter);
+    }
+
+#ifdef SO_TIMESTAMPNS
+    {
+        /* have the kernel stamp the reports as they arrive */
+        int on = 1;
+        setsockopt(wm->in_sock, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+    }
+#endif
 
     /* do the handshake */
     WIIMOTE_ENABLE_STATE(wm, WIIMOTE_STATE_CONNECTED);
@@ -258,13 +364,20 @@ static int wiiuse_os_connect_single(struct wiimote_t *wm, char *address)
 
 void wiiuse_os_disconnect(struct wiimote_t *wm)
 {
-    if (!wm || WIIMOTE_IS_CONNECTED(wm))
+    if (!wm)
     {
         return;
     }
 
-    close(wm->out_sock);
-    close(wm->in_sock);
+    /* a remote disconnect leaves the sockets open, they are closed here */
+    if (wm->out_sock != -1)
+    {
+        close(wm->out_sock);
+    }
+    if (wm->in_sock != -1)
+    {
+        close(wm->in_sock);
+    }
 
     wm->out_sock = -1;
     wm->in_sock  = -1;
@@ -370,11 +483,76 @@ int wiiuse_os_poll(struct wiimote_t **wm, int wiimotes)
     return evnt;
 }
 
+/**
+ *	@brief Receive a report and stamp wiimote_t::report_ns.
+ *
+ *	The kernel stamps SO_TIMESTAMPNS on the realtime clock; its age is
+ *	taken off the monotonic time of the read, which keeps the stamp
+ *	monotonic however the realtime clock jumps.  Without a kernel stamp
+ *	the time of the read is used.
+ */
+static int recv_stamped(struct wiimote_t *wm, byte *buf, int len)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    int rc;
+#ifdef SO_TIMESTAMPNS
+    union
+    {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(struct timespec))];
+    } control;
+    struct cmsghdr *cmsg;
+#endif
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base   = buf;
+    iov.iov_len    = len;
+    msg.msg_iov    = &iov;
+    msg.msg_iovlen = 1;
+#ifdef SO_TIMESTAMPNS
+    msg.msg_control    = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+#endif
+
+    rc = recvmsg(wm->in_sock, &msg, MSG_DONTWAIT);
+    if (rc <= 0)
+    {
+        return rc;
+    }
+
+    wm->report_ns = wiiuse_os_ticks_ns();
+
+#ifdef SO_TIMESTAMPNS
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            struct timespec stamp, now;
+            int64_t age;
+
+            memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+            clock_gettime(CLOCK_REALTIME, &now);
+            age = (int64_t)(now.tv_sec - stamp.tv_sec) * 1000000000LL + (now.tv_nsec - stamp.tv_nsec);
+
+            /* a realtime clock step in between gives a nonsense age */
+            if (age > 0 && age < WIIUSE_OS_MAX_STAMP_AGE)
+            {
+                wm->report_ns -= (uint64_t)age;
+            }
+            break;
+        }
+    }
+#endif
+
+    return rc;
+}
+
 int wiiuse_os_read(struct wiimote_t *wm, byte *buf, int len)
 {
     int rc;
 
-    rc = recv(wm->in_sock, buf, len, MSG_DONTWAIT);
+    rc = recv_stamped(wm, buf, len);
     if (rc == -1)
     {
         switch(errno)
@@ -438,10 +616,15 @@ int wiiuse_os_write(struct wiimote_t *wm, byte report_type, byte *buf, int len)
     write_buffer[1] = report_type;
     memcpy(write_buffer + 2, buf, len);
 
-    rc = send(wm->in_sock, write_buffer, len + 2, 0);
+    rc = send(wm->in_sock, write_buffer, len + 2, MSG_DONTWAIT);
 
     if (rc < 0)
     {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            /* the socket buffer is full, the output queue tries again */
+            return WIIUSE_OS_WOULD_BLOCK;
+        }
         wiiuse_disconnected(wm);
     }
 
@@ -461,12 +644,36 @@ void wiiuse_cleanup_platform_fields(struct wiimote_t *wm)
     wm->in_sock  = -1;
 }
 
-unsigned long wiiuse_os_ticks()
+/**
+ *	@brief Set the address of a wiimote, as if wiiuse_os_find() had found it.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *	@param bdaddr	The address, as in "00:1F:C5:00:00:00".
+ */
+void wiiuse_os_set_bdaddr(struct wiimote_t *wm, const char *bdaddr)
+{
+    str2ba(bdaddr, &wm->bdaddr);
+    ba2str(&wm->bdaddr, wm->bdaddr_str);
+    WIIMOTE_ENABLE_STATE(wm, WIIMOTE_STATE_DEV_FOUND);
+}
+
+/**
+ *	@brief Address of a wiimote found by wiiuse_os_find() or set by wiiuse_os_set_bdaddr().
+ *
+ *	@return The address, as in "00:1F:C5:00:00:00", or NULL if there is none.
+ */
+const char *wiiuse_os_get_bdaddr(struct wiimote_t *wm)
+{
+    return WIIMOTE_IS_SET(wm, WIIMOTE_STATE_DEV_FOUND) ? wm->bdaddr_str : NULL;
+}
+
+unsigned long wiiuse_os_ticks() { return (unsigned long)(wiiuse_os_ticks_ns() / 1000000); }
+
+uint64_t wiiuse_os_ticks_ns()
 {
     struct timespec tp;
-    clock_gettime(CLOCK_REALTIME, &tp);
-    unsigned long ms = 1000 * tp.tv_sec + tp.tv_nsec / 1e6;
-    return ms;
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return (uint64_t)tp.tv_sec * 1000000000ULL + (uint64_t)tp.tv_nsec;
 }
 
 #endif /* ifdef WIIUSE_BLUEZ */
@@ -43,21 +43,27 @@
 #include <hidsdi.h>
 #include <setupapi.h>
 
-unsigned long wiiuse_os_ticks()
+unsigned long wiiuse_os_ticks() { return (unsigned long)(wiiuse_os_ticks_ns() / 1000000); }
+
+uint64_t wiiuse_os_ticks_ns()
 {
-    FILETIME ft;
-    ULARGE_INTEGER hnsTime;
+    LARGE_INTEGER freq, now;
 
-#if _WIN32_WINNT >= _WIN32_WINNT_WIN10
-    GetSystemTimePreciseAsFileTime(&ft);
-#else
-    GetSystemTimeAsFileTime(&ft);
-#endif
+    /* cheap and fixed at boot, no need to keep it in a shared static */
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
 
-    hnsTime.LowPart = ft.dwLowDateTime;
-    hnsTime.HighPart = ft.dwHighDateTime;
+    /* split to keep the multiplication from overflowing */
+    return (uint64_t)(now.QuadPart / freq.QuadPart) * 1000000000ULL
+           + (uint64_t)(now.QuadPart % freq.QuadPart) * 1000000000ULL / (uint64_t)freq.QuadPart;
+}
 
-    return hnsTime.QuadPart / 10000ULL;
+/* the HID stack picks the adapter */
+int wiiuse_os_adapters(int *adapters, int max)
+{
+    (void)adapters;
+    (void)max;
+    return 0;
 }
 
 int wiiuse_os_find(struct wiimote_t **wm, int max_wiimotes, int timeout)
@@ -194,12 +200,15 @@ int wiiuse_os_connect(struct wiimote_t **wm, int wiimotes)
 
 void wiiuse_os_disconnect(struct wiimote_t *wm)
 {
-    if (!wm || WIIMOTE_IS_CONNECTED(wm))
+    if (!wm)
     {
         return;
     }
 
-    CloseHandle(wm->dev_handle);
+    if (wm->dev_handle)
+    {
+        CloseHandle(wm->dev_handle);
+    }
     wm->dev_handle = 0;
 
     ResetEvent(&wm->hid_overlap);
@@ -305,6 +314,8 @@ int wiiuse_os_read(struct wiimote_t *wm, byte *buf, int len)
 #endif
     }
 
+    wm->report_ns = wiiuse_os_ticks_ns();
+
     ResetEvent(wm->hid_overlap.hEvent);
     return 1;
 }
@@ -367,4 +378,17 @@ void wiiuse_init_platform_fields(struct wiimote_t *wm)
 
 void wiiuse_cleanup_platform_fields(struct wiimote_t *wm) { wm->dev_handle = 0; }
 
+/* HID devices are found by enumeration, the address is not used */
+void wiiuse_os_set_bdaddr(struct wiimote_t *wm, const char *bdaddr)
+{
+    (void)wm;
+    (void)bdaddr;
+}
+
+const char *wiiuse_os_get_bdaddr(struct wiimote_t *wm)
+{
+    (void)wm;
+    return NULL;
+}
+
 #endif /* ifdef WIIUSE_WIN32 */
@@ -0,0 +1,430 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Output report queue.
+ *
+ *	Every output report passes through a per-wiimote queue with three
+ *	priority classes and a token bucket rate limit.  A report that can
+ *	go out at once is sent straight away; the others wait in the ring
+ *	buffer of their class, so a burst of memory writes can not hold up
+ *	rumble or LED changes.  The socket is never waited on, a report the
+ *	platform can not take yet stays queued for the next wiiuse_poll().
+ */
+
+#include "outqueue.h"
+
+#include "os.h" /* for wiiuse_os_write, wiiuse_os_ticks */
+
+#include <stdio.h>  /* for printf */
+#include <string.h> /* for memcpy */
+
+#define OUTQ_MASK (WIIUSE_OUTQ_LEN - 1)
+
+/**
+ *	@brief Priority class of an output report.
+ */
+static int report_class(byte report_type)
+{
+    switch (report_type)
+    {
+    case WM_CMD_LED:
+    case WM_CMD_RUMBLE: /* also WM_CMD_IR, the same report */
+    case WM_CMD_IR_2:
+    case WM_CMD_SPEAKER_DATA:
+        return WIIUSE_OUTQ_REALTIME;
+
+    case WM_CMD_WRITE_DATA:
+    case WM_CMD_READ_DATA:
+    case WM_CMD_SPEAKER_MUTE:
+        /* the speaker is unmuted only after its registers are written */
+        return WIIUSE_OUTQ_BULK;
+
+    default:
+        return WIIUSE_OUTQ_CONFIG;
+    }
+}
+
+/**
+ *	@brief If a newer report of this type replaces a waiting one.
+ *
+ *	LED and rumble reports carry the whole state, only the last counts.
+ */
+static int report_replaces(byte report_type)
+{
+    return report_type == WM_CMD_LED || report_type == WM_CMD_RUMBLE;
+}
+
+/**
+ *	@brief Hand a report to the platform.
+ */
+static int transmit(struct wiimote_t *wm, byte report_type, byte *msg, int len)
+{
+    int rc;
+
+    /* every output report carries the rumble flag in bit 0 of its first byte */
+    if (WIIMOTE_IS_SET(wm, WIIMOTE_STATE_RUMBLE))
+    {
+        msg[0] |= 0x01;
+    } else
+    {
+        msg[0] &= ~0x01;
+    }
+
+#ifdef WITH_WIIUSE_DEBUG
+    {
+        int x;
+        printf("[DEBUG] (id %i) SEND: (%.2x) %.2x ", wm->unid, report_type, msg[0]);
+        for (x = 1; x < len; ++x)
+        {
+            printf("%.2x ", msg[x]);
+        }
+        printf("\n");
+    }
+#endif
+
+    rc = wiiuse_os_write(wm, report_type, msg, len);
+    if (rc > 0)
+    {
+        wm->rumble.on_air = (msg[0] & 0x01);
+    }
+
+    return rc;
+}
+
+/**
+ *	@brief Add the tokens earned since the bucket was last filled.
+ */
+static void fill_bucket(struct outqueue_t *q, unsigned long ticks)
+{
+    unsigned long cap     = (unsigned long)q->burst * OUTQ_TOKEN;
+    unsigned long elapsed = ticks - q->tokens_ticks;
+
+    q->tokens_ticks = ticks;
+    if (!q->rate)
+    {
+        return;
+    }
+
+    if (elapsed >= cap / q->rate + 1)
+    {
+        q->tokens = cap;
+    } else
+    {
+        q->tokens += elapsed * q->rate;
+        if (q->tokens > cap)
+        {
+            q->tokens = cap;
+        }
+    }
+}
+
+/**
+ *	@brief Take the token for one report.
+ *
+ *	@return 1 if the report may go out now, 0 if the rate limit is reached.
+ */
+static int take_token(struct outqueue_t *q)
+{
+    if (!q->rate)
+    {
+        return 1;
+    }
+    if (q->tokens < OUTQ_TOKEN)
+    {
+        return 0;
+    }
+
+    q->tokens -= OUTQ_TOKEN;
+    return 1;
+}
+
+/**
+ *	@brief Return the token of a report the platform did not take.
+ */
+static void return_token(struct outqueue_t *q)
+{
+    if (q->rate)
+    {
+        q->tokens += OUTQ_TOKEN;
+    }
+}
+
+/**
+ *	@brief Count a sent report.
+ */
+static void account_sent(struct outq_stats_t *st, unsigned long waited)
+{
+    st->sent++;
+    st->latency_sum += waited;
+    if (waited > st->latency_max)
+    {
+        st->latency_max = waited;
+    }
+}
+
+/**
+ *	@brief Reset the output queue of a wiimote.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ */
+void outqueue_init(struct wiimote_t *wm)
+{
+    memset(&wm->outq, 0, sizeof(wm->outq));
+
+    wm->outq.rate         = WIIUSE_OUTQ_RATE;
+    wm->outq.burst        = WIIUSE_OUTQ_BURST;
+    wm->outq.tokens       = WIIUSE_OUTQ_BURST * OUTQ_TOKEN;
+    wm->outq.tokens_ticks = wiiuse_os_ticks();
+}
+
+/**
+ *	@brief Send a report, or queue it if it can not go out now.
+ *
+ *	@param wm			Pointer to a wiimote_t structure.
+ *	@param report_type	The report type.
+ *	@param msg			The payload, at most 21 bytes.
+ *	@param len			Length of the payload in bytes.
+ *
+ *	@return What wiiuse_os_write() returned if the report was sent,
+ *	\a len if it was queued, 0 if it was dropped.
+ */
+int outqueue_send(struct wiimote_t *wm, byte report_type, byte *msg, int len)
+{
+    struct outqueue_t *q = &wm->outq;
+    struct outq_stats_t *st;
+    struct outq_report_t *r;
+    unsigned long ticks = wiiuse_os_ticks();
+    int cls             = report_class(report_type);
+    unsigned int i;
+    int rc;
+
+    if (len <= 0 || len > (int)sizeof(r->data))
+    {
+        WIIUSE_ERROR("Invalid length %i for output report 0x%x.", len, report_type);
+        return 0;
+    }
+    st = &q->stats[cls];
+
+    /* the reports already waiting go first */
+    outqueue_pump(wm, ticks);
+
+    /* send at once unless reports of the same or a higher class wait */
+    for (i = 0; i <= (unsigned int)cls && !q->stats[i].depth; ++i)
+        ;
+    if (i > (unsigned int)cls && take_token(q))
+    {
+        rc = transmit(wm, report_type, msg, len);
+        if (rc != WIIUSE_OS_WOULD_BLOCK)
+        {
+            if (rc > 0)
+            {
+                account_sent(st, 0);
+            } else
+            {
+                st->dropped++;
+            }
+            return rc;
+        }
+        return_token(q);
+    }
+
+    if (report_replaces(report_type))
+    {
+        for (i = 0; i < st->depth; ++i)
+        {
+            r = &q->report[cls][(q->head[cls] + i) & OUTQ_MASK];
+            if (r->type == report_type)
+            {
+                memcpy(r->data, msg, len);
+                r->len = (byte)len;
+                return len;
+            }
+        }
+    }
+
+    if (st->depth == WIIUSE_OUTQ_LEN)
+    {
+        WIIUSE_WARNING("Output queue full, dropped report 0x%x for wiimote id %i.", report_type, wm->unid);
+        st->dropped++;
+        return 0;
+    }
+
+    r        = &q->report[cls][(q->head[cls] + st->depth) & OUTQ_MASK];
+    r->type  = report_type;
+    r->len   = (byte)len;
+    r->ticks = ticks;
+    memcpy(r->data, msg, len);
+
+    st->depth++;
+    if (st->depth > st->max_depth)
+    {
+        st->max_depth = st->depth;
+    }
+
+    return len;
+}
+
+/**
+ *	@brief Send the queued reports the rate limit allows.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *	@param ticks	The current time (ms).
+ *
+ *	Called from wiiuse_poll().  Higher classes go first, each class in
+ *	the order it was queued.  Stops at the first report the platform
+ *	can not take without waiting.
+ */
+void outqueue_pump(struct wiimote_t *wm, unsigned long ticks)
+{
+    struct outqueue_t *q = &wm->outq;
+    int cls, rc;
+
+    fill_bucket(q, ticks);
+
+    for (cls = 0; cls < WIIUSE_OUTQ_CLASSES; ++cls)
+    {
+        struct outq_stats_t *st = &q->stats[cls];
+
+        while (st->depth)
+        {
+            struct outq_report_t *r = &q->report[cls][q->head[cls] & OUTQ_MASK];
+
+            if (!take_token(q))
+            {
+                return;
+            }
+
+            rc = transmit(wm, r->type, r->data, r->len);
+            if (rc == WIIUSE_OS_WOULD_BLOCK)
+            {
+                return_token(q);
+                return;
+            }
+
+            /* a failed send may have disconnected and cleared the queue */
+            if (!st->depth)
+            {
+                return;
+            }
+
+            if (rc > 0)
+            {
+                account_sent(st, ticks - r->ticks);
+            } else
+            {
+                st->dropped++;
+            }
+            q->head[cls]++;
+            st->depth--;
+        }
+    }
+}
+
+/**
+ *	@brief Wait until every queued report is sent.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *
+ *	For the blocking reads of the synchronous handshake, which wait for
+ *	an answer without polling.  Gives up after OUTQ_FLUSH_TIMEOUT.
+ */
+void outqueue_flush(struct wiimote_t *wm)
+{
+    unsigned long start = wiiuse_os_ticks();
+    unsigned long ticks = start;
+    int cls;
+
+    for (;;)
+    {
+        outqueue_pump(wm, ticks);
+
+        for (cls = 0; cls < WIIUSE_OUTQ_CLASSES && !wm->outq.stats[cls].depth; ++cls)
+            ;
+        if (cls == WIIUSE_OUTQ_CLASSES)
+        {
+            return;
+        }
+
+        if (ticks - start >= OUTQ_FLUSH_TIMEOUT)
+        {
+            WIIUSE_WARNING("Output queue of wiimote id %i did not drain.", wm->unid);
+            return;
+        }
+
+        wiiuse_millisleep(1);
+        ticks = wiiuse_os_ticks();
+    }
+}
+
+/**
+ *	@brief Drop every queued report.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ */
+void outqueue_clear(struct wiimote_t *wm)
+{
+    int cls;
+
+    for (cls = 0; cls < WIIUSE_OUTQ_CLASSES; ++cls)
+    {
+        wm->outq.head[cls]        = 0;
+        wm->outq.stats[cls].depth = 0;
+    }
+}
+
+/**
+ *	@brief	Set the rate limit of the output reports.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *	@param rate		Reports per second, 0 for no limit.
+ *	@param burst	Reports that may go out back to back after a pause.
+ *
+ *	The default is WIIUSE_OUTQ_RATE reports per second in bursts of
+ *	WIIUSE_OUTQ_BURST.  Queue depth and latency are in
+ *	wiimote_t::outq.stats, one entry per outq_class_t.
+ */
+void wiiuse_set_output_rate(struct wiimote_t *wm, unsigned int rate, unsigned int burst)
+{
+    unsigned long cap;
+
+    if (!wm)
+    {
+        return;
+    }
+
+    if (burst < 1)
+    {
+        burst = 1;
+    }
+
+    fill_bucket(&wm->outq, wiiuse_os_ticks());
+    wm->outq.rate  = rate;
+    wm->outq.burst = burst;
+
+    cap = (unsigned long)burst * OUTQ_TOKEN;
+    if (!rate || wm->outq.tokens > cap)
+    {
+        wm->outq.tokens = cap;
+    }
+}
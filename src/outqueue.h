@@ -0,0 +1,56 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Output report queue.
+ */
+
+#ifndef OUTQUEUE_H_INCLUDED
+#define OUTQUEUE_H_INCLUDED
+
+#include "wiiuse_internal.h"
+
+/* a report costs this many tokens of the rate limit */
+#define OUTQ_TOKEN 1000
+
+/* longest time (ms) outqueue_flush() waits for the queue to empty */
+#define OUTQ_FLUSH_TIMEOUT 1000
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup internal_outqueue Internal: Output queue */
+/** @{ */
+void outqueue_init(struct wiimote_t *wm);
+int outqueue_send(struct wiimote_t *wm, byte report_type, byte *msg, int len);
+void outqueue_pump(struct wiimote_t *wm, unsigned long ticks);
+void outqueue_flush(struct wiimote_t *wm);
+void outqueue_clear(struct wiimote_t *wm);
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OUTQUEUE_H_INCLUDED */
@@ -0,0 +1,680 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Device registry.
+ *
+ *	A registry holds a set of wiimotes that can grow and shrink while the
+ *	program runs, as an alternative to the fixed array of wiiuse_init().
+ *	Removing a device moves the last one into its place, so the array
+ *	never has holes.  Lookups by unid and by bluetooth address go through
+ *	hash tables with linear probing, kept at most 3/4 full.
+ *
+ *	wiiuse_find(), wiiuse_connect() and the disconnects call
+ *	registry_update(), which indexes the address a wiimote was found at
+ *	and keeps the list of connected wiimotes.
+ */
+
+#include "registry.h"
+
+#include "context.h" /* for context_alloc, context_free */
+#include "os.h"      /* for wiiuse_os_set_bdaddr */
+
+#include <ctype.h>  /* for toupper */
+#include <string.h> /* for memcpy, memset, strcmp, strlen */
+
+/**
+ *	@brief Hash of a unid.
+ */
+static unsigned int hash_unid(int unid) { return (unsigned int)unid * 2654435761u; }
+
+/**
+ *	@brief FNV-1a hash of a bluetooth address, ignoring case.
+ */
+static unsigned int hash_bdaddr(const char *bdaddr)
+{
+    unsigned int h = 2166136261u;
+
+    for (; *bdaddr; ++bdaddr)
+    {
+        h ^= (unsigned char)toupper((unsigned char)*bdaddr);
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+/**
+ *	@brief Copy a bluetooth address in upper case.
+ *
+ *	@return 1 on success, 0 if \a bdaddr does not have the length of an address.
+ */
+static int normalize_bdaddr(char *dst, const char *bdaddr)
+{
+    int i;
+
+    if (strlen(bdaddr) != REGISTRY_BDADDR_LEN - 1)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < REGISTRY_BDADDR_LEN - 1; ++i)
+    {
+        dst[i] = (char)toupper((unsigned char)bdaddr[i]);
+    }
+    dst[i] = '\0';
+
+    return 1;
+}
+
+/**
+ *	@brief Find the unid table slot of a device.
+ */
+static struct registry_slot_t *find_unid(struct wiiuse_registry_t *reg, int unid)
+{
+    unsigned int mask = 2 * reg->capacity - 1;
+    unsigned int i    = hash_unid(unid) & mask;
+
+    for (; reg->by_unid[i].index != REGISTRY_SLOT_EMPTY; i = (i + 1) & mask)
+    {
+        if (reg->by_unid[i].index >= 0 && reg->by_unid[i].key == (unsigned int)unid)
+        {
+            return &reg->by_unid[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ *	@brief Find the address table slot of a device.
+ *
+ *	@param bdaddr	The address, in upper case.
+ */
+static struct registry_slot_t *find_bdaddr(struct wiiuse_registry_t *reg, const char *bdaddr)
+{
+    unsigned int mask = 2 * reg->capacity - 1;
+    unsigned int h    = hash_bdaddr(bdaddr);
+    unsigned int i    = h & mask;
+
+    for (; reg->by_bdaddr[i].index != REGISTRY_SLOT_EMPTY; i = (i + 1) & mask)
+    {
+        struct registry_slot_t *s = &reg->by_bdaddr[i];
+
+        if (s->index >= 0 && s->key == h && !strcmp(reg->bdaddr[s->index], bdaddr))
+        {
+            return s;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ *	@brief Put a key in a free slot of a table.
+ *
+ *	Deleted slots are not reused, they are dropped when the tables are rebuilt.
+ */
+static void insert_slot(struct registry_slot_t *table, unsigned int mask, unsigned int hash, unsigned int key,
+                        int index)
+{
+    unsigned int i = hash & mask;
+
+    while (table[i].index != REGISTRY_SLOT_EMPTY)
+    {
+        i = (i + 1) & mask;
+    }
+
+    table[i].key   = key;
+    table[i].index = index;
+}
+
+/**
+ *	@brief Add device \a index to the hash tables.
+ */
+static void insert_device(struct wiiuse_registry_t *reg, int index)
+{
+    unsigned int mask = 2 * reg->capacity - 1;
+    int unid          = reg->wm[index]->unid;
+
+    insert_slot(reg->by_unid, mask, hash_unid(unid), (unsigned int)unid, index);
+
+    if (reg->bdaddr[index][0])
+    {
+        unsigned int h = hash_bdaddr(reg->bdaddr[index]);
+        insert_slot(reg->by_bdaddr, mask, h, h, index);
+    }
+}
+
+/**
+ *	@brief Resize the arrays and build the hash tables again.
+ *
+ *	@param reg			The registry.
+ *	@param capacity		The new capacity, a power of 2 not below the device count.
+ *
+ *	@return 1 on success, 0 if out of memory, the registry is then unchanged.
+ */
+static int rebuild(struct wiiuse_registry_t *reg, int capacity)
+{
+    struct wiimote_t **wm              = reg->wm;
+    char(*bdaddr)[REGISTRY_BDADDR_LEN] = reg->bdaddr;
+    int *connected_at                  = reg->connected_at;
+    struct wiimote_t **connected       = reg->connected;
+    struct registry_slot_t *by_unid    = context_alloc(reg->ctx, 2 * capacity * sizeof(struct registry_slot_t));
+    struct registry_slot_t *by_bdaddr  = context_alloc(reg->ctx, 2 * capacity * sizeof(struct registry_slot_t));
+    int i;
+
+    if (capacity != reg->capacity)
+    {
+        wm           = context_alloc(reg->ctx, capacity * sizeof(struct wiimote_t *));
+        bdaddr       = context_alloc(reg->ctx, capacity * REGISTRY_BDADDR_LEN);
+        connected_at = context_alloc(reg->ctx, capacity * sizeof(int));
+        connected    = context_alloc(reg->ctx, capacity * sizeof(struct wiimote_t *));
+    }
+
+    if (!wm || !bdaddr || !connected_at || !connected || !by_unid || !by_bdaddr)
+    {
+        if (capacity != reg->capacity)
+        {
+            context_free(reg->ctx, wm);
+            context_free(reg->ctx, bdaddr);
+            context_free(reg->ctx, connected_at);
+            context_free(reg->ctx, connected);
+        }
+        context_free(reg->ctx, by_unid);
+        context_free(reg->ctx, by_bdaddr);
+        return 0;
+    }
+
+    if (capacity != reg->capacity)
+    {
+        if (reg->count)
+        {
+            memcpy(wm, reg->wm, reg->count * sizeof(struct wiimote_t *));
+            memcpy(bdaddr, reg->bdaddr, reg->count * REGISTRY_BDADDR_LEN);
+            memcpy(connected_at, reg->connected_at, reg->count * sizeof(int));
+        }
+        if (reg->connected_count)
+        {
+            memcpy(connected, reg->connected, reg->connected_count * sizeof(struct wiimote_t *));
+        }
+        context_free(reg->ctx, reg->wm);
+        context_free(reg->ctx, reg->bdaddr);
+        context_free(reg->ctx, reg->connected_at);
+        context_free(reg->ctx, reg->connected);
+        reg->wm           = wm;
+        reg->bdaddr       = bdaddr;
+        reg->connected_at = connected_at;
+        reg->connected    = connected;
+        reg->capacity     = capacity;
+    }
+
+    for (i = 0; i < 2 * capacity; ++i)
+    {
+        by_unid[i].index   = REGISTRY_SLOT_EMPTY;
+        by_bdaddr[i].index = REGISTRY_SLOT_EMPTY;
+    }
+    context_free(reg->ctx, reg->by_unid);
+    context_free(reg->ctx, reg->by_bdaddr);
+    reg->by_unid   = by_unid;
+    reg->by_bdaddr = by_bdaddr;
+    reg->deleted   = 0;
+
+    for (i = 0; i < reg->count; ++i)
+    {
+        insert_device(reg, i);
+    }
+
+    return 1;
+}
+
+/**
+ *	@brief Take device \a index out of the list of connected devices.
+ */
+static void unlink_connected(struct wiiuse_registry_t *reg, int index)
+{
+    int at = reg->connected_at[index];
+    struct wiimote_t *last;
+
+    if (at < 0)
+    {
+        return;
+    }
+
+    /* the last connected device takes its place */
+    last               = reg->connected[--reg->connected_count];
+    reg->connected[at] = last;
+
+    reg->connected_at[find_unid(reg, last->unid)->index] = at;
+    reg->connected_at[index]                             = -1;
+}
+
+/**
+ *	@brief Index device \a index by the address the platform has for it.
+ *
+ *	An address given to wiiuse_registry_add() stays unless the platform
+ *	reports another one.  An address another device already has is not
+ *	indexed twice.
+ */
+static void update_bdaddr(struct wiiuse_registry_t *reg, int index)
+{
+    const char *found = wiiuse_os_get_bdaddr(reg->wm[index]);
+    char addr[REGISTRY_BDADDR_LEN];
+    struct registry_slot_t *s;
+    unsigned int h;
+
+    if (!found || !normalize_bdaddr(addr, found) || !strcmp(addr, reg->bdaddr[index]))
+    {
+        return;
+    }
+
+    s = find_bdaddr(reg, addr);
+    if (s)
+    {
+        WIIUSE_WARNING("Wiimote id %i has the address of wiimote id %i, %s.", reg->wm[index]->unid,
+                       reg->wm[s->index]->unid, addr);
+        return;
+    }
+
+    if (reg->bdaddr[index][0])
+    {
+        find_bdaddr(reg, reg->bdaddr[index])->index = REGISTRY_SLOT_DELETED;
+        reg->deleted++;
+    }
+
+    memcpy(reg->bdaddr[index], addr, REGISTRY_BDADDR_LEN);
+    h = hash_bdaddr(addr);
+    insert_slot(reg->by_bdaddr, 2 * reg->capacity - 1, h, h, index);
+
+    /* a failed rebuild leaves the tables as they are, fuller but working */
+    if (4 * (reg->count + reg->deleted) > 3 * 2 * reg->capacity)
+    {
+        rebuild(reg, reg->capacity);
+    }
+}
+
+/**
+ *	@brief Update the registry of a wiimote after it was found, connected or disconnected.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *
+ *	Indexes the address the wiimote was found at and adds it to or
+ *	takes it out of the connected devices.  Does nothing for a wiimote
+ *	of no registry.
+ */
+void registry_update(struct wiimote_t *wm)
+{
+    struct wiiuse_registry_t *reg = wm ? wm->registry : NULL;
+    struct registry_slot_t *s;
+    int index;
+
+    if (!reg)
+    {
+        return;
+    }
+
+    s = find_unid(reg, wm->unid);
+    if (!s || reg->wm[s->index] != wm)
+    {
+        return;
+    }
+    index = s->index;
+
+    update_bdaddr(reg, index);
+
+    if (WIIMOTE_IS_CONNECTED(wm))
+    {
+        if (reg->connected_at[index] < 0)
+        {
+            reg->connected_at[index]               = reg->connected_count;
+            reg->connected[reg->connected_count++] = wm;
+        }
+    } else
+    {
+        unlink_connected(reg, index);
+    }
+}
+
+/**
+ *	@brief Create an empty registry.
+ *
+ *	@param ctx		Context whose allocator the registry and its wiimotes use, or NULL.
+ */
+struct wiiuse_registry_t *registry_new(struct wiiuse_context_t *ctx)
+{
+    struct wiiuse_registry_t *reg = context_alloc(ctx, sizeof(struct wiiuse_registry_t));
+
+    if (!reg)
+    {
+        return NULL;
+    }
+
+    memset(reg, 0, sizeof(struct wiiuse_registry_t));
+    reg->ctx       = ctx;
+    reg->next_unid = 1;
+    if (!rebuild(reg, REGISTRY_MIN_CAPACITY))
+    {
+        context_free(ctx, reg);
+        return NULL;
+    }
+
+    return reg;
+}
+
+/**
+ *	@brief Disconnect and free every device of a registry, and the registry.
+ */
+void registry_free(struct wiiuse_registry_t *reg)
+{
+    struct wiiuse_context_t *ctx = reg->ctx;
+    int i;
+
+    for (i = 0; i < reg->count; ++i)
+    {
+        reg->wm[i]->registry = NULL;
+        wiiuse_delete_wiimote(reg->wm[i]);
+    }
+
+    context_free(ctx, reg->wm);
+    context_free(ctx, reg->bdaddr);
+    context_free(ctx, reg->connected_at);
+    context_free(ctx, reg->connected);
+    context_free(ctx, reg->by_unid);
+    context_free(ctx, reg->by_bdaddr);
+    context_free(ctx, reg);
+}
+
+/**
+ *	@brief	Create an empty device registry.
+ *
+ *	@return The registry, or NULL if out of memory.  Free it with
+ *	wiiuse_registry_free().
+ *
+ *	Unlike the array of wiiuse_init(), a registry can take and give back
+ *	wiimotes at any time, see wiiuse_registry_add() and
+ *	wiiuse_registry_remove().
+ */
+struct wiiuse_registry_t *wiiuse_registry_new() { return registry_new(NULL); }
+
+/**
+ *	@brief	Disconnect and free every device of a registry, and the registry.
+ *
+ *	@param reg		The registry.
+ *
+ *	The registry of a context is freed by wiiuse_context_free().
+ */
+void wiiuse_registry_free(struct wiiuse_registry_t *reg)
+{
+    if (!reg)
+    {
+        return;
+    }
+
+    if (reg->ctx)
+    {
+        WIIUSE_WARNING("The registry of a context is freed with the context.");
+        return;
+    }
+
+    registry_free(reg);
+}
+
+/**
+ *	@brief	Add a new wiimote to a registry.
+ *
+ *	@param reg		The registry.
+ *	@param bdaddr	Bluetooth address of the wiimote, as in "00:1F:C5:00:00:00",
+ *					or NULL to leave it to wiiuse_find().
+ *
+ *	@return The new wiimote, or NULL on error.  If a wiimote with this
+ *	address is already registered, that one is returned.
+ *
+ *	Every wiimote gets a unid no other wiimote of the registry had
+ *	before.  With an address the wiimote can be connected with
+ *	wiiuse_connect() without searching for it first (Linux only).
+ */
+struct wiimote_t *wiiuse_registry_add(struct wiiuse_registry_t *reg, const char *bdaddr)
+{
+    char addr[REGISTRY_BDADDR_LEN] = "";
+    struct registry_slot_t *s;
+    struct wiimote_t *wm;
+
+    if (!reg)
+    {
+        return NULL;
+    }
+
+    if (bdaddr)
+    {
+        if (!normalize_bdaddr(addr, bdaddr))
+        {
+            WIIUSE_ERROR("Invalid bluetooth address \"%s\".", bdaddr);
+            return NULL;
+        }
+
+        s = find_bdaddr(reg, addr);
+        if (s)
+        {
+            return reg->wm[s->index];
+        }
+    }
+
+    /* keep the tables at most 3/4 full, counting the deleted slots */
+    if (reg->count == reg->capacity)
+    {
+        if (!rebuild(reg, 2 * reg->capacity))
+        {
+            WIIUSE_ERROR("Unable to grow the device registry.");
+            return NULL;
+        }
+    } else if (4 * (reg->count + 1 + reg->deleted) > 3 * 2 * reg->capacity)
+    {
+        if (!rebuild(reg, reg->capacity))
+        {
+            WIIUSE_ERROR("Unable to rebuild the device registry.");
+            return NULL;
+        }
+    }
+
+    wm = wiiuse_new_wiimote(reg->ctx, reg->next_unid);
+    if (!wm)
+    {
+        return NULL;
+    }
+    reg->next_unid++;
+    wm->registry = reg;
+
+    if (addr[0])
+    {
+        wiiuse_os_set_bdaddr(wm, addr);
+    }
+
+    reg->wm[reg->count] = wm;
+    memcpy(reg->bdaddr[reg->count], addr, REGISTRY_BDADDR_LEN);
+    reg->connected_at[reg->count] = -1;
+    insert_device(reg, reg->count);
+    reg->count++;
+
+    return wm;
+}
+
+/**
+ *	@brief	Disconnect a wiimote, take it out of its registry and free it.
+ *
+ *	@param reg		The registry.
+ *	@param wm		Pointer to a wiimote_t structure of the registry.
+ *
+ *	The last wiimote of wiiuse_registry_devices() takes the place of the
+ *	removed one, so the order of the devices changes.
+ */
+void wiiuse_registry_remove(struct wiiuse_registry_t *reg, struct wiimote_t *wm)
+{
+    struct registry_slot_t *s;
+    int index, last;
+
+    if (!reg || !wm)
+    {
+        return;
+    }
+
+    s = find_unid(reg, wm->unid);
+    if (!s || reg->wm[s->index] != wm)
+    {
+        WIIUSE_WARNING("Wiimote id %i is not in the registry.", wm->unid);
+        return;
+    }
+
+    index = s->index;
+    unlink_connected(reg, index);
+
+    s->index = REGISTRY_SLOT_DELETED;
+    if (reg->bdaddr[index][0])
+    {
+        find_bdaddr(reg, reg->bdaddr[index])->index = REGISTRY_SLOT_DELETED;
+    }
+    reg->deleted++;
+
+    /* move the last device into the hole */
+    last = reg->count - 1;
+    if (index != last)
+    {
+        reg->wm[index]           = reg->wm[last];
+        reg->connected_at[index] = reg->connected_at[last];
+        memcpy(reg->bdaddr[index], reg->bdaddr[last], REGISTRY_BDADDR_LEN);
+
+        find_unid(reg, reg->wm[index]->unid)->index = index;
+        if (reg->bdaddr[index][0])
+        {
+            find_bdaddr(reg, reg->bdaddr[index])->index = index;
+        }
+    }
+    reg->count--;
+
+    wm->registry = NULL;
+    wiiuse_delete_wiimote(wm);
+}
+
+/**
+ *	@brief	Find a wiimote of a registry by its unid.
+ *
+ *	@param reg		The registry.
+ *	@param unid		The unid of the wiimote.
+ *
+ *	@return The wiimote, or NULL if there is none with this unid.
+ */
+struct wiimote_t *wiiuse_registry_get_by_id(struct wiiuse_registry_t *reg, int unid)
+{
+    struct registry_slot_t *s;
+
+    if (!reg)
+    {
+        return NULL;
+    }
+
+    s = find_unid(reg, unid);
+    return s ? reg->wm[s->index] : NULL;
+}
+
+/**
+ *	@brief	Find a wiimote of a registry by its bluetooth address.
+ *
+ *	@param reg		The registry.
+ *	@param bdaddr	The address, in any case.
+ *
+ *	@return The wiimote, or NULL if there is none with this address.
+ *
+ *	A wiimote is known by the address given to wiiuse_registry_add(),
+ *	or else by the one wiiuse_find() found it at (Linux only).
+ */
+struct wiimote_t *wiiuse_registry_get_by_bdaddr(struct wiiuse_registry_t *reg, const char *bdaddr)
+{
+    char addr[REGISTRY_BDADDR_LEN];
+    struct registry_slot_t *s;
+
+    if (!reg || !bdaddr || !normalize_bdaddr(addr, bdaddr))
+    {
+        return NULL;
+    }
+
+    s = find_bdaddr(reg, addr);
+    return s ? reg->wm[s->index] : NULL;
+}
+
+/**
+ *	@brief	Get every wiimote of a registry.
+ *
+ *	@param reg		The registry.
+ *	@param count	Set to the number of wiimotes.
+ *
+ *	@return The array of wiimotes, it can be passed to wiiuse_find(),
+ *	wiiuse_connect() and wiiuse_poll().  Valid until the next
+ *	wiiuse_registry_add() or wiiuse_registry_remove().
+ */
+struct wiimote_t **wiiuse_registry_devices(struct wiiuse_registry_t *reg, int *count)
+{
+    if (!reg)
+    {
+        if (count)
+        {
+            *count = 0;
+        }
+        return NULL;
+    }
+
+    if (count)
+    {
+        *count = reg->count;
+    }
+    return reg->wm;
+}
+
+/**
+ *	@brief	Get the connected wiimotes of a registry.
+ *
+ *	@param reg		The registry.
+ *	@param wm		Array that receives the connected wiimotes.
+ *	@param max		Room in \a wm.
+ *
+ *	@return The number of wiimotes put in \a wm.
+ *
+ *	The registry keeps this list as wiimotes connect and disconnect,
+ *	so it takes no search.  The order is not that of
+ *	wiiuse_registry_devices().
+ */
+int wiiuse_registry_connected(struct wiiuse_registry_t *reg, struct wiimote_t **wm, int max)
+{
+    int n;
+
+    if (!reg || !wm || max <= 0)
+    {
+        return 0;
+    }
+
+    n = (reg->connected_count < max) ? reg->connected_count : max;
+    if (n)
+    {
+        memcpy(wm, reg->connected, n * sizeof(struct wiimote_t *));
+    }
+
+    return n;
+}
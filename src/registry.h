@@ -0,0 +1,94 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Device registry.
+ */
+
+#ifndef REGISTRY_H_INCLUDED
+#define REGISTRY_H_INCLUDED
+
+#include "wiiuse_internal.h"
+
+/* devices a new registry has room for, a power of 2 */
+#define REGISTRY_MIN_CAPACITY 4
+
+/* length of a bluetooth address string with its terminator, "00:1F:C5:00:00:00" */
+#define REGISTRY_BDADDR_LEN 18
+
+/* index of a hash table slot that was never used, or whose entry was removed */
+#define REGISTRY_SLOT_EMPTY (-1)
+#define REGISTRY_SLOT_DELETED (-2)
+
+/**
+ *	@brief Hash table slot, maps a key to a position in the device array.
+ */
+struct registry_slot_t
+{
+    unsigned int key; /**< unid, or hash of the bluetooth address	*/
+    int index;        /**< position in the device array, or REGISTRY_SLOT_* */
+};
+
+/**
+ *	@brief Device registry, see wiiuse_registry_new().
+ *
+ *	The devices sit in one array without gaps, so the array can be
+ *	handed to wiiuse_poll() as it is.  Two open addressing hash tables
+ *	find a device by unid or bluetooth address, and a second array
+ *	holds the connected devices.
+ */
+struct wiiuse_registry_t
+{
+    struct wiimote_t **wm;               /**< the devices					*/
+    char (*bdaddr)[REGISTRY_BDADDR_LEN]; /**< address of each device, "" if none	*/
+    int *connected_at;                   /**< position of each device in connected, -1 if none */
+    int count;                           /**< devices in the registry		*/
+    int capacity;                        /**< room in the arrays, a power of 2	*/
+
+    struct wiimote_t **connected; /**< the connected devices, in no order	*/
+    int connected_count;          /**< devices in connected				*/
+
+    struct registry_slot_t *by_unid;   /**< unid table, 2 * capacity slots	*/
+    struct registry_slot_t *by_bdaddr; /**< address table, 2 * capacity slots	*/
+    int deleted;                       /**< deleted slots in each table		*/
+
+    int next_unid;                /**< unid of the next device added	*/
+    struct wiiuse_context_t *ctx; /**< context that owns the registry, or NULL */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup internal_registry Internal: Registry */
+/** @{ */
+struct wiiuse_registry_t *registry_new(struct wiiuse_context_t *ctx);
+void registry_free(struct wiiuse_registry_t *reg);
+void registry_update(struct wiimote_t *wm);
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REGISTRY_H_INCLUDED */
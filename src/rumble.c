@@ -0,0 +1,393 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Rumble effects.
+ *
+ *	Intensity is the duty cycle of a software PWM.  The motor switches
+ *	of every wiimote with a running effect are kept in one timer wheel
+ *	with 1 ms slots, so wiiuse_poll() only looks at the slots that
+ *	passed since the last poll, however many wiimotes rumble.  The
+ *	wiimotes of a wiiuse_context_t share its wheel, all others share
+ *	one wheel of the process.
+ *
+ *	Every output report carries the rumble bit, so a switch is left for
+ *	RUMBLE_FOLD_MS to ride on a report that is sent anyway (LEDs, speaker
+ *	data, ...) before a report is sent just for it.  A switch is thus
+ *	late by at most RUMBLE_FOLD_MS plus the time between two polls.
+ */
+
+#include "rumble.h"
+
+#include "context.h" /* for wiiuse_context_t */
+#include "os.h"      /* for wiiuse_os_ticks */
+
+#define RUMBLE_WHEEL_MASK (RUMBLE_WHEEL_SLOTS - 1)
+
+static struct rumble_wheel_t rumble_wheel;
+
+static void rumble_fire(struct wiimote_t *wm, unsigned long ticks);
+
+/**
+ *	@brief The timer wheel a wiimote goes on.
+ */
+static struct rumble_wheel_t *wheel_of(struct wiimote_t *wm) { return wm->ctx ? &wm->ctx->wheel : &rumble_wheel; }
+
+/**
+ *	@brief Take a wiimote off the timer wheel.
+ */
+static void wheel_remove(struct wiimote_t *wm)
+{
+    struct rumble_t *r = &wm->rumble;
+
+    if (!r->pprev)
+    {
+        return;
+    }
+
+    *r->pprev = r->next;
+    if (r->next)
+    {
+        r->next->rumble.pprev = r->pprev;
+    }
+    r->next  = NULL;
+    r->pprev = NULL;
+}
+
+/**
+ *	@brief Put a wiimote on the timer wheel.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *	@param expiry	Time the timer fires, never before the next poll.
+ */
+static void wheel_insert(struct wiimote_t *wm, unsigned long expiry)
+{
+    struct rumble_t *r           = &wm->rumble;
+    struct rumble_wheel_t *wheel = wheel_of(wm);
+    struct wiimote_t **slot;
+
+    wheel_remove(wm);
+
+    /* slots up to wheel->ticks were already visited */
+    if ((long)(expiry - wheel->ticks) <= 0)
+    {
+        expiry = wheel->ticks + 1;
+    }
+
+    slot      = &wheel->slot[expiry & RUMBLE_WHEEL_MASK];
+    r->expiry = expiry;
+    r->next   = *slot;
+    if (*slot)
+    {
+        (*slot)->rumble.pprev = &r->next;
+    }
+    *slot    = wm;
+    r->pprev = slot;
+}
+
+/**
+ *	@brief Send a report just for the rumble bit.
+ *
+ *	Same report as wiiuse_rumble(), wiiuse_send() sets the bit.
+ */
+static void send_rumble_bit(struct wiimote_t *wm)
+{
+    byte buf = wm->leds;
+
+    /* preserve IR state */
+    if (WIIMOTE_IS_SET(wm, WIIMOTE_STATE_IR))
+    {
+        buf |= 0x04;
+    }
+
+    wiiuse_send(wm, WM_CMD_RUMBLE, &buf, 1);
+}
+
+/**
+ *	@brief Switch the motor, the report goes out with the next one sent.
+ */
+static void set_motor(struct wiimote_t *wm, int on, unsigned long ticks)
+{
+    if (!on == !WIIMOTE_IS_SET(wm, WIIMOTE_STATE_RUMBLE))
+    {
+        return;
+    }
+
+    if (on)
+    {
+        WIIMOTE_ENABLE_STATE(wm, WIIMOTE_STATE_RUMBLE);
+    } else
+    {
+        WIIMOTE_DISABLE_STATE(wm, WIIMOTE_STATE_RUMBLE);
+    }
+
+    if (!on != !wm->rumble.on_air)
+    {
+        wm->rumble.fold_ticks = ticks + RUMBLE_FOLD_MS;
+    }
+}
+
+/**
+ *	@brief Duty cycle of the effect at a given time.
+ *
+ *	@return The duty cycle [0-1], or -1 once the effect is over.
+ */
+static float rumble_envelope(const struct rumble_t *r, unsigned long ticks)
+{
+    unsigned long t = ticks - r->start_ticks;
+
+    if (t < r->attack)
+    {
+        return r->level * (float)t / (float)r->attack;
+    }
+    t -= r->attack;
+
+    if (r->sustain == WIIUSE_RUMBLE_FOREVER || t < r->sustain)
+    {
+        return r->level;
+    }
+    t -= r->sustain;
+
+    if (t < r->release)
+    {
+        return r->level * (1.0f - (float)t / (float)r->release);
+    }
+
+    return -1.0f;
+}
+
+/**
+ *	@brief Start a PWM period.
+ */
+static void start_period(struct wiimote_t *wm, unsigned long ticks)
+{
+    struct rumble_t *r = &wm->rumble;
+    float level;
+    unsigned long on;
+
+    /* keep the periods back to back unless a poll came very late */
+    if (ticks - r->period_ticks >= 2 * RUMBLE_PWM_PERIOD)
+    {
+        r->period_ticks = ticks;
+    } else
+    {
+        r->period_ticks += RUMBLE_PWM_PERIOD;
+    }
+
+    level = rumble_envelope(r, r->period_ticks);
+    if (level < 0.0f)
+    {
+        /* the effect is over */
+        r->active    = 0;
+        r->off_ticks = 0;
+        set_motor(wm, 0, ticks);
+        return;
+    }
+
+    on = (unsigned long)(level * RUMBLE_PWM_PERIOD + 0.5f);
+    if (on < RUMBLE_PWM_MIN_PULSE)
+    {
+        on = 0;
+    } else if (on > RUMBLE_PWM_PERIOD - RUMBLE_PWM_MIN_PULSE)
+    {
+        on = RUMBLE_PWM_PERIOD;
+    }
+
+    r->off_ticks = (on && on < RUMBLE_PWM_PERIOD) ? r->period_ticks + on : 0;
+    set_motor(wm, on != 0, ticks);
+}
+
+/**
+ *	@brief Handle the timer of a wiimote and queue the next one.
+ */
+static void rumble_fire(struct wiimote_t *wm, unsigned long ticks)
+{
+    struct rumble_t *r = &wm->rumble;
+    unsigned long next = 0;
+    int queue          = 0;
+
+    if (!WIIMOTE_IS_CONNECTED(wm))
+    {
+        r->active = 0;
+        return;
+    }
+
+    if (r->active)
+    {
+        if ((long)(ticks - (r->period_ticks + RUMBLE_PWM_PERIOD)) >= 0)
+        {
+            start_period(wm, ticks);
+        } else if (r->off_ticks && (long)(ticks - r->off_ticks) >= 0)
+        {
+            r->off_ticks = 0;
+            set_motor(wm, 0, ticks);
+        }
+    }
+
+    /* no other report carried the switch in time */
+    if (!WIIMOTE_IS_SET(wm, WIIMOTE_STATE_RUMBLE) != !r->on_air && (long)(ticks - r->fold_ticks) >= 0)
+    {
+        send_rumble_bit(wm);
+    }
+
+    if (r->active)
+    {
+        next  = r->off_ticks ? r->off_ticks : r->period_ticks + RUMBLE_PWM_PERIOD;
+        queue = 1;
+    }
+    if (!WIIMOTE_IS_SET(wm, WIIMOTE_STATE_RUMBLE) != !r->on_air
+        && (!queue || (long)(r->fold_ticks - next) < 0))
+    {
+        next  = r->fold_ticks;
+        queue = 1;
+    }
+
+    if (queue)
+    {
+        wheel_insert(wm, next);
+    }
+}
+
+/**
+ *	@brief Fire the rumble timers that expired.
+ *
+ *	@param wm		Pointer to a wiimote_t structure, the timers of its wheel fire.
+ *	@param ticks	The current time (ms).
+ *
+ *	Called from wiiuse_poll() for every wiimote, a wheel that was
+ *	already visited at \a ticks is skipped.
+ */
+void rumble_pump(struct wiimote_t *wm, unsigned long ticks)
+{
+    struct rumble_wheel_t *wheel = wheel_of(wm);
+    unsigned long t;
+
+    if ((long)(ticks - wheel->ticks) <= 0)
+    {
+        return;
+    }
+
+    /* after a long gap one pass over the wheel visits every slot */
+    if (ticks - wheel->ticks >= RUMBLE_WHEEL_SLOTS)
+    {
+        t = ticks - RUMBLE_WHEEL_SLOTS + 1;
+    } else
+    {
+        t = wheel->ticks + 1;
+    }
+    wheel->ticks = ticks;
+
+    for (; (long)(t - ticks) <= 0; ++t)
+    {
+        struct wiimote_t *timer = wheel->slot[t & RUMBLE_WHEEL_MASK];
+
+        while (timer)
+        {
+            struct wiimote_t *next = timer->rumble.next;
+
+            /* later rounds of the wheel stay */
+            if ((long)(timer->rumble.expiry - ticks) <= 0)
+            {
+                wheel_remove(timer);
+                rumble_fire(timer, ticks);
+            }
+            timer = next;
+        }
+    }
+}
+
+/**
+ *	@brief Stop the rumble effect of a wiimote, the motor is left as it is.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ */
+void rumble_cancel(struct wiimote_t *wm)
+{
+    wheel_remove(wm);
+    wm->rumble.active    = 0;
+    wm->rumble.off_ticks = 0;
+}
+
+/**
+ *	@brief	Run a rumble effect.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *	@param level	Peak intensity, from 0 (off) to 1 (full).
+ *	@param attack	Time (ms) to ramp up to \a level.
+ *	@param sustain	Time (ms) to stay at \a level, WIIUSE_RUMBLE_FOREVER to never stop.
+ *	@param release	Time (ms) to ramp down to 0.
+ *
+ *	Replaces the running effect.  The effect runs as long as
+ *	wiiuse_poll() is called.  wiiuse_rumble() stops it.
+ */
+void wiiuse_rumble_effect(struct wiimote_t *wm, float level, unsigned int attack, unsigned int sustain,
+                          unsigned int release)
+{
+    struct rumble_t *r;
+    unsigned long ticks;
+
+    if (!wm || !WIIMOTE_IS_CONNECTED(wm))
+    {
+        return;
+    }
+    r = &wm->rumble;
+
+    if (level > 1.0f)
+    {
+        level = 1.0f;
+    } else if (!(level > 0.0f))
+    {
+        level = 0.0f;
+    }
+
+    ticks = wiiuse_os_ticks();
+
+    wheel_remove(wm);
+    r->level       = level;
+    r->attack      = attack;
+    r->sustain     = sustain;
+    r->release     = release;
+    r->start_ticks = ticks;
+    r->active      = 1;
+
+    /* start the first period now */
+    r->period_ticks = ticks - RUMBLE_PWM_PERIOD;
+    rumble_fire(wm, ticks);
+}
+
+/**
+ *	@brief	Rumble at a constant intensity.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *	@param level	Intensity, from 0 (off) to 1 (full).
+ */
+void wiiuse_rumble_level(struct wiimote_t *wm, float level)
+{
+    if (!(level > 0.0f))
+    {
+        wiiuse_rumble(wm, 0);
+        return;
+    }
+
+    wiiuse_rumble_effect(wm, level, 0, WIIUSE_RUMBLE_FOREVER, 0);
+}
@@ -0,0 +1,68 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Rumble effects.
+ */
+
+#ifndef RUMBLE_H_INCLUDED
+#define RUMBLE_H_INCLUDED
+
+#include "wiiuse_internal.h"
+
+/* length of a PWM period (ms) */
+#define RUMBLE_PWM_PERIOD 30
+
+/* shortest pulse or gap (ms), the motor does not react to shorter ones */
+#define RUMBLE_PWM_MIN_PULSE 5
+
+/* a changed rumble bit waits this long (ms) for another report to carry it */
+#define RUMBLE_FOLD_MS 2
+
+/* slots of the timer wheel, 1 ms each, a power of 2 */
+#define RUMBLE_WHEEL_SLOTS 64
+
+/**
+ *	@brief Timer wheel of the wiimotes with a rumble effect or a pending switch.
+ */
+struct rumble_wheel_t
+{
+    struct wiimote_t *slot[RUMBLE_WHEEL_SLOTS]; /**< wiimotes by expiry, 1 ms each	*/
+    unsigned long ticks;                        /**< last time the wheel was visited	*/
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup internal_rumble Internal: Rumble */
+/** @{ */
+void rumble_pump(struct wiimote_t *wm, unsigned long ticks);
+void rumble_cancel(struct wiimote_t *wm);
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RUMBLE_H_INCLUDED */
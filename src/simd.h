@@ -0,0 +1,269 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Thin wrapper around the available SIMD instruction set.
+ *
+ *	The instruction set is picked at compile time: SSE2 on x86/x86-64,
+ *	NEON on ARM, and a plain C fallback everywhere else (or when the
+ *	library is built with WIIUSE_NO_SIMD defined).  Kernels are written
+ *	once against the simd4f_* operations below.
+ *
+ *	simdvf is the widest vector available, SIMDV_WIDTH floats: 8 when
+ *	the compiler targets AVX/AVX2, otherwise the same as simd4f.  Batch
+ *	kernels should prefer it and fall back to scalar code for the tail.
+ */
+
+#ifndef SIMD_H_INCLUDED
+#define SIMD_H_INCLUDED
+
+#include "wiiuse_internal.h"
+
+#if !defined(WIIUSE_NO_SIMD)                                                                                 \
+    && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define WIIUSE_SIMD_SSE2
+#include <emmintrin.h>
+#elif !defined(WIIUSE_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define WIIUSE_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(WIIUSE_SIMD_SSE2) && defined(__AVX__)
+#define WIIUSE_SIMD_AVX
+#include <immintrin.h>
+#endif
+
+#include <math.h> /* for the fallback versions of sqrtf, fabsf, copysignf */
+
+/** @addtogroup internal_general */
+/** @{ */
+
+/* Alignment used for SIMD-friendly buffers - one cache line. */
+#define WIIUSE_SIMD_ALIGN 64
+
+#if defined(WIIUSE_SIMD_SSE2)
+
+typedef __m128 simd4f;
+
+INLINE_UTIL simd4f simd4f_load(const float *p) { return _mm_loadu_ps(p); }
+INLINE_UTIL void simd4f_store(float *p, simd4f v) { _mm_storeu_ps(p, v); }
+INLINE_UTIL simd4f simd4f_set1(float f) { return _mm_set1_ps(f); }
+INLINE_UTIL simd4f simd4f_add(simd4f a, simd4f b) { return _mm_add_ps(a, b); }
+INLINE_UTIL simd4f simd4f_sub(simd4f a, simd4f b) { return _mm_sub_ps(a, b); }
+INLINE_UTIL simd4f simd4f_mul(simd4f a, simd4f b) { return _mm_mul_ps(a, b); }
+INLINE_UTIL simd4f simd4f_div(simd4f a, simd4f b) { return _mm_div_ps(a, b); }
+INLINE_UTIL simd4f simd4f_min(simd4f a, simd4f b) { return _mm_min_ps(a, b); }
+INLINE_UTIL simd4f simd4f_max(simd4f a, simd4f b) { return _mm_max_ps(a, b); }
+INLINE_UTIL simd4f simd4f_sqrt(simd4f a) { return _mm_sqrt_ps(a); }
+INLINE_UTIL simd4f simd4f_abs(simd4f a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+/* (a > b) ? x : y, per lane */
+INLINE_UTIL simd4f simd4f_select_gt(simd4f a, simd4f b, simd4f x, simd4f y)
+{
+    simd4f m = _mm_cmpgt_ps(a, b);
+    return _mm_or_ps(_mm_and_ps(m, x), _mm_andnot_ps(m, y));
+}
+/* magnitude of a with the sign of b */
+INLINE_UTIL simd4f simd4f_copysign(simd4f a, simd4f b)
+{
+    simd4f sign = _mm_set1_ps(-0.0f);
+    return _mm_or_ps(_mm_andnot_ps(sign, a), _mm_and_ps(sign, b));
+}
+
+#elif defined(WIIUSE_SIMD_NEON)
+
+typedef float32x4_t simd4f;
+
+INLINE_UTIL simd4f simd4f_load(const float *p) { return vld1q_f32(p); }
+INLINE_UTIL void simd4f_store(float *p, simd4f v) { vst1q_f32(p, v); }
+INLINE_UTIL simd4f simd4f_set1(float f) { return vdupq_n_f32(f); }
+INLINE_UTIL simd4f simd4f_add(simd4f a, simd4f b) { return vaddq_f32(a, b); }
+INLINE_UTIL simd4f simd4f_sub(simd4f a, simd4f b) { return vsubq_f32(a, b); }
+INLINE_UTIL simd4f simd4f_mul(simd4f a, simd4f b) { return vmulq_f32(a, b); }
+INLINE_UTIL simd4f simd4f_min(simd4f a, simd4f b) { return vminq_f32(a, b); }
+INLINE_UTIL simd4f simd4f_max(simd4f a, simd4f b) { return vmaxq_f32(a, b); }
+INLINE_UTIL simd4f simd4f_abs(simd4f a) { return vabsq_f32(a); }
+INLINE_UTIL simd4f simd4f_select_gt(simd4f a, simd4f b, simd4f x, simd4f y)
+{
+    return vbslq_f32(vcgtq_f32(a, b), x, y);
+}
+INLINE_UTIL simd4f simd4f_copysign(simd4f a, simd4f b)
+{
+    return vbslq_f32(vdupq_n_u32(0x80000000u), b, a);
+}
+#if defined(__aarch64__) || defined(_M_ARM64)
+INLINE_UTIL simd4f simd4f_div(simd4f a, simd4f b) { return vdivq_f32(a, b); }
+INLINE_UTIL simd4f simd4f_sqrt(simd4f a) { return vsqrtq_f32(a); }
+#else
+/* ARMv7 has no vector divide or square root.  The reciprocal estimates
+ * would not match the scalar code, so do these one lane at a time. */
+INLINE_UTIL simd4f simd4f_div(simd4f a, simd4f b)
+{
+    float x[4], y[4];
+    int i;
+
+    vst1q_f32(x, a);
+    vst1q_f32(y, b);
+    for (i = 0; i < 4; ++i)
+    {
+        x[i] /= y[i];
+    }
+    return vld1q_f32(x);
+}
+INLINE_UTIL simd4f simd4f_sqrt(simd4f a)
+{
+    float x[4];
+    int i;
+
+    vst1q_f32(x, a);
+    for (i = 0; i < 4; ++i)
+    {
+        x[i] = sqrtf(x[i]);
+    }
+    return vld1q_f32(x);
+}
+#endif
+
+#else /* plain C fallback */
+
+#include <string.h> /* for memcpy */
+
+typedef struct simd4f
+{
+    float v[4];
+} simd4f;
+
+#define SIMD4F_FALLBACK_OP(_NAME, _EXPR)                 \
+    INLINE_UTIL simd4f simd4f_##_NAME(simd4f a, simd4f b) \
+    {                                                    \
+        simd4f r;                                        \
+        int i;                                           \
+        for (i = 0; i < 4; ++i)                          \
+        {                                                \
+            r.v[i] = (_EXPR);                            \
+        }                                                \
+        return r;                                        \
+    }
+
+INLINE_UTIL simd4f simd4f_load(const float *p)
+{
+    simd4f r;
+    memcpy(r.v, p, sizeof(r.v));
+    return r;
+}
+INLINE_UTIL void simd4f_store(float *p, simd4f v) { memcpy(p, v.v, sizeof(v.v)); }
+INLINE_UTIL simd4f simd4f_set1(float f)
+{
+    simd4f r;
+    r.v[0] = r.v[1] = r.v[2] = r.v[3] = f;
+    return r;
+}
+SIMD4F_FALLBACK_OP(add, a.v[i] + b.v[i])
+SIMD4F_FALLBACK_OP(sub, a.v[i] - b.v[i])
+SIMD4F_FALLBACK_OP(mul, a.v[i] * b.v[i])
+SIMD4F_FALLBACK_OP(div, a.v[i] / b.v[i])
+SIMD4F_FALLBACK_OP(min, (a.v[i] < b.v[i]) ? a.v[i] : b.v[i])
+SIMD4F_FALLBACK_OP(max, (a.v[i] > b.v[i]) ? a.v[i] : b.v[i])
+SIMD4F_FALLBACK_OP(copysign, copysignf(a.v[i], b.v[i]))
+
+#undef SIMD4F_FALLBACK_OP
+
+INLINE_UTIL simd4f simd4f_sqrt(simd4f a)
+{
+    int i;
+    for (i = 0; i < 4; ++i)
+    {
+        a.v[i] = sqrtf(a.v[i]);
+    }
+    return a;
+}
+INLINE_UTIL simd4f simd4f_abs(simd4f a)
+{
+    int i;
+    for (i = 0; i < 4; ++i)
+    {
+        a.v[i] = fabsf(a.v[i]);
+    }
+    return a;
+}
+INLINE_UTIL simd4f simd4f_select_gt(simd4f a, simd4f b, simd4f x, simd4f y)
+{
+    int i;
+    for (i = 0; i < 4; ++i)
+    {
+        x.v[i] = (a.v[i] > b.v[i]) ? x.v[i] : y.v[i];
+    }
+    return x;
+}
+
+#endif
+
+#if defined(WIIUSE_SIMD_AVX)
+
+#define SIMDV_WIDTH 8
+typedef __m256 simdvf;
+
+INLINE_UTIL simdvf simdv_load(const float *p) { return _mm256_loadu_ps(p); }
+INLINE_UTIL void simdv_store(float *p, simdvf v) { _mm256_storeu_ps(p, v); }
+INLINE_UTIL simdvf simdv_set1(float f) { return _mm256_set1_ps(f); }
+INLINE_UTIL simdvf simdv_add(simdvf a, simdvf b) { return _mm256_add_ps(a, b); }
+INLINE_UTIL simdvf simdv_sub(simdvf a, simdvf b) { return _mm256_sub_ps(a, b); }
+INLINE_UTIL simdvf simdv_mul(simdvf a, simdvf b) { return _mm256_mul_ps(a, b); }
+INLINE_UTIL simdvf simdv_div(simdvf a, simdvf b) { return _mm256_div_ps(a, b); }
+INLINE_UTIL simdvf simdv_min(simdvf a, simdvf b) { return _mm256_min_ps(a, b); }
+INLINE_UTIL simdvf simdv_max(simdvf a, simdvf b) { return _mm256_max_ps(a, b); }
+INLINE_UTIL simdvf simdv_sqrt(simdvf a) { return _mm256_sqrt_ps(a); }
+INLINE_UTIL simdvf simdv_abs(simdvf a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+INLINE_UTIL simdvf simdv_select_gt(simdvf a, simdvf b, simdvf x, simdvf y)
+{
+    return _mm256_blendv_ps(y, x, _mm256_cmp_ps(a, b, _CMP_GT_OQ));
+}
+INLINE_UTIL simdvf simdv_copysign(simdvf a, simdvf b)
+{
+    simdvf sign = _mm256_set1_ps(-0.0f);
+    return _mm256_or_ps(_mm256_andnot_ps(sign, a), _mm256_and_ps(sign, b));
+}
+
+#else
+
+#define SIMDV_WIDTH 4
+typedef simd4f simdvf;
+
+#define simdv_load      simd4f_load
+#define simdv_store     simd4f_store
+#define simdv_set1      simd4f_set1
+#define simdv_add       simd4f_add
+#define simdv_sub       simd4f_sub
+#define simdv_mul       simd4f_mul
+#define simdv_div       simd4f_div
+#define simdv_min       simd4f_min
+#define simdv_max       simd4f_max
+#define simdv_sqrt      simd4f_sqrt
+#define simdv_abs       simd4f_abs
+#define simdv_select_gt simd4f_select_gt
+#define simdv_copysign  simd4f_copysign
+
+#endif
+
+/** @} */
+
+#endif /* SIMD_H_INCLUDED */
@@ -0,0 +1,363 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Speaker audio streaming.
+ *
+ *	PCM is encoded to Yamaha 4-bit ADPCM into a per-wiimote buffer and
+ *	sent in 0x18 reports.  Every report is due at a fixed time computed
+ *	from the start of the stream, so the stream does not drift however
+ *	irregularly wiiuse_poll() is called.
+ */
+
+#include "speaker.h"
+
+#include <string.h> /* for memset */
+
+#define SPEAKER_BUF_MASK (WIIUSE_SPEAKER_BUF_LEN - 1)
+
+static const int adpcm_diff[8]  = {1, 3, 5, 7, 9, 11, 13, 15};
+static const int adpcm_scale[8] = {230, 230, 230, 230, 307, 409, 512, 614};
+
+/**
+ *	@brief Encode one sample to a Yamaha ADPCM nibble.
+ *
+ *	@param sp		The speaker stream, holds the encoder state.
+ *	@param sample	16-bit PCM sample.
+ *
+ *	@return The nibble.
+ *
+ *	Every nibble depends on the predictor and step left by the one
+ *	before, so the encoder is inherently serial.
+ */
+static byte adpcm_encode(struct speaker_t *sp, int sample)
+{
+    int delta = sample - sp->predictor;
+    int nibble, d;
+
+    nibble = ((delta < 0 ? -delta : delta) * 4) / sp->step;
+    if (nibble > 7)
+    {
+        nibble = 7;
+    }
+
+    d        = (sp->step * adpcm_diff[nibble]) / 8;
+    sp->step = (sp->step * adpcm_scale[nibble]) >> 8;
+    if (delta < 0)
+    {
+        sp->predictor -= d;
+        nibble |= 8;
+    } else
+    {
+        sp->predictor += d;
+    }
+
+    if (sp->predictor > 32767)
+    {
+        sp->predictor = 32767;
+    } else if (sp->predictor < -32768)
+    {
+        sp->predictor = -32768;
+    }
+
+    if (sp->step < SPEAKER_ADPCM_STEP_MIN)
+    {
+        sp->step = SPEAKER_ADPCM_STEP_MIN;
+    } else if (sp->step > SPEAKER_ADPCM_STEP_MAX)
+    {
+        sp->step = SPEAKER_ADPCM_STEP_MAX;
+    }
+
+    return (byte)nibble;
+}
+
+/**
+ *	@brief Time the next report of a stream is due.
+ */
+static unsigned long speaker_due(const struct speaker_t *sp)
+{
+    return sp->start_ticks
+           + (unsigned long)(((uint64_t)sp->reports * SPEAKER_REPORT_SAMPLES * 1000) / sp->rate);
+}
+
+/**
+ *	@brief Reset the encoder and drop any queued audio.
+ */
+static void speaker_reset(struct speaker_t *sp)
+{
+    sp->predictor   = 0;
+    sp->step        = SPEAKER_ADPCM_STEP_MIN;
+    sp->nibble      = 0;
+    sp->has_nibble  = 0;
+    sp->head        = 0;
+    sp->tail        = 0;
+    sp->start_ticks = 0;
+    sp->reports     = 0;
+}
+
+/**
+ *	@brief	Enable or disable the speaker.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *	@param status	1 to enable, 0 to disable.
+ *	@param rate		Sample rate (Hz) of the PCM that will be written, ignored when disabling.
+ *	@param volume	Speaker volume, 0x40 is the usual level.  Ignored when disabling.
+ *
+ *	The speaker plays 4-bit ADPCM, the rate is rounded to what the
+ *	wiimote supports and stored in wiimote_t::speaker.rate.  Rates of
+ *	about 3000 Hz are the most the link sustains next to input reports.
+ *	Enabling an enabled speaker changes the rate and volume and drops
+ *	the queued audio.
+ */
+void wiiuse_set_speaker(struct wiimote_t *wm, int status, unsigned int rate, byte volume)
+{
+    struct speaker_t *sp;
+    byte buf[7];
+    unsigned int div;
+
+    if (!wm || !WIIMOTE_IS_CONNECTED(wm))
+    {
+        return;
+    }
+    sp = &wm->speaker;
+
+    if (!status)
+    {
+        if (!WIIMOTE_IS_SET(wm, WIIMOTE_STATE_SPEAKER) && !sp->rate)
+        {
+            return;
+        }
+
+        buf[0] = 0x04;
+        wiiuse_send(wm, WM_CMD_SPEAKER_MUTE, buf, 1);
+        buf[0] = 0x00;
+        wiiuse_send(wm, WM_CMD_SPEAKER_ENABLE, buf, 1);
+
+        speaker_reset(sp);
+        sp->rate = 0;
+        WIIMOTE_DISABLE_STATE(wm, WIIMOTE_STATE_SPEAKER);
+
+        WIIUSE_DEBUG("Disabled speaker for wiimote id %i.", wm->unid);
+        return;
+    }
+
+    if (!rate || rate > SPEAKER_ADPCM_CLOCK)
+    {
+        WIIUSE_ERROR("Invalid speaker sample rate %u.", rate);
+        return;
+    }
+    div = SPEAKER_ADPCM_CLOCK / rate;
+    if (div > 0xFFFF)
+    {
+        div = 0xFFFF;
+    }
+
+    /* enable and mute */
+    buf[0] = 0x04;
+    wiiuse_send(wm, WM_CMD_SPEAKER_ENABLE, buf, 1);
+    buf[0] = 0x04;
+    wiiuse_send(wm, WM_CMD_SPEAKER_MUTE, buf, 1);
+
+    buf[0] = 0x01;
+    wiiuse_write_data(wm, WM_REG_SPEAKER_ENABLE, buf, 1);
+    buf[0] = 0x08;
+    wiiuse_write_data(wm, WM_REG_SPEAKER_CONFIG, buf, 1);
+
+    /* 4-bit ADPCM, rate divider (little endian), volume */
+    buf[0] = 0x00;
+    buf[1] = 0x00;
+    buf[2] = div & 0xFF;
+    buf[3] = (div >> 8) & 0xFF;
+    buf[4] = volume;
+    buf[5] = 0x00;
+    buf[6] = 0x00;
+    wiiuse_write_data(wm, WM_REG_SPEAKER_CONFIG, buf, 7);
+
+    buf[0] = 0x01;
+    wiiuse_write_data(wm, WM_REG_SPEAKER_PLAY, buf, 1);
+
+    /* unmute */
+    buf[0] = 0x00;
+    wiiuse_send(wm, WM_CMD_SPEAKER_MUTE, buf, 1);
+
+    speaker_reset(sp);
+    sp->rate   = SPEAKER_ADPCM_CLOCK / div;
+    sp->volume = volume;
+    WIIMOTE_ENABLE_STATE(wm, WIIMOTE_STATE_SPEAKER);
+
+    WIIUSE_DEBUG("Enabled speaker for wiimote id %i (%u Hz).", wm->unid, sp->rate);
+}
+
+/**
+ *	@brief	Queue audio for the speaker.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *	@param pcm		16-bit signed PCM at the rate given to wiiuse_set_speaker().
+ *	@param samples	Number of samples in \a pcm.
+ *
+ *	@return The number of samples queued, less than \a samples when the buffer is full.
+ *
+ *	Never blocks.  The samples are sent by wiiuse_poll() as they become
+ *	due; queue the rest once the buffer has room again.
+ */
+int wiiuse_speaker_write(struct wiimote_t *wm, const int16_t *pcm, int samples)
+{
+    struct speaker_t *sp;
+    int i;
+
+    if (!wm || !pcm || !wm->speaker.rate)
+    {
+        return 0;
+    }
+    sp = &wm->speaker;
+
+    for (i = 0; i < samples; ++i)
+    {
+        if (sp->has_nibble)
+        {
+            /* the first sample of a byte is in the high nibble */
+            sp->buf[sp->tail & SPEAKER_BUF_MASK] = (byte)((sp->nibble << 4) | adpcm_encode(sp, pcm[i]));
+            sp->tail++;
+            sp->has_nibble = 0;
+        } else
+        {
+            if (sp->tail - sp->head >= WIIUSE_SPEAKER_BUF_LEN)
+            {
+                break;
+            }
+            sp->nibble     = adpcm_encode(sp, pcm[i]);
+            sp->has_nibble = 1;
+        }
+    }
+
+    return i;
+}
+
+/**
+ *	@brief	Get the time the next speaker report is due.
+ *
+ *	@param wm		An array of pointers to wiimote_t structures.
+ *	@param wiimotes	The number of wiimote_t structures in the \a wm array.
+ *
+ *	@return The earliest time, on the wiiuse_ticks() clock, at which
+ *	wiiuse_poll() has audio to send, or 0 if no audio is queued.
+ *
+ *	Applications that sleep between polls should wake up by then.
+ */
+unsigned long wiiuse_speaker_deadline(struct wiimote_t **wm, int wiimotes)
+{
+    unsigned long deadline = 0;
+    unsigned long due;
+    int i;
+
+    if (!wm)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < wiimotes; ++i)
+    {
+        const struct speaker_t *sp = &wm[i]->speaker;
+
+        if (!sp->rate || sp->tail == sp->head)
+        {
+            continue;
+        }
+
+        due = speaker_due(sp);
+        if (!deadline || (long)(due - deadline) < 0)
+        {
+            deadline = due;
+        }
+    }
+
+    return deadline;
+}
+
+/**
+ *	@brief Send the speaker reports that are due.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *	@param ticks	The current time (ms).
+ *
+ *	Called from wiiuse_poll().  A report goes out once its time has
+ *	come, never earlier, so the wiimote's small audio buffer does not
+ *	overflow.  A report is only sent short when no more audio arrived
+ *	by the time the next one would be due.
+ */
+void speaker_pump(struct wiimote_t *wm, unsigned long ticks)
+{
+    struct speaker_t *sp = &wm->speaker;
+    byte buf[SPEAKER_REPORT_BYTES + 1];
+    unsigned long due;
+    unsigned int len, i;
+
+    if (!sp->rate || !WIIMOTE_IS_CONNECTED(wm))
+    {
+        return;
+    }
+
+    /* the speaker setup is still queued */
+    if (wm->outq.stats[WIIUSE_OUTQ_BULK].depth)
+    {
+        return;
+    }
+
+    while (sp->tail != sp->head)
+    {
+        due = speaker_due(sp);
+        if ((long)(ticks - due) < 0)
+        {
+            return;
+        }
+
+        if (ticks - due > SPEAKER_MAX_LATE)
+        {
+            /* first report, underrun or a stalled caller */
+            sp->start_ticks = ticks;
+            sp->reports     = 0;
+        }
+
+        len = sp->tail - sp->head;
+        if (len > SPEAKER_REPORT_BYTES)
+        {
+            len = SPEAKER_REPORT_BYTES;
+        } else if (len < SPEAKER_REPORT_BYTES && sp->reports
+                   && ticks - due < (SPEAKER_REPORT_SAMPLES * 1000) / sp->rate)
+        {
+            /* wait a little for the rest of the report */
+            return;
+        }
+
+        memset(buf, 0, sizeof(buf));
+        buf[0] = (byte)(len << 3);
+        for (i = 0; i < len; ++i)
+        {
+            buf[i + 1] = sp->buf[(sp->head + i) & SPEAKER_BUF_MASK];
+        }
+        sp->head += len;
+        sp->reports++;
+
+        wiiuse_send(wm, WM_CMD_SPEAKER_DATA, buf, sizeof(buf));
+    }
+}
@@ -0,0 +1,60 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Speaker audio streaming.
+ */
+
+#ifndef SPEAKER_H_INCLUDED
+#define SPEAKER_H_INCLUDED
+
+#include "wiiuse_internal.h"
+
+/* encoded bytes in one 0x18 report, two samples each */
+#define SPEAKER_REPORT_BYTES   20
+#define SPEAKER_REPORT_SAMPLES (2 * SPEAKER_REPORT_BYTES)
+
+/* the ADPCM sample rate is this clock divided by the rate register */
+#define SPEAKER_ADPCM_CLOCK 6000000
+
+/* a stream more than this late (ms) restarts its clock instead of sending a burst */
+#define SPEAKER_MAX_LATE 40
+
+/* Yamaha ADPCM step size limits */
+#define SPEAKER_ADPCM_STEP_MIN 127
+#define SPEAKER_ADPCM_STEP_MAX 24576
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup internal_speaker Internal: Speaker */
+/** @{ */
+void speaker_pump(struct wiimote_t *wm, unsigned long ticks);
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPEAKER_H_INCLUDED */
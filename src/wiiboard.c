@@ -32,7 +32,9 @@
  */
 
 #include "wiiboard.h"
+#include "fixed.h"
 #include "io.h"
+#include "simd.h"
 
 #include <stdio.h>  /* for printf */
 #include <string.h> /* for memset */
@@ -97,6 +99,8 @@ int wii_board_handshake(struct wiimote_t *wm, struct wii_board_t *wb, byte *data
 
     wb->use_alternate_report = 0;
 
+    wii_board_update_coefficients(wb);
+
     /* handshake done */
     wm->event    = WIIUSE_WII_BOARD_CTRL_INSERTED;
     wm->exp.type = EXP_WII_BOARD;
@@ -115,25 +119,100 @@ int wii_board_handshake(struct wiimote_t *wm, struct wii_board_t *wb, byte *data
  */
 void wii_board_disconnected(struct wii_board_t *wb) { memset(wb, 0, sizeof(struct wii_board_t)); }
 
-static float do_interpolate(uint16_t raw, uint16_t cal[3])
-{
 #define WIIBOARD_MIDDLE_CALIB 17.0f
+
+/**
+ *	@brief Derive the interpolation coefficients of one sensor.
+ */
+static void set_sensor_coefficients(struct wii_board_t *wb, int sensor, const uint16_t cal[3])
+{
+    wb->cal_lo[sensor]  = (float)cal[0];
+    wb->cal_mid[sensor] = (float)cal[1];
+    wb->cal_hi[sensor]  = (float)cal[2];
+
+    /* a segment of zero length is never used, keep its slope finite */
+    wb->slope_lo[sensor] = (cal[1] > cal[0]) ? WIIBOARD_MIDDLE_CALIB / (float)(cal[1] - cal[0]) : 0.0f;
+    wb->slope_hi[sensor] = (cal[2] > cal[1]) ? WIIBOARD_MIDDLE_CALIB / (float)(cal[2] - cal[1]) : 0.0f;
+
+    wb->slope_lo_q32[sensor] = (cal[1] > cal[0]) ? ((int64_t)17 << 32) / (cal[1] - cal[0]) : 0;
+    wb->slope_hi_q32[sensor] = (cal[2] > cal[1]) ? ((int64_t)17 << 32) / (cal[2] - cal[1]) : 0;
+}
+
+/**
+ *	@brief Precompute the interpolation coefficients from the calibration.
+ *
+ *	@param wb		A pointer to a wii_board_t structure.
+ *
+ *	The calibration gives the raw value of each sensor at 0, 17 and 34 kg;
+ *	turning it into thresholds and slopes once makes the per-report
+ *	interpolation free of divisions.
+ */
+void wii_board_update_coefficients(struct wii_board_t *wb)
+{
+    set_sensor_coefficients(wb, 0, wb->ctl);
+    set_sensor_coefficients(wb, 1, wb->ctr);
+    set_sensor_coefficients(wb, 2, wb->cbl);
+    set_sensor_coefficients(wb, 3, wb->cbr);
+}
+
+#ifdef WIIUSE_FIXED_POINT
+/**
+ *	@brief Interpolate one sensor, in Q16 kg.
+ */
+static fixed_t interpolate_sensor(const struct wii_board_t *wb, int sensor, const uint16_t cal[3], uint16_t raw)
+{
     if (raw < cal[0])
     {
-        return 0.0f;
+        return 0;
     } else if (raw < cal[1])
     {
-        return ((float)(raw - cal[0]) * WIIBOARD_MIDDLE_CALIB) / (float)(cal[1] - cal[0]);
+        return (fixed_t)(((int64_t)(raw - cal[0]) * wb->slope_lo_q32[sensor]) >> 16);
     } else if (raw < cal[2])
     {
-        return ((float)(raw - cal[1]) * WIIBOARD_MIDDLE_CALIB) / (float)(cal[2] - cal[1])
-               + WIIBOARD_MIDDLE_CALIB;
+        return (fixed_t)(((int64_t)(raw - cal[1]) * wb->slope_hi_q32[sensor]) >> 16) + fixed_from_int(17);
+    }
+    return fixed_from_int(34);
+}
+
+/**
+ *	@brief Handle wii board event.
+ *
+ *	@param wb		A pointer to a wii_board_t structure.
+ *	@param msg		The message specified in the event packet.
+ */
+void wii_board_event(struct wii_board_t *wb, byte *msg)
+{
+    byte *bufPtr = msg;
+    fixed_t kg[4], total;
+
+    wb->rtr = unbuffer_big_endian_uint16_t(&bufPtr);
+    wb->rbr = unbuffer_big_endian_uint16_t(&bufPtr);
+    wb->rtl = unbuffer_big_endian_uint16_t(&bufPtr);
+    wb->rbl = unbuffer_big_endian_uint16_t(&bufPtr);
+
+    kg[0] = interpolate_sensor(wb, 0, wb->ctl, wb->rtl);
+    kg[1] = interpolate_sensor(wb, 1, wb->ctr, wb->rtr);
+    kg[2] = interpolate_sensor(wb, 2, wb->cbl, wb->rbl);
+    kg[3] = interpolate_sensor(wb, 3, wb->cbr, wb->rbr);
+
+    wb->tl = fixed_to_float(kg[0]);
+    wb->tr = fixed_to_float(kg[1]);
+    wb->bl = fixed_to_float(kg[2]);
+    wb->br = fixed_to_float(kg[3]);
+
+    total     = (kg[0] + kg[1]) + (kg[2] + kg[3]);
+    wb->total = fixed_to_float(total);
+    if (total > 0)
+    {
+        wb->cop_x = fixed_to_float(fixed_div(kg[1] + kg[3], total) * 2 - FIXED_ONE);
+        wb->cop_y = fixed_to_float(fixed_div(kg[0] + kg[1], total) * 2 - FIXED_ONE);
     } else
     {
-        return WIIBOARD_MIDDLE_CALIB * 2.0f;
+        wb->cop_x = 0.0f;
+        wb->cop_y = 0.0f;
     }
 }
-
+#else
 /**
  *	@brief Handle wii board event.
  *
@@ -143,22 +222,57 @@ static float do_interpolate(uint16_t raw, uint16_t cal[3])
 void wii_board_event(struct wii_board_t *wb, byte *msg)
 {
     byte *bufPtr = msg;
+    float raw[4], kg[4];
 
     wb->rtr = unbuffer_big_endian_uint16_t(&bufPtr);
     wb->rbr = unbuffer_big_endian_uint16_t(&bufPtr);
     wb->rtl = unbuffer_big_endian_uint16_t(&bufPtr);
     wb->rbl = unbuffer_big_endian_uint16_t(&bufPtr);
 
+    raw[0] = (float)wb->rtl;
+    raw[1] = (float)wb->rtr;
+    raw[2] = (float)wb->rbl;
+    raw[3] = (float)wb->rbr;
+
     /*
-            Interpolate values
+            Interpolate values, all four sensors at once
             Calculations borrowed from wiili.org - No names to mention sadly :(
        http://www.wiili.org/index.php/Wii_Balance_Board_PC_Drivers page however!
     */
-    wb->tr = do_interpolate(wb->rtr, wb->ctr);
-    wb->tl = do_interpolate(wb->rtl, wb->ctl);
-    wb->br = do_interpolate(wb->rbr, wb->cbr);
-    wb->bl = do_interpolate(wb->rbl, wb->cbl);
+    {
+        simd4f r   = simd4f_load(raw);
+        simd4f lo  = simd4f_load(wb->cal_lo);
+        simd4f mid = simd4f_load(wb->cal_mid);
+        simd4f v;
+
+        /* below 17 kg : above 17 kg */
+        v = simd4f_select_gt(mid, r, simd4f_mul(simd4f_sub(r, lo), simd4f_load(wb->slope_lo)),
+                             simd4f_add(simd4f_mul(simd4f_sub(r, mid), simd4f_load(wb->slope_hi)),
+                                        simd4f_set1(WIIBOARD_MIDDLE_CALIB)));
+        /* clip to the calibrated range */
+        v = simd4f_select_gt(lo, r, simd4f_set1(0.0f), v);
+        v = simd4f_select_gt(simd4f_load(wb->cal_hi), r, v, simd4f_set1(WIIBOARD_MIDDLE_CALIB * 2.0f));
+
+        simd4f_store(kg, v);
+    }
+
+    wb->tl = kg[0];
+    wb->tr = kg[1];
+    wb->bl = kg[2];
+    wb->br = kg[3];
+
+    wb->total = (kg[0] + kg[1]) + (kg[2] + kg[3]);
+    if (wb->total > 0.0f)
+    {
+        wb->cop_x = ((kg[1] + kg[3]) / wb->total) * 2.0f - 1.0f;
+        wb->cop_y = ((kg[0] + kg[1]) / wb->total) * 2.0f - 1.0f;
+    } else
+    {
+        wb->cop_x = 0.0f;
+        wb->cop_y = 0.0f;
+    }
 }
+#endif
 
 /**
 *   @brief Calib wii board
@@ -171,6 +285,9 @@ void wiiuse_set_wii_board_calib(struct wiimote_t *wm)
     uint16_t test = 1;
     memset(pkt, 0, sizeof(pkt));
 
+    /* the calibration may have been changed by the application */
+    wii_board_update_coefficients(&wm->exp.wb);
+
     /*
      * address in big endian first, the leading byte will
      * be overwritten (only 3 bytes are sent)
@@ -47,6 +47,8 @@ int wii_board_handshake(struct wiimote_t *wm, struct wii_board_t *wb, byte *data
 void wii_board_disconnected(struct wii_board_t *wb);
 
 void wii_board_event(struct wii_board_t *wb, byte *msg);
+
+void wii_board_update_coefficients(struct wii_board_t *wb);
 /** @} */
 #ifdef __cplusplus
 }
@@ -35,8 +35,16 @@
  *	of the API.
  */
 
-#include "io.h" /* for wiiuse_handshake, etc */
-#include "os.h" /* for wiiuse_os_* */
+#include "cmdq.h"     /* for cmdq_init */
+#include "context.h"  /* for context_alloc, context_free */
+#include "dynamics.h" /* for accel_build_orient_lut */
+#include "events.h"   /* for disable_expansion */
+#include "io.h"       /* for wiiuse_handshake, etc */
+#include "ir.h"       /* for wiiuse_ir_type, wiiuse_set_ir_mode */
+#include "os.h"       /* for wiiuse_os_* */
+#include "outqueue.h" /* for outqueue_send, etc */
+#include "registry.h" /* for registry_update */
+#include "rumble.h"   /* for rumble_cancel */
 #include "wiiuse_internal.h"
 
 #include <stdio.h>  /* for printf, FILE */
@@ -67,6 +75,93 @@ FILE *logtarget[4];
  */
 void wiiuse_set_output(enum wiiuse_loglevel loglevel, FILE *logfile) { logtarget[(int)loglevel] = logfile; }
 
+/**
+ *	@brief Allocate a wiimote_t on a cache line boundary.
+ *
+ *	@param ctx		Context whose allocator to use, or NULL for malloc().
+ *
+ *	Like the wiimotes of wiiuse_init_arena(), it does not share its
+ *	first cache line with another allocation, so the per-report members
+ *	at its start take as few cache lines as they can.  Release it with
+ *	context_free(ctx, wiimote_block()).
+ */
+static struct wiimote_t *wiimote_alloc(struct wiiuse_context_t *ctx)
+{
+    byte *block, *wm;
+
+    /* over-allocate so the structure can be aligned regardless of malloc */
+    block = (byte *)context_alloc(ctx, sizeof(struct wiimote_t) + WIIMOTE_CACHE_LINE);
+    if (!block)
+    {
+        return NULL;
+    }
+
+    wm = (byte *)(((uintptr_t)block + WIIMOTE_CACHE_LINE) & ~(uintptr_t)(WIIMOTE_CACHE_LINE - 1));
+
+    /* malloc alignment guarantees there is room for a pointer in front */
+    ((byte **)wm)[-1] = block;
+
+    return (struct wiimote_t *)wm;
+}
+
+/**
+ *	@brief Allocate a set of wiimote_t from one block.
+ *
+ *	@param wm		Array to store the structures in.
+ *	@param wiimotes	Number of structures to allocate.
+ *
+ *	@return 1 on success, 0 if out of memory.
+ *
+ *	Each structure starts on a cache line and is padded to a whole
+ *	number of them, so no two wiimotes share a line.  The block is
+ *	released with the first structure, see wiimote_block().
+ */
+static int wiimote_arena_alloc(struct wiimote_t **wm, int wiimotes)
+{
+    /* leave room for the pointer wiimote_block() reads in front of each structure */
+    size_t stride = (sizeof(struct wiimote_t) + sizeof(byte *) + WIIMOTE_CACHE_LINE - 1)
+                    & ~(size_t)(WIIMOTE_CACHE_LINE - 1);
+    byte *block, *cursor;
+    int i;
+
+    block = (byte *)malloc(stride * wiimotes + WIIMOTE_CACHE_LINE);
+    if (!block)
+    {
+        return 0;
+    }
+
+    cursor = (byte *)(((uintptr_t)block + WIIMOTE_CACHE_LINE) & ~(uintptr_t)(WIIMOTE_CACHE_LINE - 1));
+    for (i = 0; i < wiimotes; ++i)
+    {
+        wm[i]                 = (struct wiimote_t *)cursor;
+        ((byte **)cursor)[-1] = i ? NULL : block;
+        cursor += stride;
+    }
+
+    return 1;
+}
+
+/**
+ *	@brief Memory block to free() for a wiimote_t.
+ *
+ *	@return The block of wiimote_alloc(), the arena of
+ *	wiimote_arena_alloc() for its first structure, NULL for the others.
+ */
+static void *wiimote_block(struct wiimote_t *wm) { return ((byte **)wm)[-1]; }
+
+/**
+ *	@brief Disconnect a wiimote and release what it holds, but not the structure.
+ */
+static void wiimote_release(struct wiimote_t *wm)
+{
+    /* releases the tables of the expansion */
+    disable_expansion(wm);
+    wiiuse_disconnect(wm);
+    wiiuse_cleanup_platform_fields(wm);
+    accel_free_orient_lut(&wm->accel_calib);
+    rumble_cancel(wm);
+}
+
 /**
  *	@brief Clean up wiimote_t array created by wiiuse_init()
  */
@@ -83,9 +178,17 @@ void wiiuse_cleanup(struct wiimote_t **wm, int wiimotes)
 
     for (; i < wiimotes; ++i)
     {
-        wiiuse_disconnect(wm[i]);
-        wiiuse_cleanup_platform_fields(wm[i]);
-        free(wm[i]);
+        wiimote_release(wm[i]);
+    }
+
+    /* collect the blocks first, the wiimotes of wiiuse_init_arena() share one */
+    for (i = 0; i < wiimotes; ++i)
+    {
+        ((void **)wm)[i] = wiimote_block(wm[i]);
+    }
+    for (i = 0; i < wiimotes; ++i)
+    {
+        free(((void **)wm)[i]);
     }
 
     free(wm);
@@ -94,22 +197,10 @@ void wiiuse_cleanup(struct wiimote_t **wm, int wiimotes)
 }
 
 /**
- *	@brief Initialize an array of wiimote structures.
- *
- *	@param wiimotes		Number of wiimote_t structures to create.
- *
- *	@return An array of initialized wiimote_t structures.
- *
- *	@see wiiuse_connect()
- *
- *	The array returned by this function can be passed to various
- *	functions, including wiiuse_connect().
+ *	@brief Print the banner.
  */
-struct wiimote_t **wiiuse_init(int wiimotes)
+void wiiuse_print_banner()
 {
-    int i                 = 0;
-    struct wiimote_t **wm = NULL;
-
     /*
      *	Please do not remove this banner.
      *	GPL asks that you please leave output credits intact.
@@ -121,56 +212,190 @@ struct wiimote_t **wiiuse_init(int wiimotes)
      *	2018: Replaced wiiuse.net with sourceforge project, since
      *	wiiuse.net is now abandoned and "parked".
      */
+    printf("wiiuse v" WIIUSE_VERSION " loaded.\n"
+           "  De-facto official fork at http://github.com/wiiuse/wiiuse\n"
+           "  Original By: Michael Laforest <thepara[at]gmail{dot}com> <https://sourceforge.net/projects/wiiuse/>\n");
+}
+
+/**
+ *	@brief Show the banner the first time wiimotes are created.
+ *
+ *	Each context shows it when it is created, see wiiuse_context_new().
+ */
+static void show_banner()
+{
     if (!g_banner)
     {
-        printf("wiiuse v" WIIUSE_VERSION " loaded.\n"
-               "  De-facto official fork at http://github.com/wiiuse/wiiuse\n"
-               "  Original By: Michael Laforest <thepara[at]gmail{dot}com> <https://sourceforge.net/projects/wiiuse/>\n");
+        wiiuse_print_banner();
         g_banner = 1;
     }
+}
 
-    logtarget[0] = stderr;
-    logtarget[1] = stderr;
-    logtarget[2] = stderr;
-    logtarget[3] = stderr;
+/**
+ *	@brief Set a wiimote_t to its initial state.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *	@param unid		The id of the wiimote.
+ */
+static void wiimote_setup(struct wiimote_t *wm, int unid)
+{
+    memset(wm, 0, sizeof(struct wiimote_t));
 
-    if (!wiimotes)
+    wm->unid        = unid;
+    wm->adapter     = WIIUSE_ADAPTER_DEFAULT;
+    wm->adapter_pin = WIIUSE_ADAPTER_DEFAULT;
+    wiiuse_init_platform_fields(wm);
+
+    wm->state = WIIMOTE_INIT_STATES;
+    wm->flags = WIIUSE_INIT_FLAGS;
+
+    wm->event = WIIUSE_NONE;
+
+    wm->exp.type        = EXP_NONE;
+    wm->expansion_state = 0;
+
+    wiiuse_set_aspect_ratio(wm, WIIUSE_ASPECT_4_3);
+    wiiuse_set_ir_position(wm, WIIUSE_IR_ABOVE);
+
+    wm->orient_threshold = 0.5f;
+    wm->accel_threshold  = 5;
+
+    wm->accel_calib.st_alpha = WIIUSE_DEFAULT_SMOOTH_ALPHA;
+
+    outqueue_init(wm);
+    cmdq_init(wm);
+
+    wm->type = WIIUSE_WIIMOTE_REGULAR;
+}
+
+/**
+ *	@brief Create a single wiimote, for the registry.
+ *
+ *	@param ctx		Context the wiimote belongs to, or NULL.
+ *	@param unid		The id of the wiimote.
+ *
+ *	@return The wiimote, or NULL if out of memory.  Release it with
+ *	wiiuse_delete_wiimote().
+ */
+struct wiimote_t *wiiuse_new_wiimote(struct wiiuse_context_t *ctx, int unid)
+{
+    struct wiimote_t *wm;
+
+    /* a context has its own log targets and showed the banner already */
+    if (!ctx)
+    {
+        if (!g_banner)
+        {
+            logtarget[0] = stderr;
+            logtarget[1] = stderr;
+            logtarget[2] = stderr;
+            logtarget[3] = stderr;
+        }
+        show_banner();
+    }
+
+    wm = wiimote_alloc(ctx);
+    if (!wm)
     {
+        WIIUSE_ERROR("Unable to allocate a wiimote.");
         return NULL;
     }
 
-    wm = (struct wiimote_t **)malloc(sizeof(struct wiimote_t *) * wiimotes);
+    wiimote_setup(wm, unid);
+    wm->ctx = ctx;
+    return wm;
+}
 
-    for (i = 0; i < wiimotes; ++i)
-    {
-        wm[i] = (struct wiimote_t *)malloc(sizeof(struct wiimote_t));
-        memset(wm[i], 0, sizeof(struct wiimote_t));
+/**
+ *	@brief Disconnect and release a wiimote of wiiuse_new_wiimote().
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ */
+void wiiuse_delete_wiimote(struct wiimote_t *wm)
+{
+    struct wiiuse_context_t *ctx = wm->ctx;
 
-        wm[i]->unid = i + 1;
-        wiiuse_init_platform_fields(wm[i]);
+    wiimote_release(wm);
+    context_free(ctx, wiimote_block(wm));
+}
 
-        wm[i]->state = WIIMOTE_INIT_STATES;
-        wm[i]->flags = WIIUSE_INIT_FLAGS;
+/**
+ *	@brief Initialize an array of wiimote structures.
+ *
+ *	@param wiimotes		Number of wiimote_t structures to create.
+ *	@param arena		1 to allocate the structures from one block.
+ */
+static struct wiimote_t **init_wiimotes(int wiimotes, int arena)
+{
+    int i                 = 0;
+    struct wiimote_t **wm = NULL;
 
-        wm[i]->event = WIIUSE_NONE;
+    show_banner();
 
-        wm[i]->exp.type        = EXP_NONE;
-        wm[i]->expansion_state = 0;
+    logtarget[0] = stderr;
+    logtarget[1] = stderr;
+    logtarget[2] = stderr;
+    logtarget[3] = stderr;
 
-        wiiuse_set_aspect_ratio(wm[i], WIIUSE_ASPECT_4_3);
-        wiiuse_set_ir_position(wm[i], WIIUSE_IR_ABOVE);
+    if (!wiimotes)
+    {
+        return NULL;
+    }
 
-        wm[i]->orient_threshold = 0.5f;
-        wm[i]->accel_threshold  = 5;
+    wm = (struct wiimote_t **)malloc(sizeof(struct wiimote_t *) * wiimotes);
+    if (!wm)
+    {
+        return NULL;
+    }
 
-        wm[i]->accel_calib.st_alpha = WIIUSE_DEFAULT_SMOOTH_ALPHA;
+    if (arena && !wiimote_arena_alloc(wm, wiimotes))
+    {
+        WIIUSE_ERROR("Unable to allocate %i wiimotes.", wiimotes);
+        free(wm);
+        return NULL;
+    }
 
-        wm[i]->type = WIIUSE_WIIMOTE_REGULAR;
+    for (i = 0; i < wiimotes; ++i)
+    {
+        if (!arena)
+        {
+            wm[i] = wiimote_alloc(NULL);
+        }
+        wiimote_setup(wm[i], i + 1);
     }
 
     return wm;
 }
 
+/**
+ *	@brief Initialize an array of wiimote structures.
+ *
+ *	@param wiimotes		Number of wiimote_t structures to create.
+ *
+ *	@return An array of initialized wiimote_t structures.
+ *
+ *	@see wiiuse_connect()
+ *
+ *	The array returned by this function can be passed to various
+ *	functions, including wiiuse_connect().
+ */
+struct wiimote_t **wiiuse_init(int wiimotes) { return init_wiimotes(wiimotes, 0); }
+
+/**
+ *	@brief Initialize an array of wiimote structures in one block.
+ *
+ *	@param wiimotes		Number of wiimote_t structures to create.
+ *
+ *	@return An array of initialized wiimote_t structures, or NULL if out of memory.
+ *
+ *	Like wiiuse_init(), but the structures lie next to each other in
+ *	one allocation, each padded to whole cache lines.  Iterating all
+ *	wiimotes then walks memory in order, and wiimotes handled from
+ *	different threads never share a cache line.  Release the array
+ *	with wiiuse_cleanup() as usual.
+ */
+struct wiimote_t **wiiuse_init_arena(int wiimotes) { return init_wiimotes(wiimotes, 1); }
+
 /**
  *	@brief	The wiimote disconnected.
  *
@@ -185,11 +410,17 @@ void wiiuse_disconnected(struct wiimote_t *wm)
 
     WIIUSE_INFO("Wiimote disconnected [id %i].", wm->unid);
 
+    /* the expansion went away with the wiimote */
+    disable_expansion(wm);
+
     /* disable the connected flag */
     WIIMOTE_DISABLE_STATE(wm, WIIMOTE_STATE_CONNECTED);
 
     /* reset a bunch of stuff */
-    wm->leds     = 0;
+    wm->leds        = 0;
+    wm->out.known   = 0;
+    wm->out.pending = 0;
+    outqueue_clear(wm);
     wm->state    = WIIMOTE_INIT_STATES;
     wm->read_req = NULL;
 #ifndef WIIUSE_SYNC_HANDSHAKE
@@ -200,6 +431,8 @@ void wiiuse_disconnected(struct wiimote_t *wm)
     wm->btns_released = 0;
 
     wm->event = WIIUSE_DISCONNECT;
+
+    registry_update(wm);
 }
 
 /**
@@ -207,6 +440,8 @@ void wiiuse_disconnected(struct wiimote_t *wm)
  *
  *	@param wm		Pointer to a wiimote_t structure.
  *	@param status	1 to enable, 0 to disable.
+ *
+ *	Nothing is sent if the motor already is in that state.
  */
 void wiiuse_rumble(struct wiimote_t *wm, int status)
 {
@@ -217,6 +452,16 @@ void wiiuse_rumble(struct wiimote_t *wm, int status)
         return;
     }
 
+    /* stop the running effect, see wiiuse_rumble_effect() */
+    rumble_cancel(wm);
+
+    /* the motor already is in that state */
+    if (!status == !WIIMOTE_IS_SET(wm, WIIMOTE_STATE_RUMBLE) && !status == !wm->rumble.on_air)
+    {
+        wm->out.suppressed++;
+        return;
+    }
+
     /* make sure to keep the current lit leds */
     buf = wm->leds;
 
@@ -263,6 +508,7 @@ void wiiuse_toggle_rumble(struct wiimote_t *wm)
  *	@param leds		What LEDs to enable.
  *
  *	\a leds is a bitwise or of WIIMOTE_LED_1, WIIMOTE_LED_2, WIIMOTE_LED_3, or WIIMOTE_LED_4.
+ *	Nothing is sent if the wiimote already shows these LEDs.
  */
 void wiiuse_set_leds(struct wiimote_t *wm, int leds)
 {
@@ -282,9 +528,20 @@ void wiiuse_set_leds(struct wiimote_t *wm, int leds)
         wm->leds |= 0x01;
     }
 
+    /* the same LEDs are already lit */
+    if ((wm->out.known & WM_OUT_LEDS) && wm->out.leds == (leds & 0xF0))
+    {
+        wm->out.suppressed++;
+        return;
+    }
+
     buf = wm->leds;
 
-    wiiuse_send(wm, WM_CMD_LED, &buf, 1);
+    if (wiiuse_send(wm, WM_CMD_LED, &buf, 1) > 0)
+    {
+        wm->out.leds = (leds & 0xF0);
+        wm->out.known |= WM_OUT_LEDS;
+    }
 }
 
 /**
@@ -310,6 +567,59 @@ void wiiuse_motion_sensing(struct wiimote_t *wm, int status)
     wiiuse_set_report_type(wm);
 }
 
+/*
+ *	Input reports wiiuse_set_report_type() picks from, smallest first.
+ *	len is the bytes per sample after the report id, 0x3E/0x3F need two
+ *	reports for one sample.
+ */
+static const struct report_layout_t
+{
+    byte id;
+    byte len;
+    byte data;    /* WM_RPT_DATA_* */
+    byte exp_len; /* expansion bytes */
+} report_layouts[] = {
+    {WM_RPT_BTN, 2, WM_RPT_DATA_BTN, 0},
+    {WM_RPT_BTN_ACC, 5, WM_RPT_DATA_BTN | WM_RPT_DATA_ACC, 0},
+    {WM_RPT_BTN_EXP_8, 10, WM_RPT_DATA_BTN, 8},
+    {WM_RPT_BTN_ACC_IR, 17, WM_RPT_DATA_BTN | WM_RPT_DATA_ACC | WM_RPT_DATA_IR_EXT, 0},
+    {WM_RPT_EXP, 21, 0, 21},
+    {WM_RPT_BTN_EXP, 21, WM_RPT_DATA_BTN, 19},
+    {WM_RPT_BTN_ACC_EXP, 21, WM_RPT_DATA_BTN | WM_RPT_DATA_ACC, 16},
+    {WM_RPT_BTN_IR_EXP, 21, WM_RPT_DATA_BTN | WM_RPT_DATA_IR_BASIC, 9},
+    {WM_RPT_BTN_ACC_IR_EXP, 21, WM_RPT_DATA_BTN | WM_RPT_DATA_ACC | WM_RPT_DATA_IR_BASIC, 6},
+    {WM_RPT_BTN_ACC_IR_1, 42, WM_RPT_DATA_BTN | WM_RPT_DATA_ACC | WM_RPT_DATA_IR_FULL, 0},
+};
+
+/* more expansion bytes than any report carries: the widest one is used */
+#define EXP_REPORT_LEN_ALL 0xff
+
+/**
+ *	@brief	Number of expansion bytes the current expansion needs in a report.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *
+ *	@return The length, or EXP_REPORT_LEN_ALL for an expansion that was
+ *	not recognized.
+ */
+static byte expansion_report_len(struct wiimote_t *wm)
+{
+    switch (wm->exp.type)
+    {
+    case EXP_NUNCHUK:
+    case EXP_CLASSIC:
+    case EXP_GUITAR_HERO_3:
+    case EXP_MOTION_PLUS:
+    case EXP_MOTION_PLUS_NUNCHUK:
+    case EXP_MOTION_PLUS_CLASSIC:
+        return 6;
+    case EXP_WII_BOARD:
+        return 8;
+    default:
+        return EXP_REPORT_LEN_ALL;
+    }
+}
+
 /**
  *	@brief	Set the report type based on the current wiimote state.
  *
@@ -321,18 +631,30 @@ void wiiuse_motion_sensing(struct wiimote_t *wm, int status)
  *	report type that was last requested.  This function will
  *	update the type of report that should be sent based on
  *	the current state of the device.
+ *
+ *	The smallest report that carries everything needed is picked.
+ *	The IR format has to match the IR mode exactly, the camera
+ *	sends it in only one format.  If no report has room for the
+ *	expansion, the one with the most expansion bytes is used.
+ *	Nothing is sent if the wiimote already uses that report.
  */
 int wiiuse_set_report_type(struct wiimote_t *wm)
 {
 
     byte buf[2];
-    int motion, exp, ir, balance_board;
+    byte need, exp_len;
+    const struct report_layout_t *layout = NULL;
+    int ret;
+    size_t i;
 
     if (!wm || !WIIMOTE_IS_CONNECTED(wm))
     {
         return 0;
     }
 
+    /* a deferred request is answered by this one */
+    wm->out.pending &= ~WM_OUT_REPORT;
+
     buf[0] = (WIIMOTE_IS_FLAG_SET(wm, WIIUSE_CONTINUOUS) ? 0x04
                                                          : 0x00); /* set to 0x04 for continuous reporting */
     buf[1] = 0x00;
@@ -343,54 +665,136 @@ int wiiuse_set_report_type(struct wiimote_t *wm)
         buf[0] |= 0x01;
     }
 
-    motion        = WIIMOTE_IS_SET(wm, WIIMOTE_STATE_ACC);
-    exp           = WIIMOTE_IS_SET(wm, WIIMOTE_STATE_EXP);
-    ir            = WIIMOTE_IS_SET(wm, WIIMOTE_STATE_IR);
-    balance_board = exp && (wm->exp.type == EXP_WII_BOARD);
+    need    = WIIMOTE_IS_FLAG_SET(wm, WIIUSE_NO_BUTTONS) ? 0 : WM_RPT_DATA_BTN;
+    exp_len = 0;
 
-    if (motion && ir && exp)
-    {
-        buf[1] = WM_RPT_BTN_ACC_IR_EXP;
-    } else if (motion && exp)
+    if (WIIMOTE_IS_SET(wm, WIIMOTE_STATE_ACC))
     {
-        buf[1] = WM_RPT_BTN_ACC_EXP;
-    } else if (motion && ir)
-    {
-        buf[1] = WM_RPT_BTN_ACC_IR;
-    } else if (ir && exp)
-    {
-        buf[1] = WM_RPT_BTN_IR_EXP;
-    } else if (ir)
+        need |= WM_RPT_DATA_ACC;
+    }
+    if (WIIMOTE_IS_SET(wm, WIIMOTE_STATE_EXP))
     {
-        buf[1] = WM_RPT_BTN_ACC_IR;
-    } else if (exp && balance_board)
+        exp_len = expansion_report_len(wm);
+    }
+    if (WIIMOTE_IS_SET(wm, WIIMOTE_STATE_IR))
     {
-        if (wm->exp.wb.use_alternate_report)
-            buf[1] = WM_RPT_BTN_EXP_8;
-        else
-            buf[1] = WM_RPT_BTN_EXP;
-    } else if (exp)
+        switch (wiiuse_ir_type(wm))
+        {
+        case WM_IR_TYPE_BASIC:
+            need |= WM_RPT_DATA_IR_BASIC;
+            break;
+        case WM_IR_TYPE_FULL:
+            need |= WM_RPT_DATA_IR_FULL;
+            break;
+        default:
+            need |= WM_RPT_DATA_IR_EXT;
+            break;
+        }
+    }
+
+    for (i = 0; i < sizeof(report_layouts) / sizeof(report_layouts[0]); ++i)
     {
-        buf[1] = WM_RPT_BTN_EXP;
-    } else if (motion)
+        const struct report_layout_t *l = &report_layouts[i];
+
+        if ((l->data & need) != need || ((l->data ^ need) & WM_RPT_DATA_IR))
+        {
+            continue;
+        }
+
+        /* 0x34 stays the default of the balance board, 0x32 is opt-in */
+        if (l->id == WM_RPT_BTN_EXP_8 && wm->exp.type == EXP_WII_BOARD && !wm->exp.wb.use_alternate_report)
+        {
+            continue;
+        }
+
+        if (l->exp_len >= exp_len)
+        {
+            layout = l;
+            break;
+        }
+
+        /* if none has room for the expansion, the one with the most */
+        if (!layout || l->exp_len > layout->exp_len)
+        {
+            layout = l;
+        }
+    }
+
+    if (layout)
     {
-        buf[1] = WM_RPT_BTN_ACC;
+        buf[1] = layout->id;
     } else
     {
+        /* can not happen, but a wiimote without a report type goes silent */
+        WIIUSE_ERROR("No report type carries the requested data (0x%x).", need);
         buf[1] = WM_RPT_BTN;
     }
 
+    /* the wiimote already sends that report */
+    if ((wm->out.known & WM_OUT_REPORT) && wm->out.report_type == buf[1]
+        && wm->out.report_mode == (buf[0] & 0x04))
+    {
+        wm->out.suppressed++;
+        return buf[1];
+    }
+
     WIIUSE_DEBUG("Setting report type: 0x%x", buf[1]);
 
-    exp = wiiuse_send(wm, WM_CMD_REPORT_TYPE, buf, 2);
-    if (exp <= 0)
+    /* a half full IR frame of the old report type can never complete */
+    wm->ir_full_pending = 0;
+
+    ret = wiiuse_send(wm, WM_CMD_REPORT_TYPE, buf, 2);
+    if (ret <= 0)
     {
-        return exp;
+        wm->out.known &= ~WM_OUT_REPORT;
+        return ret;
     }
 
+    wm->out.report_mode = (buf[0] & 0x04);
+    wm->out.report_type = buf[1];
+    wm->out.known |= WM_OUT_REPORT;
+
     return buf[1];
 }
 
+/**
+ *	@brief Set the report type at the end of the poll.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *
+ *	For state changes made while handling input: the report type is
+ *	chosen once all reports of the poll are handled, so a handshake
+ *	that changes the state several times sends one report.
+ */
+void wiiuse_defer_report_type(struct wiimote_t *wm)
+{
+    if (!wm || !WIIMOTE_IS_CONNECTED(wm))
+    {
+        return;
+    }
+
+    if (wm->out.pending & WM_OUT_REPORT)
+    {
+        wm->out.suppressed++;
+    }
+    wm->out.pending |= WM_OUT_REPORT;
+}
+
+/**
+ *	@brief Send the output reports left for the end of the poll.
+ *
+ *	@param wm		Pointer to a wiimote_t structure.
+ *
+ *	Called from wiiuse_poll().
+ */
+void wiiuse_flush_output(struct wiimote_t *wm)
+{
+    if (wm->out.pending & WM_OUT_REPORT)
+    {
+        wiiuse_set_report_type(wm);
+    }
+}
+
 /**
  *	@brief	Read data from the wiimote (callback version).
  *
@@ -739,41 +1143,32 @@ void wiiuse_send_next_pending_write_request(struct wiimote_t *wm)
  *	@param msg			The payload. Might be changed by the callee.
  *	@param len			Length of the payload in bytes.
  *
+ *	@return What wiiuse_os_write() returned, or \a len if the report was
+ *	queued, see outqueue_send().
+ *
  *	This function should replace any write()s directly to the wiimote device.
  */
 int wiiuse_send(struct wiimote_t *wm, byte report_type, byte *msg, int len)
 {
-    switch (report_type)
-    {
-    case WM_CMD_LED:
-    case WM_CMD_RUMBLE:
-    case WM_CMD_CTRL_STATUS:
-    {
-        /* Rumble flag for: 0x11, 0x13, 0x14, 0x15, 0x19 or 0x1a */
-        if (WIIMOTE_IS_SET(wm, WIIMOTE_STATE_RUMBLE))
-        {
-            msg[0] |= 0x01;
-        }
-        break;
-    }
-    default:
-        break;
-    }
+    return outqueue_send(wm, report_type, msg, len);
+}
 
-#ifdef WITH_WIIUSE_DEBUG
-    {
-        int x;
-        printf("[DEBUG] (id %i) SEND: (%.2x) %.2x ", wm->unid, report_type, msg[0]);
-        for (x = 1; x < len; ++x)
-        {
-            printf("%.2x ", msg[x]);
-        }
-        printf("\n");
-    }
-#endif
+/**
+ *	@brief Get the time used to stamp the reports.
+ *
+ *	@return The time in milliseconds, on the same monotonic clock as
+ *	wiimote_t::report_ticks.  Pass it (plus the expected display
+ *	latency) to wiiuse_ir_predict().
+ */
+unsigned long wiiuse_ticks() { return wiiuse_os_ticks(); }
 
-    return wiiuse_os_write(wm, report_type, msg, len);
-}
+/**
+ *	@brief Get the time used to stamp the reports, in nanoseconds.
+ *
+ *	@return The time in nanoseconds, on the same monotonic clock as
+ *	wiimote_t::report_ns.  wiiuse_ticks() is this clock in milliseconds.
+ */
+uint64_t wiiuse_ticks_ns() { return wiiuse_os_ticks_ns(); }
 
 /**
  *	@brief Set flags for the specified wiimote.
@@ -801,6 +1196,34 @@ int wiiuse_set_flags(struct wiimote_t *wm, int enable, int disable)
     wm->flags |= enable;
     wm->flags &= ~disable;
 
+    if ((enable | disable) & WIIUSE_IR_FULL)
+    {
+        wiiuse_set_ir_mode(wm);
+    }
+
+    /* the expansion-only report is only allowed without buttons, full IR needs its own reports */
+    if ((enable | disable) & (WIIUSE_NO_BUTTONS | WIIUSE_IR_FULL))
+    {
+        wiiuse_set_report_type(wm);
+    }
+
+    /* build or drop the orientation tables for the current calibration */
+    if (enable & WIIUSE_ORIENT_LUT)
+    {
+        accel_build_orient_lut(&wm->accel_calib);
+        if (wm->exp.type == EXP_NUNCHUK)
+        {
+            accel_build_orient_lut(&wm->exp.nunchuk.accel_calib);
+        }
+    } else if (disable & WIIUSE_ORIENT_LUT)
+    {
+        accel_free_orient_lut(&wm->accel_calib);
+        if (wm->exp.type == EXP_NUNCHUK)
+        {
+            accel_free_orient_lut(&wm->exp.nunchuk.accel_calib);
+        }
+    }
+
     return wm->flags;
 }
 
@@ -814,6 +1237,8 @@ int wiiuse_set_flags(struct wiimote_t *wm, int enable, int disable)
  *
  *	The alpha value is between 0 and 1 and is used in an exponential
  *	smoothing algorithm.
+ *	It applies to reports 10ms apart, other report intervals are
+ *	smoothed with the same time constant.
  *
  *	Smoothing is only performed if the WIIMOTE_USE_SMOOTHING is set.
  */
@@ -839,6 +1264,41 @@ float wiiuse_set_smooth_alpha(struct wiimote_t *wm, float alpha)
     return old;
 }
 
+/**
+ *	@brief Use a One-Euro filter to smooth the orientation.
+ *
+ *	@param wm			Pointer to a wiimote_t structure.
+ *	@param min_cutoff	Cutoff frequency (Hz) when the wiimote is held still, 0 to go back to
+ *						the alpha of wiiuse_set_smooth_alpha().
+ *	@param beta			How much the cutoff rises with the angular speed (Hz per deg/s).
+ *
+ *	Lower \a min_cutoff removes more jitter, higher \a beta removes more
+ *	lag on fast movements.  1.0 and 0.01 are reasonable starting points.
+ *
+ *	Smoothing is only performed if the WIIMOTE_USE_SMOOTHING is set.
+ */
+void wiiuse_set_smooth_one_euro(struct wiimote_t *wm, float min_cutoff, float beta)
+{
+    if (!wm)
+    {
+        return;
+    }
+
+    wm->accel_calib.st_min_cutoff = min_cutoff;
+    wm->accel_calib.st_beta       = beta;
+    wm->accel_calib.st_droll      = 0.0f;
+    wm->accel_calib.st_dpitch     = 0.0f;
+
+    /* if there is a nunchuk set that too */
+    if (wm->exp.type == EXP_NUNCHUK)
+    {
+        wm->exp.nunchuk.accel_calib.st_min_cutoff = min_cutoff;
+        wm->exp.nunchuk.accel_calib.st_beta       = beta;
+        wm->exp.nunchuk.accel_calib.st_droll      = 0.0f;
+        wm->exp.nunchuk.accel_calib.st_dpitch     = 0.0f;
+    }
+}
+
 /**
  *	@brief	Set the bluetooth stack type to use.
  *
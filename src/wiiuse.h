@@ -225,6 +225,10 @@
 #define WIIUSE_SMOOTHING     0x01
 #define WIIUSE_CONTINUOUS    0x02
 #define WIIUSE_ORIENT_THRESH 0x04
+#define WIIUSE_ORIENT_LUT    0x08 /**< calculate orientation from per-calibration lookup tables */
+#define WIIUSE_IR_PREDICT    0x10 /**< track the IR cursor velocity for wiiuse_ir_predict() */
+#define WIIUSE_NO_BUTTONS    0x20 /**< wiimote buttons are not needed, allows the expansion-only report */
+#define WIIUSE_IR_FULL       0x40 /**< full IR mode with dot bounding boxes, only without an expansion */
 #define WIIUSE_INIT_FLAGS (WIIUSE_SMOOTHING | WIIUSE_ORIENT_THRESH)
 
 #define WIIUSE_ORIENT_PRECISION 100.0f
@@ -421,6 +425,14 @@ typedef struct orient_t
     float a_pitch; /**< absolute pitch, unsmoothed				*/
 } orient_t;
 
+/**
+ *	@brief Orientation quaternion, of unit length.
+ */
+typedef struct quat_t
+{
+    float w, x, y, z;
+} quat_t;
+
 /**
  *	@brief Gravity force struct.
  */
@@ -429,6 +441,8 @@ typedef struct gforce_t
     float x, y, z;
 } gforce_t;
 
+struct accel_orient_lut_t;
+
 /**
  *	@brief Accelerometer struct. For any device with an accelerometer.
  */
@@ -437,9 +451,17 @@ typedef struct accel_t
     struct vec3b_t cal_zero; /**< zero calibration					*/
     struct vec3b_t cal_g;    /**< 1g difference around 0cal			*/
 
-    float st_roll;  /**< last smoothed roll value			*/
-    float st_pitch; /**< last smoothed roll pitch			*/
-    float st_alpha; /**< alpha value for smoothing [0-1]	*/
+    float st_roll;          /**< last smoothed roll value			*/
+    float st_pitch;         /**< last smoothed roll pitch			*/
+    float st_alpha;         /**< alpha value for smoothing [0-1]	*/
+    uint64_t st_ns;         /**< time of the last smoothed sample (ns) */
+
+    float st_min_cutoff; /**< One-Euro minimum cutoff (Hz), 0 to use st_alpha */
+    float st_beta;       /**< One-Euro speed coefficient			*/
+    float st_droll;      /**< One-Euro filtered roll rate (deg/s)	*/
+    float st_dpitch;     /**< One-Euro filtered pitch rate (deg/s)	*/
+
+    struct accel_orient_lut_t *orient_lut; /**< orientation tables, see WIIUSE_ORIENT_LUT */
 } accel_t;
 
 /**
@@ -455,16 +477,227 @@ typedef struct ir_dot_t
     int16_t rx; /**< raw X coordinate (0-1023)			*/
     int16_t ry; /**< raw Y coordinate (0-767)			*/
 
-    byte order; /**< increasing order by x-axis value	*/
+    byte order; /**< order by x-axis value, kept while tracked	*/
 
     byte size; /**< size of the IR dot (0-15)			*/
+
+    byte id;  /**< stable id of the IR source, 0 if none	*/
+    float vx; /**< X velocity (pixels per report)		*/
+    float vy; /**< Y velocity (pixels per report)		*/
+
+    byte bb_xmin;   /**< bounding box, 1/8 of the raw coordinates (full IR mode only) */
+    byte bb_ymin;   /**< bounding box top					*/
+    byte bb_xmax;   /**< bounding box right					*/
+    byte bb_ymax;   /**< bounding box bottom				*/
+    byte intensity; /**< brightness of the IR source (full IR mode only) */
 } ir_dot_t;
 
+/**
+ *	@brief Track of one IR source across reports.
+ *
+ *	Used internally to give the dots stable ids, see ir_dot_t::id.
+ */
+typedef struct ir_track_t
+{
+    byte id;     /**< id of the track, 0 if the slot is free	*/
+    byte order;  /**< order of the dot following this track	*/
+    byte missed; /**< reports since the source was last seen	*/
+
+    float x;  /**< last (or predicted) position			*/
+    float y;
+    float vx; /**< velocity (pixels per report)			*/
+    float vy;
+} ir_track_t;
+
 /**
  *	@brief Screen aspect ratio.
  */
 typedef enum aspect_t { WIIUSE_ASPECT_4_3, WIIUSE_ASPECT_16_9 } aspect_t;
 
+/** sustain time of a rumble effect that lasts until it is replaced */
+#define WIIUSE_RUMBLE_FOREVER 0xFFFFFFFFu
+
+/**
+ *	@brief Rumble effect, see wiiuse_rumble_effect().
+ *
+ *	The motor is only on or off, intensity is the duty cycle of a
+ *	software PWM run from wiiuse_poll().
+ */
+typedef struct rumble_t
+{
+    float level;               /**< peak duty cycle [0-1]					*/
+    unsigned int attack;       /**< ramp up time (ms)						*/
+    unsigned int sustain;      /**< time at the peak (ms), or WIIUSE_RUMBLE_FOREVER */
+    unsigned int release;      /**< ramp down time (ms)					*/
+    unsigned long start_ticks; /**< time the effect started				*/
+    byte active;               /**< if an effect is running				*/
+
+    unsigned long period_ticks; /**< start of the current PWM period		*/
+    unsigned long off_ticks;    /**< motor off time in this period, 0 if none */
+    unsigned long fold_ticks;   /**< last time to send the rumble bit on its own */
+    byte on_air;                /**< rumble bit of the last report sent	*/
+
+    struct wiimote_t *next;   /**< timer wheel link						*/
+    struct wiimote_t **pprev; /**< timer wheel link, NULL if not queued	*/
+    unsigned long expiry;     /**< time the timer fires					*/
+} rumble_t;
+
+/**
+ *	@brief Output state last sent to a wiimote.
+ *
+ *	An LED, rumble or report type request that would send what the
+ *	wiimote already has is dropped and counted in \a suppressed.
+ *	Report type changes made while handling input are sent once, at
+ *	the end of wiiuse_poll().
+ */
+typedef struct output_t
+{
+    byte leds;                /**< LEDs last sent							*/
+    byte report_mode;         /**< continuous bit last sent with the report type */
+    byte report_type;         /**< report type last sent					*/
+    byte known;               /**< which of the fields above are valid		*/
+    byte pending;             /**< what is left for wiiuse_poll() to send	*/
+    unsigned long suppressed; /**< requests that needed no report			*/
+} output_t;
+
+/**
+ *	@brief Priority classes of the output queue, highest first.
+ */
+typedef enum outq_class_t {
+    WIIUSE_OUTQ_REALTIME, /**< rumble, LEDs, IR enable and speaker audio */
+    WIIUSE_OUTQ_CONFIG,   /**< report type and status requests		*/
+    WIIUSE_OUTQ_BULK,     /**< memory access and the setup around it	*/
+    WIIUSE_OUTQ_CLASSES
+} outq_class_t;
+
+/** reports each class of the output queue can hold, a power of 2 */
+#define WIIUSE_OUTQ_LEN 16
+
+/** default output rate limit (reports per second) and burst, see wiiuse_set_output_rate() */
+#define WIIUSE_OUTQ_RATE  200
+#define WIIUSE_OUTQ_BURST 10
+
+/**
+ *	@brief An output report waiting to be sent.
+ */
+typedef struct outq_report_t
+{
+    byte type;           /**< report type							*/
+    byte len;            /**< payload length						*/
+    byte data[21];       /**< payload								*/
+    unsigned long ticks; /**< time it was queued					*/
+} outq_report_t;
+
+/**
+ *	@brief Statistics of one class of the output queue.
+ */
+typedef struct outq_stats_t
+{
+    unsigned int depth;        /**< reports waiting						*/
+    unsigned int max_depth;    /**< most reports ever waiting			*/
+    unsigned long sent;        /**< reports sent							*/
+    unsigned long dropped;     /**< reports lost to a full queue or a failed send */
+    unsigned long latency_sum; /**< total time (ms) the sent reports waited */
+    unsigned long latency_max; /**< longest time (ms) a report waited	*/
+} outq_stats_t;
+
+/**
+ *	@brief Output queue, see wiiuse_set_output_rate().
+ *
+ *	Reports go out at once while the rate limit allows and no report
+ *	of the same or a higher class waits.  The others are queued and
+ *	sent by wiiuse_poll(), highest class first.
+ */
+typedef struct outqueue_t
+{
+    struct outq_report_t report[WIIUSE_OUTQ_CLASSES][WIIUSE_OUTQ_LEN]; /**< ring buffers	*/
+    unsigned int head[WIIUSE_OUTQ_CLASSES];                           /**< next to send		*/
+    struct outq_stats_t stats[WIIUSE_OUTQ_CLASSES];                   /**< per class		*/
+
+    unsigned int rate;          /**< reports per second, 0 for no limit	*/
+    unsigned int burst;         /**< reports that may go out back to back */
+    unsigned long tokens;       /**< token bucket, in 1/1000 reports		*/
+    unsigned long tokens_ticks; /**< time the bucket was last filled		*/
+} outqueue_t;
+
+/**
+ *	@brief Commands of the command queue, see wiiuse_submit_leds().
+ */
+typedef enum cmdq_type_t {
+    WIIUSE_CMD_LEDS,           /**< wiiuse_set_leds()			*/
+    WIIUSE_CMD_RUMBLE,         /**< wiiuse_rumble()				*/
+    WIIUSE_CMD_MOTION_SENSING, /**< wiiuse_motion_sensing()		*/
+    WIIUSE_CMD_IR,             /**< wiiuse_set_ir()				*/
+    WIIUSE_CMD_WRITE,          /**< wiiuse_write_data()			*/
+    WIIUSE_CMD_READ            /**< wiiuse_read_data()			*/
+} cmdq_type_t;
+
+/** commands the command queue can hold, a power of 2 */
+#define WIIUSE_CMDQ_LEN 32
+
+/**
+ *	@brief A command waiting for wiiuse_poll().
+ */
+typedef struct cmdq_cmd_t
+{
+    byte type;         /**< a cmdq_type_t						*/
+    uint16_t len;      /**< bytes to read or write				*/
+    int value;         /**< LEDs or on/off						*/
+    unsigned int addr; /**< memory address						*/
+    byte data[16];     /**< bytes to write						*/
+    byte *buffer;      /**< where read data goes				*/
+} cmdq_cmd_t;
+
+/**
+ *	@brief A slot of the command queue.
+ */
+typedef struct cmdq_cell_t
+{
+    volatile long seq;     /**< which turn of the ring the slot is in	*/
+    struct cmdq_cmd_t cmd; /**< the command							*/
+} cmdq_cell_t;
+
+/**
+ *	@brief Command queue, see wiiuse_submit_leds().
+ *
+ *	Any number of threads push commands, the thread that calls
+ *	wiiuse_poll() takes them out and applies them.  Neither side takes
+ *	a lock or waits for the other.
+ */
+typedef struct cmdq_t
+{
+    struct cmdq_cell_t cell[WIIUSE_CMDQ_LEN]; /**< ring buffer				*/
+    volatile long tail;                       /**< next slot to fill, shared by the threads that push */
+    long head;                                /**< next slot to apply, owned by wiiuse_poll() */
+} cmdq_t;
+
+/** bytes of encoded audio a speaker_t can hold, a power of 2 */
+#define WIIUSE_SPEAKER_BUF_LEN 2048
+
+/**
+ *	@brief Speaker stream, see wiiuse_set_speaker().
+ *
+ *	PCM written with wiiuse_speaker_write() is encoded to 4-bit ADPCM
+ *	and sent by wiiuse_poll() at the sample rate.
+ */
+typedef struct speaker_t
+{
+    unsigned int rate; /**< sample rate (Hz), 0 while the speaker is off */
+    byte volume;       /**< volume, 0x40 is the usual level			*/
+
+    int predictor;   /**< ADPCM predictor						*/
+    int step;        /**< ADPCM step size						*/
+    byte nibble;     /**< encoded sample waiting for the next one	*/
+    byte has_nibble; /**< if nibble is set						*/
+
+    byte buf[WIIUSE_SPEAKER_BUF_LEN]; /**< encoded audio not sent yet		*/
+    unsigned int head;                /**< next byte to send					*/
+    unsigned int tail;                /**< next byte to fill					*/
+
+    unsigned long start_ticks; /**< time the stream clock started			*/
+    unsigned long reports;     /**< reports sent since start_ticks		*/
+} speaker_t;
+
 /**
  *	@brief IR struct. Hold all data related to the IR tracking.
  */
@@ -489,6 +722,26 @@ typedef struct ir_t
 
     float distance; /**< pixel distance between first 2 dots*/
     float z;        /**< calculated distance				*/
+
+    struct ir_track_t track[4]; /**< IR source tracks (internal)	*/
+    byte next_track_id;         /**< id given to the next new track	*/
+
+    /** @name Cursor prediction state (internal), see wiiuse_ir_predict() */
+    /** @{ */
+    uint64_t pred_ns; /**< time of the last update (ns)		*/
+    float pred_x;     /**< filtered cursor position		*/
+    float pred_y;
+    float pred_vx; /**< cursor velocity (pixels per second)	*/
+    float pred_vy;
+    byte pred_valid;
+    /** @} */
+
+    /** @name Cached rotation of the roll correction (internal) */
+    /** @{ */
+    float rot_ang;
+    float rot_sin;
+    float rot_cos;
+    /** @} */
 } ir_t;
 
 /**
@@ -515,6 +768,8 @@ typedef struct joystick_t
     float mag; /**< magnitude of the joystick (range 0-1)	*/
     float x;   /**< horizontal position of the joystick (range [-1, 1]	*/
     float y;   /**< vertical position of the joystick (range [-1, 1]	*/
+
+    float *norm_lut; /**< position of every raw x then y value, built at handshake */
 } joystick_t;
 
 /**
@@ -584,6 +839,22 @@ typedef struct motion_plus_t
                       still) */
     int raw_gyro_threshold; /**< threshold for gyroscopes to generate an event */
 
+    struct quat_t quat;       /**< orientation fused from the gyroscopes and the wiimote accelerometer */
+    float ahrs_beta;          /**< accelerometer correction gain, see wiiuse_set_motion_plus_ahrs_gain() */
+    uint64_t ahrs_ns;         /**< time of the last gyro frame (internal) */
+    byte ahrs_valid;          /**< if \a quat has been initialized (internal) */
+
+    /** @name Online gyro bias estimation (internal)
+     *
+     *  \a cal_gyro follows \a gyro_bias while the wiimote is held still.
+     */
+    /** @{ */
+    struct ang3f_t gyro_mean; /**< running mean of raw_gyro */
+    struct ang3f_t gyro_var;  /**< running variance of raw_gyro */
+    struct ang3f_t gyro_bias; /**< estimated raw value at rest */
+    int still_count;          /**< consecutive gyro frames found still */
+    /** @} */
+
     struct nunchuk_t *nc; /**< pointers to nunchuk & classic in pass-through-mode */
     struct classic_ctrl_t *classic;
 } motion_plus_t;
@@ -599,9 +870,6 @@ typedef struct wii_board_t
     /** @name Interpolated weight per sensor (kg)
      *
      *  These are the values you're most likely to use.
-     *
-     *  See example.c for how to compute total weight and center of gravity
-     *  from these values.
      */
     /** @{ */
     float tl;
@@ -610,6 +878,18 @@ typedef struct wii_board_t
     float br;
     /** @} */
 
+    /** @name Total weight (kg) and center of pressure
+     *
+     *  The center of pressure ranges from -1 to 1, left to right for
+     *  \a cop_x and bottom to top for \a cop_y.  It is 0 when the board
+     *  is empty.
+     */
+    /** @{ */
+    float total;
+    float cop_x;
+    float cop_y;
+    /** @} */
+
     /** @name Raw sensor values */
     /** @{ */
     uint16_t rtl;
@@ -625,6 +905,21 @@ typedef struct wii_board_t
     uint16_t cbl[3];
     uint16_t cbr[3]; /* /Calibration */
     /** @} */
+
+    /** @name Interpolation coefficients derived from the calibration
+     *
+     *  Sensor order is tl, tr, bl, br.  Updated by the handshake and
+     *  wiiuse_set_wii_board_calib().
+     */
+    /** @{ */
+    float cal_lo[4];    /* 0 kg */
+    float cal_mid[4];   /* 17 kg */
+    float cal_hi[4];    /* 34 kg */
+    float slope_lo[4];  /* kg per count below 17 kg */
+    float slope_hi[4];  /* kg per count above 17 kg */
+    int64_t slope_lo_q32[4]; /* the slopes in Q32, for WIIUSE_FIXED_POINT builds */
+    int64_t slope_hi_q32[4];
+    /** @} */
     uint8_t update_calib;
     uint8_t use_alternate_report;
 } wii_board_t;
@@ -722,13 +1017,91 @@ typedef enum WIIUSE_WIIMOTE_TYPE {
     WIIUSE_WIIMOTE_MOTION_PLUS_INSIDE,
 } WIIUSE_WIIMOTE_TYPE;
 
+/** adapter the system picks, see wiiuse_set_adapter() */
+#define WIIUSE_ADAPTER_DEFAULT (-1)
+
+/** most bluetooth adapters wiiuse_find() and wiiuse_connect() spread the wiimotes over */
+#define WIIUSE_MAX_ADAPTERS 16
+
+/**
+ *	@brief Load of a bluetooth adapter, see wiiuse_adapter_stats().
+ */
+typedef struct wiiuse_adapter_stats_t
+{
+    int adapter;              /**< HCI device id, or WIIUSE_ADAPTER_DEFAULT	*/
+    int devices;              /**< connected wiimotes						*/
+    unsigned int report_rate; /**< reports per second received from them	*/
+} wiiuse_adapter_stats_t;
+
+/**
+ *	@brief Memory allocator of a context, see wiiuse_context_new().
+ *
+ *	\a alloc must return memory aligned as malloc() does.
+ */
+typedef struct wiiuse_allocator_t
+{
+    void *(*alloc)(size_t size, void *user); /**< allocate \a size bytes, NULL if out of memory */
+    void (*free)(void *ptr, void *user);     /**< release what alloc returned	*/
+    void *user;                              /**< passed to both functions	*/
+} wiiuse_allocator_t;
+
+/**
+ *	@brief Library context, see wiiuse_context_new().
+ *
+ *	Opaque, only used through the wiiuse_context_*() functions.
+ */
+typedef struct wiiuse_context_t wiiuse_context_t;
+
 /**
  *	@brief Main Wiimote device structure.
  *
  *  You need one of these to do pretty much anything with this library.
+ *
+ *  The members decoding reads or writes for every report come first and
+ *  share a few cache lines; wiiuse_init() aligns the structure to a
+ *  cache line.  The state of IR and the expansion follow, then the
+ *  connection details, request lists and output buffers, which a report
+ *  does not touch.
  */
 typedef struct wiimote_t
 {
+    /** @name Per-report state */
+    /** @{ */
+    int state;               /**< various state flags					*/
+    int flags;               /**< options flag							*/
+    WIIUSE_EVENT_TYPE event; /**< type of event that occurred				*/
+
+    uint16_t btns;          /**< what buttons have just been pressed	*/
+    uint16_t btns_held;     /**< what buttons are being held down		*/
+    uint16_t btns_released; /**< what buttons were just released this	*/
+
+    struct vec3b_t accel;   /**< current raw acceleration data			*/
+    struct orient_t orient; /**< current orientation on each axis		*/
+    struct gforce_t gforce; /**< current gravity forces on each axis	*/
+
+    float orient_threshold;  /**< threshold for orient to generate an event */
+    int32_t accel_threshold; /**< threshold for accel to generate an event */
+
+    unsigned long report_ticks; /**< time the last report was received, see wiiuse_ticks() */
+    uint64_t report_ns;         /**< time the last report arrived (ns), see wiiuse_ticks_ns() */
+    unsigned long reports;      /**< reports received						*/
+    unsigned int report_rate;   /**< reports per second, see wiiuse_adapter_stats() */
+    uint64_t rate_ns;           /**< start of the report rate window		*/
+    unsigned long rate_reports; /**< reports at the start of the window		*/
+
+    struct accel_t accel_calib;    /**< wiimote accelerometer calibration		*/
+    struct wiimote_state_t lstate; /**< last saved state						*/
+    /** @} */
+
+    /** @name Per-report state of IR and the expansion */
+    /** @{ */
+    struct ir_t ir;        /**< IR data								*/
+    byte ir_full_half[21]; /**< first report (0x3E) of a full IR pair		*/
+    byte ir_full_pending;  /**< ir_full_half holds a report waiting for 0x3F	*/
+
+    struct expansion_t exp; /**< wiimote expansion device				*/
+    /** @} */
+
     int unid; /**< user specified id						*/
 
 #ifdef WIIUSE_BLUEZ
@@ -760,12 +1133,9 @@ typedef struct wiimote_t
                           /** @} */
 #endif
 
-    int state;           /**< various state flags					*/
     byte leds;           /**< currently lit leds						*/
     float battery_level; /**< battery level							*/
 
-    int flags; /**< options flag							*/
-
 #ifndef WIIUSE_SYNC_HANDSHAKE
     byte handshake_state; /**< the state of the connection handshake	*/
 #endif
@@ -773,27 +1143,21 @@ typedef struct wiimote_t
     struct data_req_t *data_req; /**< list of data read requests				*/
 
     struct read_req_t *read_req; /**< list of data read requests				*/
-    struct accel_t accel_calib;  /**< wiimote accelerometer calibration		*/
-    struct expansion_t exp;      /**< wiimote expansion device				*/
-
-    struct vec3b_t accel;   /**< current raw acceleration data			*/
-    struct orient_t orient; /**< current orientation on each axis		*/
-    struct gforce_t gforce; /**< current gravity forces on each axis	*/
 
-    struct ir_t ir; /**< IR data								*/
-
-    uint16_t btns;          /**< what buttons have just been pressed	*/
-    uint16_t btns_held;     /**< what buttons are being held down		*/
-    uint16_t btns_released; /**< what buttons were just released this	*/
+    byte motion_plus_id[6];
+    WIIUSE_WIIMOTE_TYPE type;
 
-    float orient_threshold;  /**< threshold for orient to generate an event */
-    int32_t accel_threshold; /**< threshold for accel to generate an event */
+    struct speaker_t speaker; /**< speaker stream							*/
+    struct rumble_t rumble;   /**< rumble effect							*/
+    struct output_t out;      /**< output reports last sent				*/
+    struct outqueue_t outq;   /**< output reports waiting to be sent		*/
+    struct cmdq_t cmdq;       /**< commands pushed by other threads		*/
 
-    struct wiimote_state_t lstate; /**< last saved state						*/
+    int adapter;     /**< bluetooth adapter of the connection, WIIUSE_ADAPTER_DEFAULT if the system picks */
+    int adapter_pin; /**< adapter set with wiiuse_set_adapter(), WIIUSE_ADAPTER_DEFAULT if none */
 
-    WIIUSE_EVENT_TYPE event; /**< type of event that occurred				*/
-    byte motion_plus_id[6];
-    WIIUSE_WIIMOTE_TYPE type;
+    struct wiiuse_context_t *ctx;       /**< context the wiimote belongs to, or NULL */
+    struct wiiuse_registry_t *registry; /**< registry the wiimote belongs to, or NULL */
 } wiimote;
 
 /** @brief Data passed to a callback during wiiuse_update() */
@@ -812,8 +1176,68 @@ typedef struct wiimote_callback_data_t
     WIIUSE_EVENT_TYPE event;
     int state;
     struct expansion_t expansion;
+    uint64_t report_ns; /**< time the last report arrived (ns), see wiiuse_ticks_ns() */
 } wiimote_callback_data_t;
 
+/** @brief Maximum length of a raw input report (report id and payload). */
+#define WIIUSE_RAW_REPORT_LEN 22
+
+/**
+ *	@brief A raw input report, as handed to wiiuse_decode_batch().
+ */
+typedef struct wiiuse_raw_report_t
+{
+    int wiimote;                      /**< index of the sending wiimote in the wiimote array */
+    byte data[WIIUSE_RAW_REPORT_LEN]; /**< report id followed by the report payload	*/
+} wiiuse_raw_report_t;
+
+/** @name Fields present in an entry of a wiiuse_batch_t */
+/** @{ */
+#define WIIUSE_BATCH_BUTTONS 0x01
+#define WIIUSE_BATCH_ACCEL   0x02
+#define WIIUSE_BATCH_IR      0x04
+/** @} */
+
+/**
+ *	@brief Decoded reports of many wiimotes, stored as structure of arrays.
+ *
+ *	Entry \a i of every array belongs to the \a i th report passed to
+ *	wiiuse_decode_batch().  Allocate with wiiuse_batch_alloc().
+ */
+typedef struct wiiuse_batch_t
+{
+    int capacity; /**< maximum number of entries				*/
+    int count;    /**< number of valid entries				*/
+
+    int *wiimote; /**< index of the sending wiimote			*/
+    byte *report; /**< report id								*/
+    byte *fields; /**< WIIUSE_BATCH_* flags of valid data		*/
+
+    uint16_t *btns; /**< buttons held down in the report		*/
+
+    byte *accel_x; /**< raw acceleration						*/
+    byte *accel_y;
+    byte *accel_z;
+
+    float *gforce_x; /**< calibrated gravity force				*/
+    float *gforce_y;
+    float *gforce_z;
+
+    int16_t *ir_rx[4]; /**< raw X coordinate of each IR dot		*/
+    int16_t *ir_ry[4]; /**< raw Y coordinate of each IR dot		*/
+    byte *ir_size[4];  /**< size of each IR dot					*/
+    byte *ir_visible;  /**< bit N set if IR dot N is visible		*/
+
+    float *scratch; /**< internal working memory				*/
+} wiiuse_batch_t;
+
+/**
+ *	@brief Device registry, see wiiuse_registry_new().
+ *
+ *	Opaque, only used through the wiiuse_registry_*() functions.
+ */
+typedef struct wiiuse_registry_t wiiuse_registry_t;
+
 /** @brief Callback type */
 typedef void (*wiiuse_update_cb)(struct wiimote_callback_data_t *wm);
 
@@ -899,6 +1323,7 @@ WIIUSE_EXPORT extern const char *wiiuse_version();
 WIIUSE_EXPORT extern void wiiuse_set_output(enum wiiuse_loglevel loglevel, FILE *logtarget);
 
 WIIUSE_EXPORT extern struct wiimote_t **wiiuse_init(int wiimotes);
+WIIUSE_EXPORT extern struct wiimote_t **wiiuse_init_arena(int wiimotes);
 WIIUSE_EXPORT extern void wiiuse_disconnected(struct wiimote_t *wm);
 WIIUSE_EXPORT extern void wiiuse_cleanup(struct wiimote_t **wm, int wiimotes);
 WIIUSE_EXPORT extern void wiiuse_rumble(struct wiimote_t *wm, int status);
@@ -913,6 +1338,7 @@ WIIUSE_EXPORT extern void wiiuse_status(struct wiimote_t *wm);
 WIIUSE_EXPORT extern struct wiimote_t *wiiuse_get_by_id(struct wiimote_t **wm, int wiimotes, int unid);
 WIIUSE_EXPORT extern int wiiuse_set_flags(struct wiimote_t *wm, int enable, int disable);
 WIIUSE_EXPORT extern float wiiuse_set_smooth_alpha(struct wiimote_t *wm, float alpha);
+WIIUSE_EXPORT extern void wiiuse_set_smooth_one_euro(struct wiimote_t *wm, float min_cutoff, float beta);
 WIIUSE_EXPORT extern void wiiuse_set_bluetooth_stack(struct wiimote_t **wm, int wiimotes,
                                                      enum win_bt_stack_t type);
 WIIUSE_EXPORT extern void wiiuse_set_orient_threshold(struct wiimote_t *wm, float threshold);
@@ -921,11 +1347,16 @@ WIIUSE_EXPORT extern void wiiuse_set_timeout(struct wiimote_t **wm, int wiimotes
                                              byte exp_timeout);
 WIIUSE_EXPORT extern void wiiuse_set_accel_threshold(struct wiimote_t *wm, int threshold);
 WIIUSE_EXPORT extern void wiiuse_wiiboard_use_alternate_report(struct wiimote_t *wm, int enabled);
+WIIUSE_EXPORT extern unsigned long wiiuse_ticks();
+WIIUSE_EXPORT extern uint64_t wiiuse_ticks_ns();
 
 /* io.c */
 WIIUSE_EXPORT extern int wiiuse_find(struct wiimote_t **wm, int max_wiimotes, int timeout);
 WIIUSE_EXPORT extern int wiiuse_connect(struct wiimote_t **wm, int wiimotes);
 WIIUSE_EXPORT extern void wiiuse_disconnect(struct wiimote_t *wm);
+WIIUSE_EXPORT extern void wiiuse_set_adapter(struct wiimote_t *wm, int adapter);
+WIIUSE_EXPORT extern int wiiuse_adapter_stats(struct wiimote_t **wm, int wiimotes,
+                                              struct wiiuse_adapter_stats_t *stats, int max);
 
 /* events.c */
 WIIUSE_EXPORT extern int wiiuse_poll(struct wiimote_t **wm, int wiimotes);
@@ -941,21 +1372,80 @@ WIIUSE_EXPORT extern int wiiuse_poll(struct wiimote_t **wm, int wiimotes);
  */
 WIIUSE_EXPORT extern int wiiuse_update(struct wiimote_t **wm, int wiimotes, wiiuse_update_cb callback);
 
+/* dynamics.c */
+WIIUSE_EXPORT extern void wiiuse_calculate_gforce_batch(const struct accel_t *ac, const int *calib,
+                                                        const struct vec3b_t *accel, struct gforce_t *gforce,
+                                                        int count);
+WIIUSE_EXPORT extern void wiiuse_calculate_orientation_batch(const struct accel_t *ac, const int *calib,
+                                                             const struct vec3b_t *accel, float *roll,
+                                                             float *pitch, int count);
+
 /* ir.c */
 WIIUSE_EXPORT extern void wiiuse_set_ir(struct wiimote_t *wm, int status);
 WIIUSE_EXPORT extern void wiiuse_set_ir_vres(struct wiimote_t *wm, unsigned int x, unsigned int y);
 WIIUSE_EXPORT extern void wiiuse_set_ir_position(struct wiimote_t *wm, enum ir_position_t pos);
 WIIUSE_EXPORT extern void wiiuse_set_aspect_ratio(struct wiimote_t *wm, enum aspect_t aspect);
 WIIUSE_EXPORT extern void wiiuse_set_ir_sensitivity(struct wiimote_t *wm, int level);
+WIIUSE_EXPORT extern int wiiuse_ir_predict(struct wiimote_t *wm, unsigned long ticks, int *x, int *y);
+
+/* outqueue.c */
+WIIUSE_EXPORT extern void wiiuse_set_output_rate(struct wiimote_t *wm, unsigned int rate, unsigned int burst);
+
+/* cmdq.c */
+WIIUSE_EXPORT extern int wiiuse_submit_leds(struct wiimote_t *wm, int leds);
+WIIUSE_EXPORT extern int wiiuse_submit_rumble(struct wiimote_t *wm, int status);
+WIIUSE_EXPORT extern int wiiuse_submit_motion_sensing(struct wiimote_t *wm, int status);
+WIIUSE_EXPORT extern int wiiuse_submit_ir(struct wiimote_t *wm, int status);
+WIIUSE_EXPORT extern int wiiuse_submit_write(struct wiimote_t *wm, unsigned int addr, const byte *data, byte len);
+WIIUSE_EXPORT extern int wiiuse_submit_read(struct wiimote_t *wm, byte *buffer, unsigned int offset, uint16_t len);
+
+/* registry.c */
+WIIUSE_EXPORT extern struct wiiuse_registry_t *wiiuse_registry_new();
+WIIUSE_EXPORT extern void wiiuse_registry_free(struct wiiuse_registry_t *reg);
+WIIUSE_EXPORT extern struct wiimote_t *wiiuse_registry_add(struct wiiuse_registry_t *reg, const char *bdaddr);
+WIIUSE_EXPORT extern void wiiuse_registry_remove(struct wiiuse_registry_t *reg, struct wiimote_t *wm);
+WIIUSE_EXPORT extern struct wiimote_t *wiiuse_registry_get_by_id(struct wiiuse_registry_t *reg, int unid);
+WIIUSE_EXPORT extern struct wiimote_t *wiiuse_registry_get_by_bdaddr(struct wiiuse_registry_t *reg,
+                                                                     const char *bdaddr);
+WIIUSE_EXPORT extern struct wiimote_t **wiiuse_registry_devices(struct wiiuse_registry_t *reg, int *count);
+WIIUSE_EXPORT extern int wiiuse_registry_connected(struct wiiuse_registry_t *reg, struct wiimote_t **wm, int max);
+
+/* context.c */
+WIIUSE_EXPORT extern struct wiiuse_context_t *wiiuse_context_new(const struct wiiuse_allocator_t *allocator);
+WIIUSE_EXPORT extern void wiiuse_context_free(struct wiiuse_context_t *ctx);
+WIIUSE_EXPORT extern void wiiuse_context_set_output(struct wiiuse_context_t *ctx, enum wiiuse_loglevel loglevel,
+                                                    FILE *logtarget);
+WIIUSE_EXPORT extern struct wiiuse_context_t *wiiuse_context_bind(struct wiiuse_context_t *ctx);
+WIIUSE_EXPORT extern struct wiiuse_registry_t *wiiuse_context_registry(struct wiiuse_context_t *ctx);
+WIIUSE_EXPORT extern int wiiuse_context_poll(struct wiiuse_context_t *ctx);
+WIIUSE_EXPORT extern int wiiuse_context_update(struct wiiuse_context_t *ctx, wiiuse_update_cb callback);
+
+/* rumble.c */
+WIIUSE_EXPORT extern void wiiuse_rumble_level(struct wiimote_t *wm, float level);
+WIIUSE_EXPORT extern void wiiuse_rumble_effect(struct wiimote_t *wm, float level, unsigned int attack,
+                                               unsigned int sustain, unsigned int release);
+
+/* speaker.c */
+WIIUSE_EXPORT extern void wiiuse_set_speaker(struct wiimote_t *wm, int status, unsigned int rate, byte volume);
+WIIUSE_EXPORT extern int wiiuse_speaker_write(struct wiimote_t *wm, const int16_t *pcm, int samples);
+WIIUSE_EXPORT extern unsigned long wiiuse_speaker_deadline(struct wiimote_t **wm, int wiimotes);
 
 /* nunchuk.c */
 WIIUSE_EXPORT extern void wiiuse_set_nunchuk_orient_threshold(struct wiimote_t *wm, float threshold);
 WIIUSE_EXPORT extern void wiiuse_set_nunchuk_accel_threshold(struct wiimote_t *wm, int threshold);
 
+/* batch.c */
+WIIUSE_EXPORT extern struct wiiuse_batch_t *wiiuse_batch_alloc(int capacity);
+WIIUSE_EXPORT extern void wiiuse_batch_free(struct wiiuse_batch_t *batch);
+WIIUSE_EXPORT extern int wiiuse_decode_batch(struct wiimote_t **wm, int wiimotes,
+                                             const struct wiiuse_raw_report_t *reports, int count,
+                                             struct wiiuse_batch_t *batch);
+
 /* wiiboard.c */
 WIIUSE_EXPORT extern void wiiuse_set_wii_board_calib(struct wiimote_t *wm);
 
 WIIUSE_EXPORT extern void wiiuse_set_motion_plus(struct wiimote_t *wm, int status);
+WIIUSE_EXPORT extern void wiiuse_set_motion_plus_ahrs_gain(struct wiimote_t *wm, float beta);
 
 #ifdef __cplusplus
 }
@@ -110,9 +110,12 @@
 #define WM_CMD_REPORT_TYPE    0x12
 #define WM_CMD_RUMBLE         0x13
 #define WM_CMD_IR             0x13
+#define WM_CMD_SPEAKER_ENABLE 0x14
 #define WM_CMD_CTRL_STATUS    0x15
 #define WM_CMD_WRITE_DATA     0x16
 #define WM_CMD_READ_DATA      0x17
+#define WM_CMD_SPEAKER_DATA   0x18
+#define WM_CMD_SPEAKER_MUTE   0x19
 #define WM_CMD_IR_2           0x1A
 
 /* input report ids */
@@ -127,6 +130,21 @@
 #define WM_RPT_BTN_ACC_EXP    0x35
 #define WM_RPT_BTN_IR_EXP     0x36
 #define WM_RPT_BTN_ACC_IR_EXP 0x37
+#define WM_RPT_EXP            0x3D
+#define WM_RPT_BTN_ACC_IR_1   0x3E /* interleaved with 0x3F, full IR */
+#define WM_RPT_BTN_ACC_IR_2   0x3F
+
+/* data carried by an input report, see wiiuse_set_report_type() */
+#define WM_RPT_DATA_BTN      0x01
+#define WM_RPT_DATA_ACC      0x02
+#define WM_RPT_DATA_IR_BASIC 0x04
+#define WM_RPT_DATA_IR_EXT   0x08
+#define WM_RPT_DATA_IR_FULL  0x10
+#define WM_RPT_DATA_IR       (WM_RPT_DATA_IR_BASIC | WM_RPT_DATA_IR_EXT | WM_RPT_DATA_IR_FULL)
+
+/* output state tracked in wiimote_t::out */
+#define WM_OUT_LEDS   0x01
+#define WM_OUT_REPORT 0x02
 
 #define WM_BT_INPUT           0x01
 #define WM_BT_OUTPUT          0x02
@@ -189,12 +207,16 @@
 #define WM_REG_IR_BLOCK1                     0x04B00000
 #define WM_REG_IR_BLOCK2                     0x04B0001A
 #define WM_REG_IR_MODENUM                    0x04B00033
+#define WM_REG_SPEAKER_CONFIG                0x04A20001
+#define WM_REG_SPEAKER_PLAY                  0x04A20008
+#define WM_REG_SPEAKER_ENABLE                0x04A20009
 
 /* unknown Wii Balance Board offsets used for init */
 #define WM_EXP_BBOARD_INIT1                  0x04A400F1
 
 #define WM_IR_TYPE_BASIC                     0x01
 #define WM_IR_TYPE_EXTENDED                  0x03
+#define WM_IR_TYPE_FULL                      0x05
 
 /* controller status flags for the first message byte */
 /* bit 1 is unknown */
@@ -243,6 +265,12 @@
 
 #define WIIMOTE_INIT_STATES (WIIMOTE_STATE_IR_SENS_LVL3)
 
+/* wiimote_t is allocated on a cache line boundary, a power of 2 */
+#define WIIMOTE_CACHE_LINE 64
+
+/* wiimote_t::report_rate is measured over windows of this length (ns) */
+#define WIIMOTE_RATE_WINDOW_NS 1000000000ULL
+
 /* macro to manage states */
 #define WIIMOTE_ENABLE_STATE(wm, s) (wm->state |= (s))
 #define WIIMOTE_DISABLE_STATE(wm, s) (wm->state &= ~(s))
@@ -271,6 +299,17 @@
  */
 #define WIIUSE_DEFAULT_SMOOTH_ALPHA 0.07f
 
+/*
+ *	alpha is given for samples WIIUSE_SMOOTH_INTERVAL s apart, other
+ *	report intervals get the alpha of the same time constant.  Gaps
+ *	longer than WIIUSE_SMOOTH_MAX_DT s count as WIIUSE_SMOOTH_MAX_DT.
+ */
+#define WIIUSE_SMOOTH_INTERVAL 0.01f
+#define WIIUSE_SMOOTH_MAX_DT 0.1f
+
+/* cutoff (Hz) of the One-Euro filter on the angle rate */
+#define WIIUSE_ONE_EURO_D_CUTOFF 1.0f
+
 #define SMOOTH_ROLL 0x01
 #define SMOOTH_PITCH 0x02
 
@@ -306,7 +345,12 @@ extern "C" {
  */
 void wiiuse_millisleep(int durationMilliseconds);
 
+void wiiuse_print_banner();
+struct wiimote_t *wiiuse_new_wiimote(struct wiiuse_context_t *ctx, int unid);
+void wiiuse_delete_wiimote(struct wiimote_t *wm);
 int wiiuse_set_report_type(struct wiimote_t *wm);
+void wiiuse_defer_report_type(struct wiimote_t *wm);
+void wiiuse_flush_output(struct wiimote_t *wm);
 void wiiuse_send_next_pending_read_request(struct wiimote_t *wm);
 void wiiuse_send_next_pending_write_request(struct wiimote_t *wm);
 int wiiuse_send(struct wiimote_t *wm, byte report_type, byte *msg, int len);
@@ -0,0 +1,107 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Throughput of the batch g-force and orientation kernels.
+ *
+ *	Prints the time per sample of the scalar functions and of their
+ *	batch versions, best of several runs.
+ */
+
+#include "dynamics.h" /* for calculate_gforce, calculate_orientation */
+#include "os.h"       /* for wiiuse_os_ticks_ns */
+
+#include <stdio.h>  /* for printf */
+#include <stdlib.h> /* for rand, srand */
+#include <string.h> /* for memset */
+
+#define SAMPLES 4096
+#define RUNS    50
+
+static struct vec3b_t accel[SAMPLES];
+static struct gforce_t gforce[SAMPLES];
+static float roll[SAMPLES], pitch[SAMPLES];
+static struct orient_t orient;
+
+/* best time of a run over all samples, in ns per sample */
+static double best_of(uint64_t *best, uint64_t start)
+{
+    uint64_t t = wiiuse_os_ticks_ns() - start;
+
+    if (!*best || t < *best)
+    {
+        *best = t;
+    }
+    return (double)*best / SAMPLES;
+}
+
+int main(void)
+{
+    struct accel_t ac;
+    uint64_t best[4] = {0, 0, 0, 0};
+    double ns[4];
+    int run, i;
+
+    memset(&ac, 0, sizeof(ac));
+    ac.cal_zero.x = ac.cal_zero.y = ac.cal_zero.z = 128;
+    ac.cal_g.x = ac.cal_g.y = ac.cal_g.z = 26;
+
+    srand(1);
+    for (i = 0; i < SAMPLES; ++i)
+    {
+        accel[i].x = 128 + rand() % 53 - 26;
+        accel[i].y = 128 + rand() % 53 - 26;
+        accel[i].z = 128 + rand() % 53 - 26;
+    }
+
+    for (run = 0; run < RUNS; ++run)
+    {
+        uint64_t start = wiiuse_os_ticks_ns();
+        for (i = 0; i < SAMPLES; ++i)
+        {
+            calculate_gforce(&ac, &accel[i], &gforce[i]);
+        }
+        ns[0] = best_of(&best[0], start);
+
+        start = wiiuse_os_ticks_ns();
+        wiiuse_calculate_gforce_batch(&ac, NULL, accel, gforce, SAMPLES);
+        ns[1] = best_of(&best[1], start);
+
+        start = wiiuse_os_ticks_ns();
+        for (i = 0; i < SAMPLES; ++i)
+        {
+            calculate_orientation(&ac, &accel[i], &orient, 0, 0);
+            roll[i] = orient.roll;
+        }
+        ns[2] = best_of(&best[2], start);
+
+        start = wiiuse_os_ticks_ns();
+        wiiuse_calculate_orientation_batch(&ac, NULL, accel, roll, pitch, SAMPLES);
+        ns[3] = best_of(&best[3], start);
+    }
+
+    printf("gforce:      scalar %6.2f ns/sample, batch %6.2f ns/sample (%.1fx)\n", ns[0], ns[1], ns[0] / ns[1]);
+    printf("orientation: scalar %6.2f ns/sample, batch %6.2f ns/sample (%.1fx)\n", ns[2], ns[3], ns[2] / ns[3]);
+
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Time of the float and fixed-point per-report math.
+ *
+ *	Build once with and once without WIIUSE_FIXED_POINT and compare.
+ *	Prints the time of each function per call, best of several runs.
+ */
+
+#include "dynamics.h" /* for calculate_gforce, calculate_orientation, calc_joystick_state */
+#include "os.h"       /* for wiiuse_os_ticks_ns */
+#include "wiiboard.h" /* for wii_board_event, wii_board_update_coefficients */
+
+#include <stdio.h>  /* for printf */
+#include <string.h> /* for memset */
+
+#define CALLS 100000
+#define RUNS  20
+
+/* keeps the results alive so the calls are not optimized out */
+static volatile float sink;
+
+static double ns_per_call(uint64_t best) { return (double)best / CALLS; }
+
+static void keep_best(uint64_t *best, uint64_t start)
+{
+    uint64_t t = wiiuse_os_ticks_ns() - start;
+
+    if (!*best || t < *best)
+    {
+        *best = t;
+    }
+}
+
+int main(void)
+{
+    struct accel_t ac;
+    struct vec3b_t accel;
+    struct orient_t orient;
+    struct gforce_t gforce;
+    struct joystick_t js;
+    struct wii_board_t wb;
+    byte msg[8];
+    uint64_t best[4] = {0, 0, 0, 0};
+    int run, i;
+
+    memset(&ac, 0, sizeof(ac));
+    ac.cal_zero.x = ac.cal_zero.y = ac.cal_zero.z = 128;
+    ac.cal_g.x = ac.cal_g.y = ac.cal_g.z = 26;
+    memset(&orient, 0, sizeof(orient));
+
+    memset(&js, 0, sizeof(js));
+    js.min.x = js.min.y = 30;
+    js.max.x = js.max.y = 220;
+    js.center.x = js.center.y = 128;
+
+    memset(&wb, 0, sizeof(wb));
+    for (i = 0; i < 3; ++i)
+    {
+        wb.ctl[i] = wb.ctr[i] = wb.cbl[i] = wb.cbr[i] = 1000 + i * 1700;
+    }
+    wii_board_update_coefficients(&wb);
+
+    for (run = 0; run < RUNS; ++run)
+    {
+        uint64_t start = wiiuse_os_ticks_ns();
+        for (i = 0; i < CALLS; ++i)
+        {
+            accel.x = 110 + (i & 31);
+            accel.y = 140 - (i & 15);
+            accel.z = 120 + (i & 7);
+            calculate_orientation(&ac, &accel, &orient, 0, 0);
+        }
+        keep_best(&best[0], start);
+        sink = orient.roll;
+
+        start = wiiuse_os_ticks_ns();
+        for (i = 0; i < CALLS; ++i)
+        {
+            accel.x = 110 + (i & 31);
+            calculate_gforce(&ac, &accel, &gforce);
+        }
+        keep_best(&best[1], start);
+        sink = gforce.x;
+
+        start = wiiuse_os_ticks_ns();
+        for (i = 0; i < CALLS; ++i)
+        {
+            calc_joystick_state(&js, (byte)i, (byte)(i >> 8));
+        }
+        keep_best(&best[2], start);
+        sink = js.ang;
+
+        start = wiiuse_os_ticks_ns();
+        for (i = 0; i < CALLS; ++i)
+        {
+            int kg = 1000 + (i & 4095);
+
+            msg[0] = msg[2] = msg[4] = msg[6] = (byte)(kg >> 8);
+            msg[1] = msg[3] = msg[5] = msg[7] = (byte)kg;
+            wii_board_event(&wb, msg);
+        }
+        keep_best(&best[3], start);
+        sink = wb.cop_x;
+    }
+
+#ifdef WIIUSE_FIXED_POINT
+    printf("fixed-point build\n");
+#else
+    printf("float build\n");
+#endif
+    printf("calculate_orientation %6.2f ns\n", ns_per_call(best[0]));
+    printf("calculate_gforce      %6.2f ns\n", ns_per_call(best[1]));
+    printf("calc_joystick_state   %6.2f ns\n", ns_per_call(best[2]));
+    printf("wii_board_event       %6.2f ns\n", ns_per_call(best[3]));
+
+    return 0;
+}
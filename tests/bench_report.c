@@ -0,0 +1,100 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Time to decode a report, for one wiimote and for many.
+ *
+ *	Decoding reports round-robin over more wiimotes than the second
+ *	level cache holds misses on every cache line of wiimote_t the decode
+ *	touches; the same reports on one wiimote do not.  The difference is
+ *	what the layout of wiimote_t can win.  It shows best for button
+ *	reports, which do little besides touching the structure.
+ */
+
+#include "events.h" /* for propagate_event */
+#include "os.h"     /* for wiiuse_os_ticks_ns */
+
+#include <stddef.h> /* for offsetof */
+#include <stdio.h>  /* for printf */
+
+#define WIIMOTES 4096
+#define REPORTS  (16 * WIIMOTES)
+#define RUNS     5
+
+/**
+ *	@brief Best time (ns) of decoding REPORTS reports of type \a type on the first \a n wiimotes.
+ */
+static uint64_t decode(struct wiimote_t **wm, int n, byte type)
+{
+    byte msg[5] = {0x00, 0x00, 0x80, 0x80, 0x9a};
+    uint64_t best = 0;
+    int run, round, i;
+
+    for (run = 0; run < RUNS; ++run)
+    {
+        uint64_t start = wiiuse_os_ticks_ns();
+        uint64_t t;
+
+        for (round = 0; round < REPORTS / n; ++round)
+        {
+            msg[0] = (byte)(round & 1);
+            msg[2] = (byte)(0x70 + (round & 31));
+            for (i = 0; i < n; ++i)
+            {
+                propagate_event(wm[i], type, msg);
+            }
+        }
+
+        t = wiiuse_os_ticks_ns() - start;
+        if (!best || t < best)
+        {
+            best = t;
+        }
+    }
+    return best;
+}
+
+int main(void)
+{
+    struct wiimote_t **wm = wiiuse_init(WIIMOTES);
+    size_t hot            = offsetof(struct wiimote_t, lstate) + sizeof(wm[0]->lstate);
+    int i;
+
+    for (i = 0; i < WIIMOTES; ++i)
+    {
+        WIIMOTE_ENABLE_STATE(wm[i], WIIMOTE_STATE_CONNECTED | WIIMOTE_STATE_ACC);
+        wm[i]->accel_calib.cal_zero.x = wm[i]->accel_calib.cal_zero.y = wm[i]->accel_calib.cal_zero.z = 0x80;
+        wm[i]->accel_calib.cal_g.x = wm[i]->accel_calib.cal_g.y = wm[i]->accel_calib.cal_g.z = 0x1a;
+    }
+
+    printf("sizeof(wiimote_t)        %6u bytes\n", (unsigned int)sizeof(struct wiimote_t));
+    printf("per-report members       %6u cache lines\n",
+           (unsigned int)((hot + WIIMOTE_CACHE_LINE - 1) / WIIMOTE_CACHE_LINE));
+    printf("buttons,      1 wiimote  %6.1f ns/report\n", (double)decode(wm, 1, WM_RPT_BTN) / REPORTS);
+    printf("buttons,  %5d wiimotes %6.1f ns/report\n", WIIMOTES, (double)decode(wm, WIIMOTES, WM_RPT_BTN) / REPORTS);
+    printf("accel,        1 wiimote  %6.1f ns/report\n", (double)decode(wm, 1, WM_RPT_BTN_ACC) / REPORTS);
+    printf("accel,    %5d wiimotes %6.1f ns/report\n", WIIMOTES, (double)decode(wm, WIIMOTES, WM_RPT_BTN_ACC) / REPORTS);
+
+    wiiuse_cleanup(wm, WIIMOTES);
+    return 0;
+}
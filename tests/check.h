@@ -0,0 +1,60 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Helpers shared by the test programs.
+ *
+ *	A test is a small program that includes this header, runs its
+ *	CHECK()s and returns check_result() from main().
+ */
+
+#ifndef CHECK_H_INCLUDED
+#define CHECK_H_INCLUDED
+
+#include <stdio.h> /* for printf */
+
+static int check_failures = 0;
+
+/* report a failed condition and keep going */
+#define CHECK(_COND)                                                         \
+    do                                                                       \
+    {                                                                        \
+        if (!(_COND))                                                        \
+        {                                                                    \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #_COND); \
+            ++check_failures;                                                \
+        }                                                                    \
+    } while (0)
+
+/* exit status of the test */
+static int check_result(void)
+{
+    if (check_failures)
+    {
+        printf("%d check(s) failed\n", check_failures);
+        return 1;
+    }
+    return 0;
+}
+
+#endif /* CHECK_H_INCLUDED */
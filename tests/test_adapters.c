@@ -0,0 +1,287 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Spreading the wiimotes over the bluetooth adapters.
+ *
+ *	The adapters that are up come from a stand-in for hci_for_each_dev(),
+ *	so the test decides which adapters exist.  A wiimote pinned with
+ *	wiiuse_set_adapter() to an adapter that is down must get another one
+ *	without losing its pin.
+ */
+
+#include "check.h"
+
+#include "events.h" /* for propagate_event */
+#include "io.h"     /* for wiiuse_assign_adapters, wiiuse_sort_adapters */
+#include "os.h"     /* for wiiuse_os_ticks_ns */
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+#include <bluetooth/hci_lib.h> /* for hci_for_each_dev */
+
+#define WIIMOTES 6
+
+static int up[WIIUSE_MAX_ADAPTERS];
+static int up_count;
+
+/**
+ *	@brief Stand-in for the BlueZ function, lists the adapters in \a up.
+ */
+int hci_for_each_dev(int flag, int (*func)(int dd, int dev_id, long arg), long arg)
+{
+    int i;
+
+    (void)flag;
+    for (i = 0; i < up_count; ++i)
+    {
+        if (func(-1, up[i], arg))
+        {
+            return up[i];
+        }
+    }
+    return -1;
+}
+
+static void set_up(const int *adapters, int count)
+{
+    int i;
+
+    for (i = 0; i < count; ++i)
+    {
+        up[i] = adapters[i];
+    }
+    up_count = count;
+}
+
+/**
+ *	@brief Make a wiimote connected through an adapter, or found and about to connect if \a adapter < 0.
+ */
+static void set_wiimote(struct wiimote_t *wm, int adapter)
+{
+    WIIMOTE_DISABLE_STATE(wm, WIIMOTE_STATE_CONNECTED);
+    WIIMOTE_ENABLE_STATE(wm, WIIMOTE_STATE_DEV_FOUND);
+    wm->adapter = WIIUSE_ADAPTER_DEFAULT;
+    if (adapter >= 0)
+    {
+        WIIMOTE_ENABLE_STATE(wm, WIIMOTE_STATE_CONNECTED);
+        wm->adapter = adapter;
+    }
+}
+
+static int count_on(struct wiimote_t **wm, int adapter)
+{
+    int i, n = 0;
+
+    for (i = 0; i < WIIMOTES; ++i)
+    {
+        n += (wm[i]->adapter == adapter);
+    }
+    return n;
+}
+
+static void test_sort(struct wiimote_t **wm)
+{
+    int adapters[3] = {0, 1, 2};
+    int i;
+
+    /* two wiimotes on hci0, none on hci1, one on hci2 */
+    for (i = 0; i < WIIMOTES; ++i)
+    {
+        set_wiimote(wm[i], -1);
+    }
+    set_wiimote(wm[0], 0);
+    set_wiimote(wm[1], 0);
+    set_wiimote(wm[2], 2);
+
+    wiiuse_sort_adapters(wm, WIIMOTES, adapters, 3);
+    CHECK(adapters[0] == 1 && adapters[1] == 2 && adapters[2] == 0);
+
+    /* a tie keeps the order */
+    set_wiimote(wm[1], 1);
+    adapters[0] = 0;
+    adapters[1] = 1;
+    adapters[2] = 2;
+    wiiuse_sort_adapters(wm, WIIMOTES, adapters, 3);
+    CHECK(adapters[0] == 0 && adapters[1] == 1 && adapters[2] == 2);
+}
+
+static void test_assign(struct wiimote_t **wm)
+{
+    const int three[3] = {0, 1, 2};
+    const int four[4]  = {0, 1, 2, 5};
+    int i;
+
+    set_up(three, 3);
+
+    /* six new wiimotes, two per adapter */
+    for (i = 0; i < WIIMOTES; ++i)
+    {
+        set_wiimote(wm[i], -1);
+    }
+    wiiuse_assign_adapters(wm, WIIMOTES);
+    CHECK(count_on(wm, 0) == 2 && count_on(wm, 1) == 2 && count_on(wm, 2) == 2);
+
+    /* the connected ones count, and stay where they are */
+    set_wiimote(wm[0], 0);
+    set_wiimote(wm[1], 0);
+    set_wiimote(wm[2], 0);
+    for (i = 3; i < WIIMOTES; ++i)
+    {
+        set_wiimote(wm[i], -1);
+    }
+    wiiuse_assign_adapters(wm, WIIMOTES);
+    CHECK(count_on(wm, 0) == 3 && count_on(wm, 1) == 2 && count_on(wm, 2) == 1);
+
+    /* a pinned wiimote goes to its adapter, the others fill up around it */
+    for (i = 0; i < WIIMOTES; ++i)
+    {
+        set_wiimote(wm[i], -1);
+    }
+    wiiuse_set_adapter(wm[5], 2);
+    wiiuse_set_adapter(wm[4], 2);
+    wiiuse_set_adapter(wm[3], 2);
+    wiiuse_assign_adapters(wm, WIIMOTES);
+    CHECK(wm[3]->adapter == 2 && wm[4]->adapter == 2 && wm[5]->adapter == 2);
+    CHECK(count_on(wm, 0) == 2 && count_on(wm, 1) == 1);
+    wiiuse_set_adapter(wm[4], WIIUSE_ADAPTER_DEFAULT);
+    wiiuse_set_adapter(wm[3], WIIUSE_ADAPTER_DEFAULT);
+
+    /* pinned to an adapter that is down: another one for now */
+    for (i = 0; i < WIIMOTES; ++i)
+    {
+        set_wiimote(wm[i], -1);
+    }
+    wiiuse_set_adapter(wm[5], 5);
+    wiiuse_assign_adapters(wm, WIIMOTES);
+    CHECK(wm[5]->adapter >= 0 && wm[5]->adapter <= 2);
+    CHECK(wm[5]->adapter_pin == 5);
+    CHECK(count_on(wm, 0) == 2 && count_on(wm, 1) == 2 && count_on(wm, 2) == 2);
+
+    /* ... and its own once the adapter is up again */
+    set_up(four, 4);
+    for (i = 0; i < WIIMOTES; ++i)
+    {
+        set_wiimote(wm[i], -1);
+    }
+    wiiuse_assign_adapters(wm, WIIMOTES);
+    CHECK(wm[5]->adapter == 5);
+    CHECK(count_on(wm, 0) == 2 && count_on(wm, 1) == 2 && count_on(wm, 2) == 1);
+
+    /* unpinned it goes to the least loaded adapter */
+    wiiuse_set_adapter(wm[5], WIIUSE_ADAPTER_DEFAULT);
+    CHECK(wm[5]->adapter_pin == WIIUSE_ADAPTER_DEFAULT);
+    for (i = 0; i < WIIMOTES - 1; ++i)
+    {
+        set_wiimote(wm[i], wm[i]->adapter);
+    }
+    set_wiimote(wm[5], -1);
+    set_up(three, 3);
+    wiiuse_assign_adapters(wm, WIIMOTES);
+    CHECK(wm[5]->adapter == 2);
+
+    /* with no adapter up the system picks */
+    set_up(four, 0);
+    for (i = 0; i < WIIMOTES; ++i)
+    {
+        set_wiimote(wm[i], -1);
+    }
+    wiiuse_assign_adapters(wm, WIIMOTES);
+    CHECK(count_on(wm, WIIUSE_ADAPTER_DEFAULT) == WIIMOTES);
+}
+
+/**
+ *	@brief Feed a wiimote \a count button reports, \a ms apart, the last one at \a last.
+ */
+static void feed(struct wiimote_t *wm, int count, int ms, uint64_t last)
+{
+    byte msg[2] = {0, 0};
+    int i;
+
+    for (i = count - 1; i >= 0; --i)
+    {
+        wm->report_ns = last - (uint64_t)i * ms * 1000000;
+        propagate_event(wm, WM_RPT_BTN, msg);
+    }
+}
+
+static void test_stats(struct wiimote_t **wm)
+{
+    const int three[3] = {0, 1, 2};
+    struct wiiuse_adapter_stats_t stats[WIIUSE_MAX_ADAPTERS];
+    uint64_t now = wiiuse_os_ticks_ns();
+    int i, n;
+
+    set_up(three, 3);
+    for (i = 0; i < WIIMOTES; ++i)
+    {
+        set_wiimote(wm[i], -1);
+    }
+
+    /* 100 and 50 reports per second on hci0, for longer than a rate window */
+    set_wiimote(wm[0], 0);
+    set_wiimote(wm[1], 0);
+    feed(wm[0], 250, 10, now);
+    feed(wm[1], 125, 20, now);
+    CHECK(wm[0]->report_rate == 100);
+    CHECK(wm[1]->report_rate == 50);
+
+    /* one on hci2 that went quiet two rate windows ago */
+    set_wiimote(wm[2], 2);
+    feed(wm[2], 250, 10, now - 3 * WIIMOTE_RATE_WINDOW_NS);
+    CHECK(wm[2]->report_rate == 100);
+
+    /* one through an adapter that is no longer up */
+    set_wiimote(wm[3], 7);
+    feed(wm[3], 250, 10, now);
+
+    n = wiiuse_adapter_stats(wm, WIIMOTES, stats, WIIUSE_MAX_ADAPTERS);
+    CHECK(n == 4);
+    CHECK(stats[0].adapter == 0 && stats[0].devices == 2 && stats[0].report_rate == 150);
+    CHECK(stats[1].adapter == 1 && stats[1].devices == 0 && stats[1].report_rate == 0);
+    CHECK(stats[2].adapter == 2 && stats[2].devices == 1 && stats[2].report_rate == 0);
+    CHECK(stats[3].adapter == 7 && stats[3].devices == 1 && stats[3].report_rate == 100);
+
+    /* no more entries than there is room for */
+    n = wiiuse_adapter_stats(wm, WIIMOTES, stats, 2);
+    CHECK(n == 2);
+    CHECK(stats[0].adapter == 0 && stats[1].adapter == 1);
+}
+
+int main(void)
+{
+    struct wiimote_t **wm = wiiuse_init(WIIMOTES);
+    int i;
+
+    test_sort(wm);
+    test_assign(wm);
+    test_stats(wm);
+
+    for (i = 0; i < WIIMOTES; ++i)
+    {
+        WIIMOTE_DISABLE_STATE(wm[i], WIIMOTE_STATE_CONNECTED);
+    }
+    wiiuse_cleanup(wm, WIIMOTES);
+
+    return check_result();
+}
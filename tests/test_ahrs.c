@@ -0,0 +1,147 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Gyro and accelerometer fusion.
+ *
+ *	Runs ahrs_update() for a minute of simulated motion at 100 Hz, with
+ *	a gyro bias of about 1 deg/s, sensor noise and some linear
+ *	acceleration.  With the accelerometer correction the roll and pitch
+ *	must stay close to the truth, without it they drift away.
+ */
+
+#include "check.h"
+
+#include "dynamics.h" /* for ahrs_update, quat_to_orient */
+
+#include <math.h>   /* for cos, fabs, log, remainder, sin, sqrt */
+#include <stdlib.h> /* for rand, srand */
+
+#define SECONDS 60
+#define RATE    100
+
+/* gaussian noise with a standard deviation of 1 */
+static double noise(void)
+{
+    double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+    double v = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+    return sqrt(-2.0 * log(u)) * cos(2.0 * WIIMOTE_PI * v);
+}
+
+/* integrate the true orientation over dt seconds at the rates w (rad/s) */
+static void rotate(double q[4], const double w[3], double dt)
+{
+    double d0 = 0.5 * (-q[1] * w[0] - q[2] * w[1] - q[3] * w[2]);
+    double d1 = 0.5 * (q[0] * w[0] + q[2] * w[2] - q[3] * w[1]);
+    double d2 = 0.5 * (q[0] * w[1] - q[1] * w[2] + q[3] * w[0]);
+    double d3 = 0.5 * (q[0] * w[2] + q[1] * w[1] - q[2] * w[0]);
+    double n;
+    int i;
+
+    q[0] += d0 * dt;
+    q[1] += d1 * dt;
+    q[2] += d2 * dt;
+    q[3] += d3 * dt;
+
+    n = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    for (i = 0; i < 4; ++i)
+    {
+        q[i] /= n;
+    }
+}
+
+/* rms roll/pitch error over the run, in degrees */
+static double run(float beta)
+{
+    const double bias[3] = {0.02, -0.015, 0.01};
+    double truth[4]      = {1.0, 0.0, 0.0, 0.0};
+    struct quat_t q      = {1.0f, 0.0f, 0.0f, 0.0f};
+    double err           = 0.0;
+    int n = 0, i, k;
+
+    srand(3);
+    for (i = 0; i < SECONDS * RATE; ++i)
+    {
+        double t = (double)i / RATE;
+        double w[3];
+        float gyro[3];
+        struct gforce_t accel;
+        struct quat_t tq;
+        struct orient_t o, to;
+
+        w[0] = 1.5 * sin(t * 1.3);
+        w[1] = 2.0 * sin(t * 0.7 + 1.0);
+        w[2] = 0.8 * sin(t * 0.4);
+        for (k = 0; k < 10; ++k)
+        {
+            rotate(truth, w, 0.1 / RATE);
+        }
+
+        for (k = 0; k < 3; ++k)
+        {
+            gyro[k] = (float)(w[k] + bias[k] + 0.01 * noise());
+        }
+        accel.x = (float)(2 * (truth[1] * truth[3] - truth[0] * truth[2]) + 0.02 * noise() + 0.05 * sin(t * 9.0));
+        accel.y = (float)(2 * (truth[0] * truth[1] + truth[2] * truth[3]) + 0.02 * noise());
+        accel.z = (float)(truth[0] * truth[0] - truth[1] * truth[1] - truth[2] * truth[2] + truth[3] * truth[3]
+                          + 0.02 * noise());
+
+        ahrs_update(&q, beta, gyro, &accel, 1.0f / RATE);
+
+        tq.w = (float)truth[0];
+        tq.x = (float)truth[1];
+        tq.y = (float)truth[2];
+        tq.z = (float)truth[3];
+        quat_to_orient(&q, &o);
+        quat_to_orient(&tq, &to);
+
+        /* roll is meaningless close to straight up or down */
+        if (fabs(to.pitch) < 80.0)
+        {
+            double e  = fabs(remainder(o.roll - to.roll, 360.0));
+            double e2 = fabs(o.pitch - to.pitch);
+
+            if (e2 > e)
+            {
+                e = e2;
+            }
+            err += e * e;
+            ++n;
+        }
+    }
+
+    return sqrt(err / n);
+}
+
+int main(void)
+{
+    double gyro_only = run(0.0f);
+    double fused     = run(0.1f);
+
+    printf("roll/pitch rms error: %.2f degrees gyro only, %.2f degrees fused\n", gyro_only, fused);
+    CHECK(fused < 3.0);
+    CHECK(fused < gyro_only / 4);
+
+    return check_result();
+}
@@ -0,0 +1,95 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Wiimotes allocated by wiiuse_init_arena() and wiiuse_init().
+ *
+ *	Each wiimote must start on its own cache line without overlapping
+ *	the next, and wiiuse_cleanup() must release the arena once.  Build
+ *	with -fsanitize=address to have the allocations checked as well.
+ */
+
+#include "check.h"
+
+#include "wiiuse_internal.h"
+
+#include <stdint.h> /* for uintptr_t */
+#include <stdlib.h> /* for malloc, free */
+#include <string.h> /* for memcpy, memset */
+
+#define WIIMOTES 8
+
+/**
+ *	@brief Write over every byte of each wiimote, then put it back.
+ */
+static void touch(struct wiimote_t **wm, int wiimotes)
+{
+    struct wiimote_t *copy = (struct wiimote_t *)malloc(sizeof(struct wiimote_t));
+    int i;
+
+    for (i = 0; i < wiimotes; ++i)
+    {
+        memcpy(copy, wm[i], sizeof(struct wiimote_t));
+        memset(wm[i], 0xa5, sizeof(struct wiimote_t));
+        memcpy(wm[i], copy, sizeof(struct wiimote_t));
+    }
+    free(copy);
+}
+
+int main(void)
+{
+    struct wiimote_t **wm;
+    int i;
+
+    wm = wiiuse_init_arena(WIIMOTES);
+    CHECK(wm != NULL);
+    for (i = 0; i < WIIMOTES; ++i)
+    {
+        CHECK(wm[i]->unid == i + 1);
+        CHECK((uintptr_t)wm[i] % WIIMOTE_CACHE_LINE == 0);
+        if (i)
+        {
+            /* in order, with room for the block pointer in front of each */
+            CHECK((byte *)wm[i] - (byte *)wm[i - 1] >= (long)(sizeof(struct wiimote_t) + sizeof(byte *)));
+        }
+    }
+    touch(wm, WIIMOTES);
+    wiiuse_cleanup(wm, WIIMOTES);
+
+    /* a single wiimote, and the one-by-one allocation */
+    wm = wiiuse_init_arena(1);
+    CHECK(wm != NULL && (uintptr_t)wm[0] % WIIMOTE_CACHE_LINE == 0);
+    touch(wm, 1);
+    wiiuse_cleanup(wm, 1);
+
+    wm = wiiuse_init(3);
+    CHECK(wm != NULL);
+    for (i = 0; i < 3; ++i)
+    {
+        CHECK((uintptr_t)wm[i] % WIIMOTE_CACHE_LINE == 0);
+    }
+    touch(wm, 3);
+    wiiuse_cleanup(wm, 3);
+
+    return check_result();
+}
@@ -0,0 +1,127 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Batch g-force and orientation kernels against the scalar path.
+ *
+ *	g-force must match calculate_gforce() bit for bit and orientation
+ *	must match calculate_orientation() to 7e-4 degrees, as documented for
+ *	the batch functions.  A fixed-point build gets the looser bounds
+ *	documented there.
+ */
+
+#include "check.h"
+
+#include "dynamics.h" /* for calculate_gforce, calculate_orientation */
+
+#include <math.h>   /* for fabs */
+#include <stdlib.h> /* for rand, srand */
+#include <string.h> /* for memcmp, memset */
+
+#define SAMPLES 100003
+#define CALIBS  3
+
+#ifdef WIIUSE_FIXED_POINT
+#define GFORCE_TOLERANCE (1.0 / 65536.0)
+#define ORIENT_TOLERANCE 0.05
+#else
+#define ORIENT_TOLERANCE 7e-4
+#endif
+
+static struct vec3b_t accel[SAMPLES];
+static int calib[SAMPLES];
+static struct gforce_t gforce[SAMPLES];
+static float roll[SAMPLES], pitch[SAMPLES];
+
+int main(void)
+{
+    struct accel_t ac[CALIBS];
+    double worst = 0.0;
+    int i;
+
+    memset(ac, 0, sizeof(ac));
+    for (i = 0; i < CALIBS; ++i)
+    {
+        ac[i].cal_zero.x = 128 + i;
+        ac[i].cal_zero.y = 127;
+        ac[i].cal_zero.z = 130 - i;
+        ac[i].cal_g.x    = 25 + i;
+        ac[i].cal_g.y    = 26;
+        ac[i].cal_g.z    = 24;
+    }
+
+    srand(1);
+    for (i = 0; i < SAMPLES; ++i)
+    {
+        accel[i].x = rand() & 0xff;
+        accel[i].y = rand() & 0xff;
+        accel[i].z = rand() & 0xff;
+        calib[i]   = i % CALIBS;
+        roll[i]    = -999.0f;
+        pitch[i]   = -999.0f;
+    }
+
+    /* an odd count so the scalar tail is covered too */
+    wiiuse_calculate_gforce_batch(ac, calib, accel, gforce, SAMPLES);
+    wiiuse_calculate_orientation_batch(ac, calib, accel, roll, pitch, SAMPLES);
+
+    for (i = 0; i < SAMPLES; ++i)
+    {
+        struct gforce_t g;
+        struct orient_t o;
+        double err;
+
+        calculate_gforce(&ac[calib[i]], &accel[i], &g);
+#ifdef GFORCE_TOLERANCE
+        CHECK(fabs(g.x - gforce[i].x) < GFORCE_TOLERANCE && fabs(g.y - gforce[i].y) < GFORCE_TOLERANCE
+              && fabs(g.z - gforce[i].z) < GFORCE_TOLERANCE);
+#else
+        CHECK(!memcmp(&g, &gforce[i], sizeof(g)));
+#endif
+
+        memset(&o, 0, sizeof(o));
+        o.roll  = -999.0f;
+        o.pitch = -999.0f;
+        calculate_orientation(&ac[calib[i]], &accel[i], &o, 0, 0);
+
+        /* -180 and 180 are the same roll */
+        err = fabs(o.roll - roll[i]);
+        if (err > 180.0)
+        {
+            err = 360.0 - err;
+        }
+        if (fabs(o.pitch - pitch[i]) > err)
+        {
+            err = fabs(o.pitch - pitch[i]);
+        }
+        if (err > worst)
+        {
+            worst = err;
+        }
+    }
+
+    printf("largest orientation difference %g degrees\n", worst);
+    CHECK(worst <= ORIENT_TOLERANCE);
+
+    return check_result();
+}
@@ -0,0 +1,68 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Accelerometer math without a calibration.
+ *
+ *	The Motion+ pass-through nunchuk never reads its calibration, so its
+ *	cal_g stays 0.  That must not crash, and the fixed-point build must
+ *	give 0 instead of dividing by zero.
+ */
+
+#include "check.h"
+
+#include "dynamics.h" /* for calculate_gforce, calculate_orientation */
+
+#include <string.h> /* for memset */
+
+int main(void)
+{
+    struct accel_t ac;
+    struct vec3b_t accel;
+    struct orient_t orient;
+    struct gforce_t gforce;
+
+    memset(&ac, 0, sizeof(ac));
+    memset(&orient, 0, sizeof(orient));
+    accel.x = 140;
+    accel.y = 100;
+    accel.z = 128;
+
+    calculate_gforce(&ac, &accel, &gforce);
+    calculate_orientation(&ac, &accel, &orient, 1, 10000000);
+    calculate_orientation(&ac, &accel, &orient, 1, 20000000);
+
+#ifdef WIIUSE_FIXED_POINT
+    CHECK(gforce.x == 0.0f && gforce.y == 0.0f && gforce.z == 0.0f);
+    CHECK(orient.roll == 0.0f && orient.pitch == 0.0f);
+#endif
+
+    /* a calibrated accelerometer still works after that */
+    ac.cal_zero.x = ac.cal_zero.y = ac.cal_zero.z = 128;
+    ac.cal_g.x = ac.cal_g.y = ac.cal_g.z = 26;
+    accel.x = 154;
+    calculate_gforce(&ac, &accel, &gforce);
+    CHECK(gforce.x > 0.99f && gforce.x < 1.01f);
+
+    return check_result();
+}
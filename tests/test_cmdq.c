@@ -0,0 +1,306 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Command queue pushed from several threads.
+ *
+ *	Commands must come out of wiiuse_poll() exactly once, in the order
+ *	each thread pushed them, also after the sequence numbers of the
+ *	ring went around many times.  A full ring refuses commands instead
+ *	of blocking.
+ */
+
+#include "check.h"
+
+#include "cmdq.h"     /* for cmdq_apply */
+#include "os.h"       /* for wiiuse_os_ticks */
+#include "outqueue.h" /* for outqueue_flush */
+
+#include <limits.h>     /* for LONG_MAX */
+#include <pthread.h>    /* for pthread_create, pthread_join */
+#include <sched.h>      /* for sched_yield */
+#include <sys/socket.h> /* for socketpair, recv */
+#include <unistd.h>     /* for close */
+
+/* the thread is in bits 16-23 of the write address, the command number below */
+#define PRODUCERS    4
+#define PER_PRODUCER 20000
+
+/* give up on the threaded test after this long (ms) */
+#define STRESS_TIMEOUT 60000
+
+struct producer_t
+{
+    struct wiimote_t *wm;
+    unsigned int id;
+    unsigned long full; /**< pushes refused because the ring was full */
+};
+
+/**
+ *	@brief Receive the next report the wiimote was sent.
+ *
+ *	@return Its length, 0 if there is none.
+ */
+static int next_report(int sock, byte *buf)
+{
+    int n = (int)recv(sock, buf, 32, MSG_DONTWAIT);
+
+    return (n > 2) ? n : 0;
+}
+
+/**
+ *	@brief Address of a memory write report, -1 for any other report.
+ *
+ *	Bit 0 of the first byte is the rumble bit every report carries.
+ */
+static long write_addr(const byte *buf, int n)
+{
+    if (n < 7 || buf[1] != WM_CMD_WRITE_DATA)
+    {
+        return -1;
+    }
+    return (long)(((unsigned long)(buf[2] & 0xFE) << 24) | (buf[3] << 16) | (buf[4] << 8) | buf[5]);
+}
+
+/**
+ *	@brief Apply the queued commands and check they wrote \a count addresses from \a *next up.
+ */
+static void apply_writes(struct wiimote_t *wm, int sock, long *next, int count)
+{
+    byte buf[32];
+    int n, got = 0;
+
+    cmdq_apply(wm);
+    outqueue_flush(wm);
+
+    while ((n = next_report(sock, buf)) > 0)
+    {
+        CHECK(write_addr(buf, n) == *next);
+        *next = (*next + 1) & 0xffffff;
+        ++got;
+    }
+    CHECK(got == count);
+}
+
+static void test_round_trip(struct wiimote_t *wm, int sock)
+{
+    byte data[2] = {0x12, 0x34};
+    byte buf[32];
+    int n;
+
+    CHECK(wiiuse_submit_leds(wm, WIIMOTE_LED_2));
+    CHECK(wiiuse_submit_motion_sensing(wm, 1));
+    CHECK(wiiuse_submit_rumble(wm, 1));
+    CHECK(wiiuse_submit_write(wm, 0x04b00030, data, sizeof(data)));
+
+    /* nothing is applied before the poll */
+    CHECK(!(wm->leds & WIIMOTE_LED_2));
+    CHECK(!WIIUSE_USING_ACC(wm));
+    CHECK(next_report(sock, buf) == 0);
+
+    cmdq_apply(wm);
+    outqueue_flush(wm);
+
+    CHECK((wm->leds & 0xF0) == WIIMOTE_LED_2);
+    CHECK(WIIUSE_USING_ACC(wm));
+    CHECK(WIIMOTE_IS_SET(wm, WIIMOTE_STATE_RUMBLE));
+
+    /* the reports went out in the order of the commands */
+    n = next_report(sock, buf);
+    CHECK(n && buf[1] == WM_CMD_LED && (buf[2] & 0xF0) == WIIMOTE_LED_2);
+    n = next_report(sock, buf);
+    CHECK(n >= 4 && buf[1] == WM_CMD_REPORT_TYPE && buf[3] == WM_RPT_BTN_ACC);
+    n = next_report(sock, buf);
+    CHECK(n && buf[1] == WM_CMD_RUMBLE && (buf[2] & 0x01));
+    n = next_report(sock, buf);
+    CHECK(write_addr(buf, n) == 0x04b00030 && buf[6] == sizeof(data) && buf[7] == 0x12 && buf[8] == 0x34);
+    CHECK(next_report(sock, buf) == 0);
+
+    /* and the report mode can be switched back */
+    CHECK(wiiuse_submit_motion_sensing(wm, 0));
+    CHECK(wiiuse_submit_rumble(wm, 0));
+    cmdq_apply(wm);
+    outqueue_flush(wm);
+    CHECK(!WIIUSE_USING_ACC(wm));
+    CHECK(!WIIMOTE_IS_SET(wm, WIIMOTE_STATE_RUMBLE));
+    n = next_report(sock, buf);
+    CHECK(n >= 4 && buf[1] == WM_CMD_REPORT_TYPE && buf[3] == WM_RPT_BTN && (buf[2] & 0x01));
+    n = next_report(sock, buf);
+    CHECK(n && buf[1] == WM_CMD_RUMBLE && !(buf[2] & 0x01));
+    CHECK(next_report(sock, buf) == 0);
+}
+
+static void test_full_empty(struct wiimote_t *wm, int sock)
+{
+    byte data = 0;
+    byte buf[32];
+    long next = 0;
+    int i;
+
+    /* an empty queue applies nothing */
+    cmdq_apply(wm);
+    outqueue_flush(wm);
+    CHECK(next_report(sock, buf) == 0);
+
+    for (i = 0; i < WIIUSE_CMDQ_LEN; ++i)
+    {
+        CHECK(wiiuse_submit_write(wm, (unsigned int)i, &data, 1));
+    }
+    CHECK(!wiiuse_submit_write(wm, WIIUSE_CMDQ_LEN, &data, 1));
+    CHECK(!wiiuse_submit_leds(wm, WIIMOTE_LED_1));
+
+    apply_writes(wm, sock, &next, WIIUSE_CMDQ_LEN);
+
+    /* room again once applied */
+    CHECK(wiiuse_submit_write(wm, WIIUSE_CMDQ_LEN, &data, 1));
+    apply_writes(wm, sock, &next, 1);
+}
+
+static void test_wraparound(struct wiimote_t *wm, int sock)
+{
+    struct cmdq_t *q = &wm->cmdq;
+    unsigned long base = (unsigned long)LONG_MAX - WIIUSE_CMDQ_LEN / 2;
+    byte data = 0;
+    long next = 0, addr = 0;
+    int i, round;
+
+    /* start half a ring before the sequence numbers overflow */
+    q->head = q->tail = (long)base;
+    for (i = 0; i < WIIUSE_CMDQ_LEN; ++i)
+    {
+        q->cell[(base + i) & (WIIUSE_CMDQ_LEN - 1)].seq = (long)(base + i);
+    }
+
+    /* one less than the ring per round, so the slots shift every turn */
+    for (round = 0; round < 8; ++round)
+    {
+        for (i = 0; i < WIIUSE_CMDQ_LEN - 1; ++i)
+        {
+            CHECK(wiiuse_submit_write(wm, (unsigned int)addr++, &data, 1));
+        }
+        apply_writes(wm, sock, &next, WIIUSE_CMDQ_LEN - 1);
+    }
+    CHECK((unsigned long)q->head == base + 8 * (WIIUSE_CMDQ_LEN - 1));
+    CHECK(q->head == q->tail);
+}
+
+static void *produce(void *arg)
+{
+    struct producer_t *p = (struct producer_t *)arg;
+    byte data = (byte)p->id;
+    unsigned int i;
+
+    for (i = 0; i < PER_PRODUCER; ++i)
+    {
+        while (!wiiuse_submit_write(p->wm, (p->id << 16) | i, &data, 1))
+        {
+            p->full++;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void test_threads(struct wiimote_t *wm, int sock)
+{
+    struct producer_t producer[PRODUCERS];
+    pthread_t thread[PRODUCERS];
+    unsigned long next[PRODUCERS] = {0};
+    unsigned long start = wiiuse_os_ticks();
+    unsigned long got = 0, wrong = 0, full = 0;
+    byte buf[32];
+    int i, n;
+
+    for (i = 0; i < PRODUCERS; ++i)
+    {
+        producer[i].wm   = wm;
+        producer[i].id   = (unsigned int)i;
+        producer[i].full = 0;
+        CHECK(pthread_create(&thread[i], NULL, produce, &producer[i]) == 0);
+    }
+
+    while (got < PRODUCERS * PER_PRODUCER && wiiuse_os_ticks() - start < STRESS_TIMEOUT)
+    {
+        cmdq_apply(wm);
+
+        while ((n = next_report(sock, buf)) > 0)
+        {
+            long addr = write_addr(buf, n);
+            unsigned long p = (unsigned long)addr >> 16;
+
+            /* every thread's commands arrive once and in its order */
+            if (addr < 0 || p >= PRODUCERS || (unsigned long)(addr & 0xffff) != next[p] || buf[7] != p)
+            {
+                ++wrong;
+            } else
+            {
+                ++next[p];
+            }
+            ++got;
+        }
+        sched_yield();
+    }
+
+    for (i = 0; i < PRODUCERS; ++i)
+    {
+        pthread_join(thread[i], NULL);
+        full += producer[i].full;
+        CHECK(next[i] == PER_PRODUCER);
+    }
+
+    /* nothing left over */
+    cmdq_apply(wm);
+    outqueue_flush(wm);
+    CHECK(next_report(sock, buf) == 0);
+
+    printf("%lu commands from %d threads, %lu wrong, ring full %lu times\n", got, PRODUCERS, wrong, full);
+    CHECK(got == PRODUCERS * PER_PRODUCER);
+    CHECK(wrong == 0);
+}
+
+int main(void)
+{
+    struct wiimote_t **wiimotes = wiiuse_init(1);
+    struct wiimote_t *wm        = wiimotes[0];
+    int sv[2];
+
+    CHECK(socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) == 0);
+    wm->in_sock = sv[0];
+    WIIMOTE_ENABLE_STATE(wm, WIIMOTE_STATE_CONNECTED);
+
+    /* no rate limit, every command goes out as it is applied */
+    wiiuse_set_output_rate(wm, 0, 1);
+
+    test_round_trip(wm, sv[1]);
+    test_full_empty(wm, sv[1]);
+    test_wraparound(wm, sv[1]);
+    test_threads(wm, sv[1]);
+
+    WIIMOTE_DISABLE_STATE(wm, WIIMOTE_STATE_CONNECTED);
+    wm->in_sock = -1;
+    close(sv[0]);
+    close(sv[1]);
+    wiiuse_cleanup(wiimotes, 1);
+
+    return check_result();
+}
@@ -0,0 +1,103 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Motion+ gyro bias tracking.
+ *
+ *	Feeds an hour of gyro frames through motion_plus_event(), alternating
+ *	20 s of motion and 20 s held still, while the zero-rate output drifts
+ *	with temperature.  The calibration must follow the drift.
+ */
+
+#include "check.h"
+
+#include "motion_plus.h" /* for motion_plus_event */
+
+#include <math.h>   /* for cos, fabs, log, sin, sqrt */
+#include <stdlib.h> /* for abs, rand, srand */
+#include <string.h> /* for memset */
+
+#define SECONDS 3600
+#define RATE    100
+
+/* raw counts, about 7 deg/s in slow mode */
+#define DRIFT 150.0
+
+/* gaussian noise with a standard deviation of 1 */
+static double noise(void)
+{
+    double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+    double v = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+    return sqrt(-2.0 * log(u)) * cos(2.0 * WIIMOTE_PI * v);
+}
+
+/* encode a gyro frame, all axes in slow mode when still */
+static void put_frame(byte *msg, int roll, int pitch, int yaw, int still)
+{
+    msg[0] = yaw & 0xff;
+    msg[1] = roll & 0xff;
+    msg[2] = pitch & 0xff;
+    msg[3] = ((yaw >> 8) << 2) | (still ? 0x03 : 0x00);
+    msg[4] = ((roll >> 8) << 2) | (still ? 0x02 : 0x00);
+    msg[5] = ((pitch >> 8) << 2) | 0x02;
+}
+
+static struct motion_plus_t mp;
+
+int main(void)
+{
+    byte msg[6];
+    double err = 0.0;
+    int i;
+
+    memset(&mp, 0, sizeof(mp));
+
+    srand(5);
+    for (i = 0; i < SECONDS * RATE; ++i)
+    {
+        double t    = (double)i / RATE;
+        int moving  = ((int)(t / 20.0)) % 2 == 0;
+        double rate = moving ? 400.0 * sin(t * 3.0) : 0.0;
+        double zero = 8000.0 + DRIFT * sin(t / 1200.0);
+        struct gforce_t accel;
+
+        accel.x = moving ? 0.3f * (float)sin(t * 3.0) : 0.0f;
+        accel.y = 0.0f;
+        accel.z = moving ? 0.95f : 1.0f;
+
+        put_frame(msg, (int)(zero + rate + 2.0 * noise()), (int)(zero - rate + 2.0 * noise()),
+                  (int)(zero + 0.5 * rate + 2.0 * noise()), !moving);
+        motion_plus_event(&mp, EXP_MOTION_PLUS, msg, &accel, (uint64_t)i * 1000000000 / RATE);
+
+        err += fabs(mp.cal_gyro.roll - zero);
+    }
+    err /= SECONDS * RATE;
+
+    /* without tracking the error is the mean of |DRIFT * sin|, 2 / pi of it */
+    printf("mean calibration error %.2f counts, %.2f without tracking\n", err, DRIFT * 2.0 / WIIMOTE_PI);
+    CHECK(err < DRIFT * 2.0 / WIIMOTE_PI / 10.0);
+    CHECK(abs(mp.cal_gyro.pitch - mp.cal_gyro.roll) < 5 && abs(mp.cal_gyro.yaw - mp.cal_gyro.roll) < 5);
+
+    return check_result();
+}
@@ -0,0 +1,106 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief IR dot tracking at the edge of the screen with the roll corrected.
+ *
+ *	Rotating dots near a corner of the sensor puts them at negative
+ *	coordinates.  The tracks must follow them there with a sane velocity
+ *	and keep their ids.
+ */
+
+#include "check.h"
+
+#include "ir.h" /* for calculate_extended_ir */
+
+#include <math.h>   /* for cos, sin, fabs */
+#include <stdint.h> /* for int32_t */
+#include <string.h> /* for memset */
+
+#define ROLL -30.0
+
+/* store a dot in an extended IR report */
+static void put_dot(byte *data, int slot, int x, int y)
+{
+    data[slot * 3]     = x & 0xff;
+    data[slot * 3 + 1] = y & 0xff;
+    data[slot * 3 + 2] = ((y >> 8) << 6) | ((x >> 8) << 4) | 3;
+}
+
+static struct wiimote_t wm;
+
+int main(void)
+{
+    double c = cos(ROLL * WIIMOTE_PI / 180.0);
+    double s = sin(ROLL * WIIMOTE_PI / 180.0);
+    byte data[12];
+    int id[2] = {0, 0};
+    int f, i;
+
+    memset(&wm, 0, sizeof(wm));
+    wm.state       = WIIMOTE_STATE_ACC | WIIMOTE_STATE_IR;
+    wm.ir.vres[0]  = 1024;
+    wm.ir.vres[1]  = 768;
+    wm.ir.pos      = WIIUSE_IR_ABOVE;
+    wm.ir.aspect   = WIIUSE_ASPECT_4_3;
+    wm.orient.roll = (float)ROLL;
+
+    /* two dots in the top corner of the sensor, moving one pixel a report */
+    for (f = 0; f < 40; ++f)
+    {
+        memset(data, 0xff, sizeof(data));
+        put_dot(data, 0, 4 + f, 6);
+        put_dot(data, 1, 4 + f, 60);
+        calculate_extended_ir(&wm, data);
+
+        for (i = 0; i < 2; ++i)
+        {
+            const struct ir_dot_t *d = &wm.ir.dot[i];
+
+            CHECK(d->visible);
+            if (!f)
+            {
+                id[i] = d->id;
+                continue;
+            }
+            CHECK(d->id == id[i]);
+        }
+    }
+
+    /* both ended up above the screen */
+    CHECK((int32_t)wm.ir.dot[0].y < 0 && (int32_t)wm.ir.dot[1].y < 0);
+
+    /* the sensor mirrors x, so a report moves the dots by (-cos, -sin) */
+    for (i = 0; i < 2; ++i)
+    {
+        const struct ir_dot_t *d = &wm.ir.dot[i];
+
+        CHECK(fabs(d->vx + c) < 0.4 && fabs(d->vy + s) < 0.4);
+    }
+    for (i = 0; i < 4; ++i)
+    {
+        CHECK(!wm.ir.track[i].id || (fabs(wm.ir.track[i].x) < 1024.0f && fabs(wm.ir.track[i].y) < 1024.0f));
+    }
+
+    return check_result();
+}
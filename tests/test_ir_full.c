@@ -0,0 +1,169 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Reassembly of the full IR report pairs (0x3E and 0x3F).
+ *
+ *	Each half carries two of the four dots, half of the accelerometer
+ *	and the buttons, with the Z axis split over the spare button bits of
+ *	both.  A pair must give all four dots and the whole acceleration; a
+ *	half without its partner must change nothing.
+ */
+
+#include "check.h"
+
+#include "events.h" /* for propagate_event */
+#include "wiiuse_internal.h"
+
+#include <string.h> /* for memset */
+
+/* bytes after the report id */
+#define HALF_LEN 21
+
+/* store a dot in the IR data of a full IR report */
+static void put_full_dot(byte *data, int slot, int x, int y, int size, int intensity)
+{
+    byte *d = data + slot * 9;
+
+    d[0] = x & 0xff;
+    d[1] = y & 0xff;
+    d[2] = ((y >> 8) << 6) | ((x >> 8) << 4) | size;
+    d[3] = 10; /* bounding box */
+    d[4] = 20;
+    d[5] = 30;
+    d[6] = 40;
+    d[7] = 0;
+    d[8] = intensity;
+}
+
+/**
+ *	@brief Build the two halves of a full IR frame.
+ *
+ *	@param first	[out] The 0x3E report, without its id.
+ *	@param second	[out] The 0x3F report, without its id.
+ *	@param accel	Raw acceleration, X goes in the first half, Y in the second.
+ *	@param base		Raw X of the first dot, the others are to its right.
+ */
+static void build_pair(byte *first, byte *second, const struct vec3b_t *accel, int base)
+{
+    int i;
+
+    memset(first, 0, HALF_LEN);
+    memset(second, 0, HALF_LEN);
+
+    /* A held in both halves */
+    first[1]  = WIIMOTE_BUTTON_A;
+    second[1] = WIIMOTE_BUTTON_A;
+
+    /* Z bits 4-7 in the first half, 0-3 in the second */
+    first[0] |= ((accel->z >> 4) & 3) << 5;
+    first[1] |= ((accel->z >> 6) & 3) << 5;
+    second[0] |= (accel->z & 3) << 5;
+    second[1] |= ((accel->z >> 2) & 3) << 5;
+
+    first[2]  = accel->x;
+    second[2] = accel->y;
+
+    for (i = 0; i < 2; ++i)
+    {
+        put_full_dot(first + 3, i, base + 100 * i, 300 + 50 * i, 2 + i, 0x40 + i);
+        put_full_dot(second + 3, i, base + 100 * (i + 2), 300 + 50 * (i + 2), 4 + i, 0x42 + i);
+    }
+}
+
+/* check the dots and acceleration of a pair built with build_pair() */
+static void check_pair(const struct wiimote_t *wm, const struct vec3b_t *accel, int base)
+{
+    int i;
+
+    CHECK(wm->accel.x == accel->x && wm->accel.y == accel->y && wm->accel.z == accel->z);
+    CHECK(wm->btns == WIIMOTE_BUTTON_A);
+    CHECK(wm->ir.num_dots == 4);
+
+    for (i = 0; i < 4; ++i)
+    {
+        const struct ir_dot_t *dot = &wm->ir.dot[i];
+
+        CHECK(dot->visible);
+        CHECK(dot->rx == 1023 - (base + 100 * i) && dot->ry == 300 + 50 * i);
+        CHECK(dot->size == 2 + i && dot->intensity == 0x40 + i);
+        CHECK(dot->bb_xmin == 127 - 30 && dot->bb_ymin == 20 && dot->bb_xmax == 127 - 10 && dot->bb_ymax == 40);
+    }
+}
+
+/* feed a report and tell if it raised an event */
+static int feed(struct wiimote_t *wm, byte type, byte *msg)
+{
+    wm->event = WIIUSE_NONE;
+    propagate_event(wm, type, msg);
+    return wm->event == WIIUSE_EVENT;
+}
+
+int main(void)
+{
+    struct wiimote_t **wiimotes = wiiuse_init(1);
+    struct wiimote_t *wm        = wiimotes[0];
+    struct vec3b_t a = {0x91, 0x6c, 0xb5};
+    struct vec3b_t b = {0x72, 0x88, 0x4e};
+    struct vec3b_t c = {0x80, 0x80, 0x9a};
+    byte first[HALF_LEN], second[HALF_LEN];
+    byte first_b[HALF_LEN], second_b[HALF_LEN];
+    byte first_c[HALF_LEN], second_c[HALF_LEN];
+
+    WIIMOTE_ENABLE_STATE(wm, WIIMOTE_STATE_ACC | WIIMOTE_STATE_IR);
+    wm->accel_calib.cal_zero.x = wm->accel_calib.cal_zero.y = wm->accel_calib.cal_zero.z = 0x80;
+    wm->accel_calib.cal_g.x = wm->accel_calib.cal_g.y = wm->accel_calib.cal_g.z = 0x1a;
+
+    build_pair(first, second, &a, 100);
+    build_pair(first_b, second_b, &b, 140);
+    build_pair(first_c, second_c, &c, 180);
+
+    /* a pair in order */
+    CHECK(!feed(wm, WM_RPT_BTN_ACC_IR_1, first));
+    CHECK(wm->ir.num_dots == 0 && wm->accel.x == 0);
+    CHECK(feed(wm, WM_RPT_BTN_ACC_IR_2, second));
+    check_pair(wm, &a, 100);
+
+    /* the second half first: it is dropped, then the pair comes in order */
+    CHECK(!feed(wm, WM_RPT_BTN_ACC_IR_2, second_b));
+    check_pair(wm, &a, 100);
+    CHECK(!feed(wm, WM_RPT_BTN_ACC_IR_1, first_b));
+    check_pair(wm, &a, 100);
+    CHECK(feed(wm, WM_RPT_BTN_ACC_IR_2, second_b));
+    check_pair(wm, &b, 140);
+
+    /* a lone first half is replaced by the next one */
+    CHECK(!feed(wm, WM_RPT_BTN_ACC_IR_1, first));
+    CHECK(!feed(wm, WM_RPT_BTN_ACC_IR_1, first_c));
+    check_pair(wm, &b, 140);
+    CHECK(feed(wm, WM_RPT_BTN_ACC_IR_2, second_c));
+    check_pair(wm, &c, 180);
+
+    /* a second half is only used once */
+    CHECK(!feed(wm, WM_RPT_BTN_ACC_IR_2, second));
+    check_pair(wm, &c, 180);
+
+    wiiuse_cleanup(wiimotes, 1);
+
+    return check_result();
+}
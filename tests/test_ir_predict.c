@@ -0,0 +1,110 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief IR cursor prediction.
+ *
+ *	Moves one dot like a hand would, with sensor noise, at 100 reports
+ *	per second.  The cursor predicted some milliseconds ahead must be
+ *	closer to the cursor reported at that time than the last reported
+ *	cursor is.
+ */
+
+#include "check.h"
+
+#include "ir.h" /* for calculate_extended_ir */
+
+#include <math.h>   /* for sin, sqrt */
+#include <stdlib.h> /* for rand, srand */
+#include <string.h> /* for memset */
+
+#define REPORTS     3000
+#define REPORT_MS   10
+#define WARMUP      50
+#define MAX_AHEAD   3
+
+/* store a dot in an extended IR report */
+static void put_dot(byte *data, int slot, int x, int y)
+{
+    data[slot * 3]     = x & 0xff;
+    data[slot * 3 + 1] = y & 0xff;
+    data[slot * 3 + 2] = ((y >> 8) << 6) | ((x >> 8) << 4) | 3;
+}
+
+static struct wiimote_t wm;
+static int cursor[REPORTS];
+static int predicted[REPORTS][MAX_AHEAD + 1];
+
+int main(void)
+{
+    byte data[12];
+    int i, k;
+
+    memset(&wm, 0, sizeof(wm));
+    wm.state      = WIIMOTE_STATE_IR;
+    wm.flags      = WIIUSE_IR_PREDICT;
+    wm.ir.vres[0] = 1024;
+    wm.ir.vres[1] = 768;
+    wm.ir.pos     = WIIUSE_IR_ABOVE;
+    wm.ir.aspect  = WIIUSE_ASPECT_4_3;
+
+    srand(1);
+    for (i = 0; i < REPORTS; ++i)
+    {
+        double t = i * REPORT_MS / 1000.0;
+        int x    = (int)(512 + 250 * sin(t * 2 * WIIMOTE_PI * 0.7) + 60 * sin(t * 2 * WIIMOTE_PI * 2.1 + 1));
+        int y;
+
+        memset(data, 0xff, sizeof(data));
+        put_dot(data, 0, x + rand() % 5 - 2, 384);
+        wm.report_ns    = (uint64_t)i * REPORT_MS * 1000000;
+        wm.report_ticks = (unsigned long)(i * REPORT_MS);
+        calculate_extended_ir(&wm, data);
+
+        cursor[i] = wm.ir.x;
+        for (k = 1; k <= MAX_AHEAD; ++k)
+        {
+            wiiuse_ir_predict(&wm, wm.report_ticks + k * REPORT_MS, &predicted[i][k], &y);
+        }
+    }
+
+    for (k = 1; k <= MAX_AHEAD; ++k)
+    {
+        double raw = 0.0, pred = 0.0;
+        int n = 0;
+
+        for (i = WARMUP; i + k < REPORTS; ++i)
+        {
+            raw += (double)(cursor[i] - cursor[i + k]) * (cursor[i] - cursor[i + k]);
+            pred += (double)(predicted[i][k] - cursor[i + k]) * (predicted[i][k] - cursor[i + k]);
+            ++n;
+        }
+        raw  = sqrt(raw / n);
+        pred = sqrt(pred / n);
+
+        printf("%2d ms ahead: rms error %.2f pixels without prediction, %.2f with\n", k * REPORT_MS, raw, pred);
+        CHECK(pred < raw / 2);
+    }
+
+    return check_result();
+}
@@ -0,0 +1,140 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Roll correction of the IR dots with the cached sin/cos.
+ *
+ *	Sweeps the roll in steps smaller and larger than IR_ROT_EPSILON and
+ *	checks the rotated dots against a rotation computed from scratch.
+ */
+
+#include "check.h"
+
+#include "ir.h" /* for calculate_extended_ir */
+
+#include <math.h>   /* for cos, sin, fabs */
+#include <string.h> /* for memset */
+
+/*
+ *	Pixels: truncation to whole pixels, plus the roll error allowed by
+ *	the cache at the corner of the sensor, 640 pixels from the center.
+ *	The fixed-point sin/cos table is coarser.
+ */
+#ifdef WIIUSE_FIXED_POINT
+#define ROTATION_TOLERANCE 1.5
+#else
+#define ROTATION_TOLERANCE (1.0 + 640.0 * IR_ROT_EPSILON * WIIMOTE_PI / 180.0)
+#endif
+
+/* store a dot in an extended IR report */
+static void put_dot(byte *data, int slot, int x, int y)
+{
+    data[slot * 3]     = x & 0xff;
+    data[slot * 3 + 1] = y & 0xff;
+    data[slot * 3 + 2] = ((y >> 8) << 6) | ((x >> 8) << 4) | 3;
+}
+
+/* largest distance of a dot from where an exact rotation puts it */
+static double rotation_error(const struct ir_dot_t *dot, float roll)
+{
+    double c     = cos(roll * WIIMOTE_PI / 180.0);
+    double s     = sin(roll * WIIMOTE_PI / 180.0);
+    double worst = 0.0;
+    int i;
+
+    for (i = 0; i < 4; ++i)
+    {
+        double x, y, ex, ey;
+
+        if (!dot[i].visible)
+        {
+            continue;
+        }
+        x  = dot[i].rx - 512.0;
+        y  = dot[i].ry - 384.0;
+        ex = fabs(c * x - s * y + 512.0 - (int)dot[i].x);
+        ey = fabs(s * x + c * y + 384.0 - (int)dot[i].y);
+        if (ex > worst)
+        {
+            worst = ex;
+        }
+        if (ey > worst)
+        {
+            worst = ey;
+        }
+    }
+
+    return worst;
+}
+
+static struct wiimote_t wm;
+
+int main(void)
+{
+    byte data[12];
+    double worst = 0.0;
+    float roll;
+    int i;
+
+    memset(&wm, 0, sizeof(wm));
+    wm.state      = WIIMOTE_STATE_ACC | WIIMOTE_STATE_IR;
+    wm.ir.vres[0] = 1024;
+    wm.ir.vres[1] = 768;
+    wm.ir.pos     = WIIUSE_IR_ABOVE;
+
+    memset(data, 0xff, sizeof(data));
+
+    /* slow drift: most reports reuse the cached sin/cos */
+    for (i = 0, roll = -170.0f; roll < 170.0f; ++i, roll += 0.003f)
+    {
+        put_dot(data, 0, 100 + (i & 7), 200);
+        put_dot(data, 1, 900, 600 - (i & 3));
+        wm.orient.roll = roll;
+        calculate_extended_ir(&wm, data);
+
+        if (rotation_error(wm.ir.dot, roll) > worst)
+        {
+            worst = rotation_error(wm.ir.dot, roll);
+        }
+    }
+
+    /* jumps: every report recomputes them */
+    for (i = 0; i < 1000; ++i)
+    {
+        roll = (float)((i * 37) % 359 - 179);
+        put_dot(data, 0, 20 + i % 980, 10 + i % 750);
+        put_dot(data, 1, 1000 - i % 980, 760 - i % 750);
+        wm.orient.roll = roll;
+        calculate_extended_ir(&wm, data);
+
+        if (rotation_error(wm.ir.dot, roll) > worst)
+        {
+            worst = rotation_error(wm.ir.dot, roll);
+        }
+    }
+
+    printf("largest rotation error %.3f pixels\n", worst);
+    CHECK(worst <= ROTATION_TOLERANCE);
+
+    return check_result();
+}
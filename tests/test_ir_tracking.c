@@ -0,0 +1,147 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief IR dot tracking across reports.
+ *
+ *	Two dots cross each other while the sensor shuffles their report
+ *	slots and briefly loses one.  Each must keep its id and order.  A
+ *	lone dot that starts a new track must not move the cursor.
+ */
+
+#include "check.h"
+
+#include "ir.h" /* for calculate_extended_ir */
+
+#include <stdlib.h> /* for abs */
+#include <string.h> /* for memset */
+
+/* store a dot in an extended IR report */
+static void put_dot(byte *data, int slot, int x, int y)
+{
+    data[slot * 3]     = x & 0xff;
+    data[slot * 3 + 1] = y & 0xff;
+    data[slot * 3 + 2] = ((y >> 8) << 6) | ((x >> 8) << 4) | 3;
+}
+
+/* the visible dot closest to height y, or NULL */
+static const struct ir_dot_t *find_dot(const struct ir_t *ir, int y)
+{
+    const struct ir_dot_t *found = NULL;
+    int i;
+
+    for (i = 0; i < 4; ++i)
+    {
+        if (ir->dot[i].visible && (!found || abs((int)ir->dot[i].y - y) < abs((int)found->y - y)))
+        {
+            found = &ir->dot[i];
+        }
+    }
+
+    return found;
+}
+
+static struct wiimote_t wm;
+
+int main(void)
+{
+    byte data[12];
+    int id_a = 0, id_b = 0, order_a = 0;
+    int f, x, y;
+
+    memset(&wm, 0, sizeof(wm));
+    wm.state      = WIIMOTE_STATE_IR;
+    wm.ir.vres[0] = 1024;
+    wm.ir.vres[1] = 768;
+    wm.ir.pos     = WIIUSE_IR_ABOVE;
+    wm.ir.aspect  = WIIUSE_ASPECT_4_3;
+
+    for (f = 0; f < 30; ++f)
+    {
+        /* A moves right, B moves left a little lower, they cross around f = 13 */
+        int ax = 300 + f * 15;
+        int bx = 700 - f * 15;
+        const struct ir_dot_t *a, *b;
+
+        memset(data, 0xff, sizeof(data));
+        if (f % 7 == 3)
+        {
+            /* A is gone for a report, B moves to slot 0 */
+            put_dot(data, 0, bx, 400);
+        } else
+        {
+            /* the slots swap on every report */
+            put_dot(data, f & 1, ax, 380);
+            put_dot(data, !(f & 1), bx, 400);
+        }
+        calculate_extended_ir(&wm, data);
+
+        a = (f % 7 == 3) ? NULL : find_dot(&wm.ir, 380);
+        b = find_dot(&wm.ir, 400);
+
+        if (!id_a && a)
+        {
+            id_a    = a->id;
+            id_b    = b->id;
+            order_a = a->order;
+            CHECK(id_a && id_b && id_a != id_b);
+            continue;
+        }
+
+        if (a)
+        {
+            CHECK(a->id == id_a);
+            CHECK(a->order == order_a);
+        }
+        CHECK(b->id == id_b);
+
+        if (f > 5 && a)
+        {
+            /* 15 pixels per report, the sensor mirrors x */
+            CHECK(a->vx < -10.0f && a->vx > -20.0f);
+            CHECK(b->vx > 10.0f && b->vx < 20.0f);
+        }
+    }
+
+    /* drop the tracks, then a new pair and a lone dot that is neither of them */
+    memset(data, 0xff, sizeof(data));
+    for (f = 0; f <= IR_TRACK_MAX_MISSED; ++f)
+    {
+        calculate_extended_ir(&wm, data);
+    }
+
+    put_dot(data, 0, 400, 380);
+    put_dot(data, 1, 600, 380);
+    calculate_extended_ir(&wm, data);
+    calculate_extended_ir(&wm, data);
+    x = wm.ir.x;
+    y = wm.ir.y;
+
+    memset(data, 0xff, sizeof(data));
+    put_dot(data, 2, 200, 420);
+    calculate_extended_ir(&wm, data);
+    CHECK(find_dot(&wm.ir, 420)->order == 0);
+    CHECK(wm.ir.x == x && wm.ir.y == y);
+
+    return check_result();
+}
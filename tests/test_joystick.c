@@ -0,0 +1,117 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Joystick tables against the float path.
+ *
+ *	For every raw x and y, calc_joystick_state() with the tables of
+ *	joystick_build_lut() must give the positions and magnitude of the
+ *	float path and an angle within 7e-4 degrees of it.
+ */
+
+#include "check.h"
+
+#include "dynamics.h" /* for calc_joystick_state, joystick_build_lut */
+
+#include <math.h>   /* for fabsf */
+#include <string.h> /* for memset */
+
+#define ANGLE_TOLERANCE 7e-4f
+
+static void calibrate(struct joystick_t *js, byte min, byte center, byte max)
+{
+    memset(js, 0, sizeof(*js));
+    js->min.x = js->min.y = min;
+    js->center.x          = center;
+    js->center.y          = (byte)(center + 2);
+    js->max.x = js->max.y = max;
+}
+
+/**
+ *	@brief Largest angle difference, counting other differences in \a mismatch.
+ */
+static float max_error(struct joystick_t *js, int *mismatch)
+{
+    struct joystick_t ref = *js;
+    float err = 0.0f, d;
+    int x, y;
+
+    ref.norm_lut = NULL;
+    *mismatch    = 0;
+
+    for (x = 0; x < 256; ++x)
+    {
+        for (y = 0; y < 256; ++y)
+        {
+            calc_joystick_state(js, (byte)x, (byte)y);
+            calc_joystick_state(&ref, (byte)x, (byte)y);
+
+            if (js->x != ref.x || js->y != ref.y || js->mag != ref.mag)
+            {
+                ++*mismatch;
+            }
+
+            /* 0 and 360 degrees are the same angle */
+            d = fabsf(js->ang - ref.ang);
+            if (d > 180.0f)
+            {
+                d = 360.0f - d;
+            }
+            if (d > err)
+            {
+                err = d;
+            }
+        }
+    }
+
+    return err;
+}
+
+int main(void)
+{
+    /* a nunchuk, the left stick of a classic controller, and one off centre */
+    static const byte cal[][3] = {{35, 128, 225}, {4, 32, 60}, {20, 180, 230}};
+    struct joystick_t js;
+    int mismatch;
+    size_t i;
+
+    for (i = 0; i < sizeof(cal) / sizeof(cal[0]); ++i)
+    {
+        calibrate(&js, cal[i][0], cal[i][1], cal[i][2]);
+        joystick_build_lut(&js);
+#ifdef WIIUSE_FIXED_POINT
+        /* the integer path has no tables */
+        CHECK(js.norm_lut == NULL);
+#else
+        CHECK(js.norm_lut != NULL);
+#endif
+
+        CHECK(max_error(&js, &mismatch) <= ANGLE_TOLERANCE);
+        CHECK(mismatch == 0);
+
+        joystick_free_lut(&js);
+        CHECK(js.norm_lut == NULL);
+    }
+
+    return check_result();
+}
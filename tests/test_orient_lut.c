@@ -0,0 +1,149 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Orientation lookup tables against the float path.
+ *
+ *	For every raw input of a few calibrations, roll and pitch from the
+ *	tables must be within 0.005 degrees (half a table step) of what
+ *	calculate_orientation() gives without them.
+ */
+
+#include "check.h"
+
+#include "dynamics.h" /* for accel_build_orient_lut, calculate_orientation */
+
+#include <math.h>   /* for fabsf */
+#include <string.h> /* for memset */
+
+/* half of 1/WIIUSE_ORIENT_PRECISION, plus the rounding of a float near 180 */
+#define TOLERANCE 0.0051f
+
+/* marks an angle calculate_orientation() left alone */
+#define UNTOUCHED 1000.0f
+
+static void calibrate(struct accel_t *ac, byte zero, byte g)
+{
+    memset(ac, 0, sizeof(*ac));
+    ac->cal_zero.x = ac->cal_zero.y = ac->cal_zero.z = zero;
+    ac->cal_g.x = ac->cal_g.y = ac->cal_g.z = g;
+}
+
+static void orient(struct accel_t *ac, int x, int y, int z, struct orient_t *o)
+{
+    struct vec3b_t raw;
+
+    raw.x = (byte)x;
+    raw.y = (byte)y;
+    raw.z = (byte)z;
+    o->roll = o->pitch = o->a_roll = o->a_pitch = UNTOUCHED;
+    calculate_orientation(ac, &raw, o, 0, 0);
+}
+
+/**
+ *	@brief Largest difference between the tables and the float path.
+ *
+ *	Also counts the inputs where only one of them set an angle.
+ */
+static float max_error(struct accel_t *ac, int *mismatch)
+{
+    struct accel_t ref = *ac;
+    struct orient_t a, b;
+    float err = 0.0f;
+    int x, y, z;
+
+    ref.orient_lut = NULL;
+    *mismatch      = 0;
+
+    for (x = 0; x < 256; ++x)
+    {
+        for (y = 0; y < 256; ++y)
+        {
+            for (z = 0; z < 256; ++z)
+            {
+                orient(ac, x, y, z, &a);
+                orient(&ref, x, y, z, &b);
+
+                if ((a.roll == UNTOUCHED) != (b.roll == UNTOUCHED)
+                    || (a.pitch == UNTOUCHED) != (b.pitch == UNTOUCHED))
+                {
+                    ++*mismatch;
+                    continue;
+                }
+                if (fabsf(a.roll - b.roll) > err)
+                {
+                    err = fabsf(a.roll - b.roll);
+                }
+                if (fabsf(a.pitch - b.pitch) > err)
+                {
+                    err = fabsf(a.pitch - b.pitch);
+                }
+            }
+        }
+    }
+
+    return err;
+}
+
+int main(void)
+{
+    /* a wiimote, a wider 1g, and a zero so low the tables are cut at 0 */
+    static const byte cal[][2] = {{128, 26}, {128, 36}, {10, 30}};
+    struct accel_t ac;
+    int mismatch;
+    size_t i;
+
+    for (i = 0; i < sizeof(cal) / sizeof(cal[0]); ++i)
+    {
+        calibrate(&ac, cal[i][0], cal[i][1]);
+        accel_build_orient_lut(&ac);
+        CHECK(ac.orient_lut != NULL);
+
+        CHECK(max_error(&ac, &mismatch) <= TOLERANCE);
+        CHECK(mismatch == 0);
+
+        accel_free_orient_lut(&ac);
+    }
+
+    /* tables of another calibration are not used */
+    calibrate(&ac, 128, 26);
+    accel_build_orient_lut(&ac);
+    ac.cal_g.x = 30;
+    {
+        struct accel_t ref = ac;
+        struct orient_t a, b;
+
+        ref.orient_lut = NULL;
+        orient(&ac, 150, 120, 140, &a);
+        orient(&ref, 150, 120, 140, &b);
+        CHECK(a.roll == b.roll && a.pitch == b.pitch);
+    }
+    accel_free_orient_lut(&ac);
+
+    /* a calibration that would need too large tables keeps the float path */
+    calibrate(&ac, 128, 127);
+    accel_build_orient_lut(&ac);
+    CHECK(ac.orient_lut == NULL);
+
+    return check_result();
+}
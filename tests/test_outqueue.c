@@ -0,0 +1,238 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Output queue priorities, replacement, rate limit and stats.
+ *
+ *	The wiimote is a socketpair.  Stuffing the sending side until the
+ *	kernel refuses more makes wiiuse_os_write() return
+ *	WIIUSE_OS_WOULD_BLOCK, so reports are queued; reading the
+ *	stuffing back lets them out on the next outqueue_pump().
+ */
+
+#include "check.h"
+
+#include "os.h"       /* for wiiuse_os_ticks */
+#include "outqueue.h" /* for outqueue_send, outqueue_pump */
+
+#include <errno.h>      /* for EAGAIN */
+#include <sys/socket.h> /* for socketpair, send, recv */
+#include <unistd.h>     /* for close */
+
+#define STUFFING 0xEE
+
+static int sv[2];
+
+/**
+ *	@brief Fill the socket until a send would block.
+ */
+static int stuff(void)
+{
+    byte buf[3] = {0xa2, STUFFING, 0};
+    int n;
+
+    for (n = 0; n < 100000; ++n)
+    {
+        if (send(sv[0], buf, sizeof(buf), MSG_DONTWAIT) < 0)
+        {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+    return 0;
+}
+
+/**
+ *	@brief Read the next report that is not stuffing.
+ *
+ *	@return Its length, 0 if none is there.
+ */
+static int next_report(byte *buf, int len)
+{
+    int n;
+
+    while ((n = recv(sv[1], buf, len, MSG_DONTWAIT)) > 0)
+    {
+        if (buf[1] != STUFFING)
+        {
+            return n;
+        }
+    }
+    return 0;
+}
+
+/**
+ *	@brief Drop the stuffing and anything sent so far.
+ */
+static void drain(void)
+{
+    byte buf[32];
+
+    while (recv(sv[1], buf, sizeof(buf), MSG_DONTWAIT) > 0)
+        ;
+}
+
+static int send_byte(struct wiimote_t *wm, byte type, byte b)
+{
+    return outqueue_send(wm, type, &b, 1);
+}
+
+int main(void)
+{
+    struct wiimote_t **wms = wiiuse_init(1);
+    struct wiimote_t *wm   = wms[0];
+    struct outq_stats_t *rt, *cf, *bk;
+    byte data[21] = {0};
+    byte buf[32];
+    unsigned long ticks;
+    int i, n;
+
+    CHECK(socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) == 0);
+    wm->in_sock = sv[0];
+    WIIMOTE_ENABLE_STATE(wm, WIIMOTE_STATE_CONNECTED);
+
+    rt = &wm->outq.stats[WIIUSE_OUTQ_REALTIME];
+    cf = &wm->outq.stats[WIIUSE_OUTQ_CONFIG];
+    bk = &wm->outq.stats[WIIUSE_OUTQ_BULK];
+
+    wiiuse_set_output_rate(wm, 0, 1);
+
+    /* a free socket takes the report at once */
+    CHECK(send_byte(wm, WM_CMD_LED, 0x10) == 3);
+    CHECK(next_report(buf, sizeof(buf)) == 3 && buf[1] == WM_CMD_LED && buf[2] == 0x10);
+    CHECK(rt->sent == 1 && rt->depth == 0 && rt->latency_max == 0);
+
+    /* a full socket requeues; the queue drains highest class first */
+    CHECK(stuff());
+    CHECK(outqueue_send(wm, WM_CMD_WRITE_DATA, data, sizeof(data)) == (int)sizeof(data));
+    CHECK(send_byte(wm, WM_CMD_REPORT_TYPE, 0x30) == 1);
+    CHECK(send_byte(wm, WM_CMD_IR_2, 0x04) == 1);
+    CHECK(send_byte(wm, WM_CMD_LED, 0x20) == 1);
+    CHECK(bk->depth == 1 && cf->depth == 1 && rt->depth == 2);
+    CHECK(bk->sent == 0 && cf->sent == 0 && rt->sent == 1);
+
+    /* still blocked: nothing moves, nothing is lost */
+    outqueue_pump(wm, wiiuse_os_ticks());
+    CHECK(rt->depth == 2 && bk->dropped == 0);
+
+    drain();
+    ticks = wiiuse_os_ticks() + 50;
+    outqueue_pump(wm, ticks);
+    CHECK(next_report(buf, sizeof(buf)) == 3 && buf[1] == WM_CMD_IR_2);
+    CHECK(next_report(buf, sizeof(buf)) == 3 && buf[1] == WM_CMD_LED && buf[2] == 0x20);
+    CHECK(next_report(buf, sizeof(buf)) == 3 && buf[1] == WM_CMD_REPORT_TYPE);
+    CHECK(next_report(buf, sizeof(buf)) == 23 && buf[1] == WM_CMD_WRITE_DATA);
+    CHECK(next_report(buf, sizeof(buf)) == 0);
+
+    /* the reports waited the 50 ms the pump was ahead */
+    CHECK(rt->depth == 0 && cf->depth == 0 && bk->depth == 0);
+    CHECK(rt->sent == 3 && cf->sent == 1 && bk->sent == 1);
+    CHECK(rt->max_depth == 2 && cf->max_depth == 1 && bk->max_depth == 1);
+    CHECK(bk->latency_max >= 50 && bk->latency_max < 1000);
+    CHECK(rt->latency_sum >= 100 && rt->latency_max >= 50);
+
+    /* a waiting LED or rumble report is replaced by a newer one */
+    CHECK(stuff());
+    send_byte(wm, WM_CMD_LED, 0x10);
+    send_byte(wm, WM_CMD_RUMBLE, 0x00);
+    send_byte(wm, WM_CMD_LED, 0x30);
+    send_byte(wm, WM_CMD_RUMBLE, 0x04);
+    send_byte(wm, WM_CMD_LED, 0x80);
+    CHECK(rt->depth == 2);
+
+    drain();
+    outqueue_flush(wm);
+    CHECK(next_report(buf, sizeof(buf)) == 3 && buf[1] == WM_CMD_LED && buf[2] == 0x80);
+    CHECK(next_report(buf, sizeof(buf)) == 3 && buf[1] == WM_CMD_RUMBLE && buf[2] == 0x04);
+    CHECK(next_report(buf, sizeof(buf)) == 0);
+    CHECK(rt->sent == 5 && rt->dropped == 0);
+
+    /* report types that carry no whole state are never replaced */
+    CHECK(stuff());
+    send_byte(wm, WM_CMD_CTRL_STATUS, 0);
+    send_byte(wm, WM_CMD_CTRL_STATUS, 0);
+    CHECK(cf->depth == 2);
+
+    /* a full class drops the newest report */
+    for (i = 0; i < WIIUSE_OUTQ_LEN; ++i)
+    {
+        data[6] = (byte)i;
+        outqueue_send(wm, WM_CMD_WRITE_DATA, data, sizeof(data));
+    }
+    CHECK(outqueue_send(wm, WM_CMD_WRITE_DATA, data, sizeof(data)) == 0);
+    CHECK(bk->depth == WIIUSE_OUTQ_LEN && bk->max_depth == WIIUSE_OUTQ_LEN && bk->dropped == 1);
+
+    drain();
+    outqueue_flush(wm);
+    for (i = 0, n = 0; next_report(buf, sizeof(buf)); ++i)
+    {
+        if (buf[1] == WM_CMD_WRITE_DATA && buf[8] == (byte)n)
+        {
+            ++n;
+        }
+    }
+    CHECK(i == 2 + WIIUSE_OUTQ_LEN && n == WIIUSE_OUTQ_LEN);
+    CHECK(cf->sent == 3 && bk->sent == 1 + WIIUSE_OUTQ_LEN);
+
+    /*
+     *	10 reports per second in bursts of 3: the burst goes out at once,
+     *	then one report per 100 ms.  The bucket keeps the one token of
+     *	the unlimited rate, the sleep fills it; after that the real clock
+     *	adds far less than a report while the test runs.
+     */
+    wiiuse_set_output_rate(wm, 10, 3);
+    wiiuse_millisleep(400);
+    for (i = 0; i < 5; ++i)
+    {
+        send_byte(wm, WM_CMD_CTRL_STATUS, 0);
+    }
+    for (n = 0; next_report(buf, sizeof(buf)); ++n)
+        ;
+    CHECK(n == 3 && cf->depth == 2);
+
+    ticks = wm->outq.tokens_ticks;
+    outqueue_pump(wm, ticks += 50);
+    CHECK(next_report(buf, sizeof(buf)) == 0 && cf->depth == 2);
+    outqueue_pump(wm, ticks += 50);
+    CHECK(next_report(buf, sizeof(buf)) == 3 && cf->depth == 1);
+    outqueue_pump(wm, ticks += 100);
+    CHECK(next_report(buf, sizeof(buf)) == 3 && cf->depth == 0);
+    CHECK(cf->latency_max >= 200);
+
+    /* a long pause refills no more than the burst */
+    outqueue_pump(wm, ticks += 10000);
+    CHECK(wm->outq.tokens == 3 * OUTQ_TOKEN);
+
+    /* a refused token is given back, not spent on a blocked socket */
+    CHECK(stuff());
+    send_byte(wm, WM_CMD_CTRL_STATUS, 0);
+    CHECK(cf->depth == 1);
+    CHECK(wm->outq.tokens >= 3 * OUTQ_TOKEN);
+
+    WIIMOTE_DISABLE_STATE(wm, WIIMOTE_STATE_CONNECTED);
+    wm->in_sock = -1;
+    close(sv[0]);
+    close(sv[1]);
+    wiiuse_cleanup(wms, 1);
+
+    return check_result();
+}
@@ -0,0 +1,144 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Device registry lookups, connected list and removal.
+ *
+ *	A wiimote found by wiiuse_find() must be found by that address, the
+ *	connected list must follow connects and disconnects, and removing
+ *	or freeing a connected wiimote must close its sockets.
+ */
+
+#include "check.h"
+
+#include "os.h"       /* for wiiuse_os_set_bdaddr */
+#include "registry.h" /* for registry_update */
+
+#include <errno.h>      /* for errno, EBADF */
+#include <fcntl.h>      /* for fcntl */
+#include <stdio.h>      /* for snprintf */
+#include <sys/socket.h> /* for socketpair */
+
+#define MANY 100
+
+static int is_closed(int fd) { return fcntl(fd, F_GETFD) == -1 && errno == EBADF; }
+
+/**
+ *	@brief Give a wiimote a pair of sockets and connect it, as wiiuse_connect() would.
+ */
+static void fake_connect(struct wiimote_t *wm, int *sv)
+{
+    CHECK(socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) == 0);
+    wm->out_sock = sv[0];
+    wm->in_sock  = sv[1];
+    WIIMOTE_ENABLE_STATE(wm, WIIMOTE_STATE_CONNECTED);
+    registry_update(wm);
+}
+
+/**
+ *	@brief If \a wm is one of the \a n wiimotes of \a list.
+ */
+static int listed(struct wiimote_t **list, int n, struct wiimote_t *wm)
+{
+    int i;
+
+    for (i = 0; i < n; ++i)
+    {
+        if (list[i] == wm)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    struct wiiuse_registry_t *reg = wiiuse_registry_new();
+    struct wiimote_t *wm[MANY];
+    struct wiimote_t *connected[MANY];
+    char addr[REGISTRY_BDADDR_LEN];
+    int sv[3][2];
+    int i, n;
+
+    CHECK(reg != NULL);
+    for (i = 0; i < 4; ++i)
+    {
+        wm[i] = wiiuse_registry_add(reg, NULL);
+        CHECK(wm[i] != NULL && wm[i]->registry == reg);
+    }
+
+    /* an address known from wiiuse_find() is indexed too */
+    CHECK(wiiuse_registry_get_by_bdaddr(reg, "00:1F:C5:00:00:02") == NULL);
+    wiiuse_os_set_bdaddr(wm[2], "00:1F:C5:00:00:02");
+    registry_update(wm[2]);
+    CHECK(wiiuse_registry_get_by_bdaddr(reg, "00:1f:c5:00:00:02") == wm[2]);
+    CHECK(wiiuse_registry_add(reg, "00:1F:C5:00:00:02") == wm[2]);
+
+    /* the connected list follows connects and disconnects */
+    CHECK(wiiuse_registry_connected(reg, connected, MANY) == 0);
+    fake_connect(wm[0], sv[0]);
+    fake_connect(wm[1], sv[1]);
+    fake_connect(wm[3], sv[2]);
+    n = wiiuse_registry_connected(reg, connected, MANY);
+    CHECK(n == 3 && listed(connected, n, wm[0]) && listed(connected, n, wm[1]) && listed(connected, n, wm[3]));
+    CHECK(wiiuse_registry_connected(reg, connected, 2) == 2);
+
+    wiiuse_disconnect(wm[1]);
+    CHECK(is_closed(sv[1][0]) && is_closed(sv[1][1]));
+    n = wiiuse_registry_connected(reg, connected, MANY);
+    CHECK(n == 2 && !listed(connected, n, wm[1]));
+
+    /* removing a connected wiimote closes its sockets */
+    wiiuse_registry_remove(reg, wm[0]);
+    CHECK(is_closed(sv[0][0]) && is_closed(sv[0][1]));
+    n = wiiuse_registry_connected(reg, connected, MANY);
+    CHECK(n == 1 && connected[0] == wm[3]);
+    wiiuse_registry_devices(reg, &n);
+    CHECK(n == 3);
+    CHECK(wiiuse_registry_get_by_id(reg, 1) == NULL);
+    CHECK(wiiuse_registry_get_by_id(reg, 4) == wm[3]);
+    CHECK(wiiuse_registry_get_by_bdaddr(reg, "00:1F:C5:00:00:02") == wm[2]);
+
+    /* growing keeps the addresses and the connected list */
+    for (i = 4; i < MANY; ++i)
+    {
+        snprintf(addr, sizeof(addr), "00:1F:C5:00:01:%02X", i);
+        wm[i] = wiiuse_registry_add(reg, addr);
+        CHECK(wm[i] != NULL);
+    }
+    for (i = 4; i < MANY; ++i)
+    {
+        snprintf(addr, sizeof(addr), "00:1f:c5:00:01:%02x", i);
+        CHECK(wiiuse_registry_get_by_bdaddr(reg, addr) == wm[i]);
+        CHECK(wiiuse_registry_get_by_id(reg, wm[i]->unid) == wm[i]);
+    }
+    n = wiiuse_registry_connected(reg, connected, MANY);
+    CHECK(n == 1 && connected[0] == wm[3]);
+
+    /* freeing the registry closes the sockets of the wiimotes still connected */
+    wiiuse_registry_free(reg);
+    CHECK(is_closed(sv[2][0]) && is_closed(sv[2][1]));
+
+    return check_result();
+}
@@ -0,0 +1,109 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Report type picked for each wiimote state.
+ *
+ *	Every combination must give a report, an expansion that was not
+ *	recognized still gets the widest expansion report.
+ */
+
+#include "check.h"
+
+#include "outqueue.h" /* for outqueue_flush */
+#include "wiiuse_internal.h"
+
+#include <string.h>     /* for memset */
+#include <sys/socket.h> /* for socketpair, recv */
+#include <unistd.h>     /* for close */
+
+/**
+ *	@brief Set the state and return the report type the wiimote was sent.
+ */
+static int report_for(struct wiimote_t *wm, int sock, int state, int exp_type, int alternate)
+{
+    byte buf[64];
+    int id = 0;
+    int n;
+
+    WIIMOTE_DISABLE_STATE(wm, WIIMOTE_STATE_ACC | WIIMOTE_STATE_IR | WIIMOTE_STATE_EXP);
+    WIIMOTE_ENABLE_STATE(wm, state);
+    wm->exp.type                    = exp_type;
+    wm->exp.wb.use_alternate_report = alternate;
+    wm->out.known &= ~WM_OUT_REPORT;
+
+    if (wiiuse_set_report_type(wm) <= 0)
+    {
+        return 0;
+    }
+    outqueue_flush(wm);
+
+    while ((n = recv(sock, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+    {
+        if (n >= 4 && buf[1] == WM_CMD_REPORT_TYPE)
+        {
+            id = buf[3];
+        }
+    }
+    return id;
+}
+
+int main(void)
+{
+    struct wiimote_t **wiimotes = wiiuse_init(1);
+    struct wiimote_t *wm        = wiimotes[0];
+    int sv[2];
+
+    CHECK(socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) == 0);
+    wm->in_sock = sv[0];
+    WIIMOTE_ENABLE_STATE(wm, WIIMOTE_STATE_CONNECTED);
+
+    CHECK(report_for(wm, sv[1], 0, EXP_NONE, 0) == WM_RPT_BTN);
+    CHECK(report_for(wm, sv[1], WIIMOTE_STATE_ACC, EXP_NONE, 0) == WM_RPT_BTN_ACC);
+    CHECK(report_for(wm, sv[1], WIIMOTE_STATE_ACC | WIIMOTE_STATE_IR, EXP_NONE, 0) == WM_RPT_BTN_ACC_IR);
+    CHECK(report_for(wm, sv[1], WIIMOTE_STATE_EXP, EXP_NUNCHUK, 0) == WM_RPT_BTN_EXP_8);
+    CHECK(report_for(wm, sv[1], WIIMOTE_STATE_EXP | WIIMOTE_STATE_ACC | WIIMOTE_STATE_IR, EXP_NUNCHUK, 0)
+          == WM_RPT_BTN_ACC_IR_EXP);
+
+    /* an expansion that is still being identified */
+    CHECK(report_for(wm, sv[1], WIIMOTE_STATE_EXP, EXP_NONE, 0) == WM_RPT_BTN_EXP);
+    CHECK(report_for(wm, sv[1], WIIMOTE_STATE_EXP | WIIMOTE_STATE_ACC, EXP_NONE, 0) == WM_RPT_BTN_ACC_EXP);
+    CHECK(report_for(wm, sv[1], WIIMOTE_STATE_EXP | WIIMOTE_STATE_IR, EXP_NONE, 0) == WM_RPT_BTN_IR_EXP);
+    CHECK(report_for(wm, sv[1], WIIMOTE_STATE_EXP | WIIMOTE_STATE_ACC | WIIMOTE_STATE_IR, EXP_NONE, 0)
+          == WM_RPT_BTN_ACC_IR_EXP);
+
+    /* the balance board needs 8 bytes, 0x32 only when asked for */
+    CHECK(report_for(wm, sv[1], WIIMOTE_STATE_EXP, EXP_WII_BOARD, 0) == WM_RPT_BTN_EXP);
+    CHECK(report_for(wm, sv[1], WIIMOTE_STATE_EXP, EXP_WII_BOARD, 1) == WM_RPT_BTN_EXP_8);
+    CHECK(report_for(wm, sv[1], WIIMOTE_STATE_EXP | WIIMOTE_STATE_ACC, EXP_WII_BOARD, 0) == WM_RPT_BTN_ACC_EXP);
+    CHECK(report_for(wm, sv[1], WIIMOTE_STATE_EXP | WIIMOTE_STATE_ACC | WIIMOTE_STATE_IR, EXP_WII_BOARD, 0)
+          == WM_RPT_BTN_ACC_IR_EXP);
+
+    WIIMOTE_DISABLE_STATE(wm, WIIMOTE_STATE_CONNECTED);
+    wm->in_sock = -1;
+    close(sv[0]);
+    close(sv[1]);
+    wiiuse_cleanup(wiimotes, 1);
+
+    return check_result();
+}
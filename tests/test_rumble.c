@@ -0,0 +1,159 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Rumble duty cycle and effect envelope.
+ *
+ *	The motor is switched by a software PWM, so the time the rumble bit
+ *	is on over a socketpair gives the intensity.  The output queue and
+ *	the effects run on the real clock, so the test runs in real time.
+ */
+
+#include "check.h"
+
+#include "os.h"     /* for wiiuse_os_ticks */
+#include "rumble.h" /* for rumble_pump */
+
+#include <math.h>       /* for fabs */
+#include <sys/socket.h> /* for socketpair, recv */
+#include <unistd.h>     /* for close, usleep */
+
+#define WIIMOTES 4
+
+/**
+ *	@brief On time of the rumble bit in the reports a wiimote was sent.
+ */
+struct motor_t
+{
+    int sock;
+    byte on;
+    unsigned long on_ticks;
+    unsigned long total;
+};
+
+static void motor_read(struct motor_t *m, unsigned long ticks)
+{
+    byte buf[32];
+    int n;
+
+    while ((n = recv(m->sock, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+    {
+        byte on = (n > 2) && (buf[2] & 0x01);
+
+        if (on && !m->on)
+        {
+            m->on_ticks = ticks;
+        } else if (!on && m->on)
+        {
+            m->total += ticks - m->on_ticks;
+        }
+        m->on = on;
+    }
+}
+
+/**
+ *	@brief Pump the rumble timers for \a ms milliseconds.
+ */
+static void run(struct wiimote_t **wm, struct motor_t *motor, unsigned long ms)
+{
+    unsigned long start = wiiuse_os_ticks();
+    unsigned long t;
+    int i;
+
+    for (t = start; t - start < ms; t = wiiuse_os_ticks())
+    {
+        rumble_pump(wm[0], t);
+        for (i = 0; i < WIIMOTES; ++i)
+        {
+            motor_read(&motor[i], t);
+        }
+        usleep(500);
+    }
+
+    /* count a motor that is still on up to now */
+    for (i = 0; i < WIIMOTES; ++i)
+    {
+        if (motor[i].on)
+        {
+            motor[i].total += t - motor[i].on_ticks;
+            motor[i].on_ticks = t;
+        }
+    }
+}
+
+int main(void)
+{
+    static const float level[WIIMOTES] = {0.25f, 0.5f, 0.8f, 1.0f};
+    struct wiimote_t **wm              = wiiuse_init(WIIMOTES);
+    struct motor_t motor[WIIMOTES];
+    int sv[WIIMOTES][2];
+    int i;
+
+    for (i = 0; i < WIIMOTES; ++i)
+    {
+        CHECK(socketpair(AF_UNIX, SOCK_DGRAM, 0, sv[i]) == 0);
+        wm[i]->in_sock = sv[i][0];
+        WIIMOTE_ENABLE_STATE(wm[i], WIIMOTE_STATE_CONNECTED);
+
+        motor[i].sock     = sv[i][1];
+        motor[i].on       = 0;
+        motor[i].on_ticks = 0;
+        motor[i].total    = 0;
+    }
+
+    /* the duty cycle follows the level */
+    for (i = 0; i < WIIMOTES; ++i)
+    {
+        wiiuse_rumble_effect(wm[i], level[i], 0, WIIUSE_RUMBLE_FOREVER, 0);
+    }
+    run(wm, motor, 3000);
+    for (i = 0; i < WIIMOTES; ++i)
+    {
+        CHECK(fabs(motor[i].total / 3000.0 - level[i]) < 0.05);
+    }
+
+    /* full attack, sustain and release of 100 ms each: 200 ms on */
+    for (i = 0; i < WIIMOTES; ++i)
+    {
+        wiiuse_rumble(wm[i], 0);
+        motor[i].total = 0;
+    }
+    run(wm, motor, 100);
+    motor[0].total = 0;
+    wiiuse_rumble_effect(wm[0], 1.0f, 100, 100, 100);
+    run(wm, motor, 500);
+    CHECK(motor[0].total >= 170 && motor[0].total <= 230);
+    CHECK(!wm[0]->rumble.active && !motor[0].on);
+    CHECK(motor[1].total == 0);
+
+    for (i = 0; i < WIIMOTES; ++i)
+    {
+        WIIMOTE_DISABLE_STATE(wm[i], WIIMOTE_STATE_CONNECTED);
+        wm[i]->in_sock = -1;
+        close(sv[i][0]);
+        close(sv[i][1]);
+    }
+    wiiuse_cleanup(wm, WIIMOTES);
+
+    return check_result();
+}
@@ -0,0 +1,172 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Orientation smoothing against reference filters.
+ *
+ *	At the nominal 10 ms interval the moving average must be the old
+ *	per-sample one, at other intervals it must keep the same time
+ *	constant.  The One-Euro path must follow a double precision
+ *	One-Euro filter over irregular report intervals.
+ */
+
+#include "check.h"
+
+#include "dynamics.h" /* for apply_smoothing, calculate_orientation */
+
+#include <math.h>   /* for fabs, sin */
+#include <string.h> /* for memset */
+
+/* degrees */
+#define EMA_TOLERANCE  1e-4
+#define EURO_TOLERANCE 1e-3
+
+/* the step response at other intervals, in parts of the step */
+#define PACE_TOLERANCE 0.03
+
+/**
+ *	@brief Smooth one roll sample of \a dt seconds.
+ */
+static float smooth(struct accel_t *ac, float angle, float dt)
+{
+    struct orient_t o;
+
+    memset(&o, 0, sizeof(o));
+    o.roll = o.a_roll = angle;
+    apply_smoothing(ac, &o, SMOOTH_ROLL, dt);
+    return o.roll;
+}
+
+/**
+ *	@brief The input: a slow sine with a few jumps, always positive.
+ */
+static double input(double t)
+{
+    return 45.0 + 30.0 * sin(2.0 * 3.14159265358979 * 0.7 * t) + ((int)(t * 4.0) % 2 ? 8.0 : 0.0);
+}
+
+static double lp_alpha(double dt, double cutoff)
+{
+    double r = 2.0 * 3.14159265358979 * cutoff * dt;
+
+    return r / (r + 1.0);
+}
+
+/**
+ *	@brief Roll after \a ms of a step from 10 to 40 degrees, reports \a step_ms apart.
+ *
+ *	Goes through calculate_orientation(), so the interval comes from the
+ *	report time stamps.
+ */
+static float step_response(int step_ms, int ms)
+{
+    struct accel_t ac;
+    struct orient_t o;
+    struct vec3b_t raw;
+    uint64_t ns = 1000000000;
+    int t;
+
+    memset(&ac, 0, sizeof(ac));
+    memset(&o, 0, sizeof(o));
+    ac.cal_zero.x = ac.cal_zero.y = ac.cal_zero.z = 128;
+    ac.cal_g.x = ac.cal_g.y = ac.cal_g.z = 26;
+    ac.st_alpha = 0.07f;
+
+    /* settle at about 10 degrees (x = 5, z = 26: atan2 gives 10.9) */
+    raw.x = 133;
+    raw.y = 128;
+    raw.z = 154;
+    for (t = 0; t < 3000; t += step_ms)
+    {
+        calculate_orientation(&ac, &raw, &o, 1, ns);
+        ns += (uint64_t)step_ms * 1000000;
+    }
+
+    /* step to about 40 degrees (x = 22, z = 26: 40.2) */
+    raw.x = 150;
+    for (t = 0; t < ms; t += step_ms)
+    {
+        calculate_orientation(&ac, &raw, &o, 1, ns);
+        ns += (uint64_t)step_ms * 1000000;
+    }
+
+    return o.roll;
+}
+
+int main(void)
+{
+    struct accel_t ac;
+    double st, rate, t, dt, err;
+    float out = 0.0f, held;
+    float ref10;
+    int i;
+
+    /* the moving average at 10 ms is st += alpha * (angle - st) */
+    memset(&ac, 0, sizeof(ac));
+    ac.st_alpha = 0.07f;
+    st          = input(0.0);
+    ac.st_roll  = (float)st;
+    err         = 0.0;
+    for (i = 1, t = 0.0; i <= 300; ++i)
+    {
+        t += 0.01;
+        st += 0.07 * (input(t) - st);
+        out = smooth(&ac, (float)input(t), 0.01f);
+        err = fmax(err, fabs(out - st));
+    }
+    CHECK(err <= EMA_TOLERANCE);
+
+    /* a report with the same time stamp changes nothing */
+    held = smooth(&ac, 80.0f, 0.0f);
+    CHECK(held == out);
+
+    /* the same time constant at 5 and 20 ms */
+    ref10 = step_response(10, 200);
+    CHECK(fabs(step_response(5, 200) - ref10) <= PACE_TOLERANCE * 30.0);
+    CHECK(fabs(step_response(20, 200) - ref10) <= PACE_TOLERANCE * 30.0);
+    CHECK(ref10 > 25.0f && ref10 < 40.0f);
+
+    /* a 400 ms gap counts as 100 ms: 43% of the step, not 75% */
+    CHECK(step_response(400, 400) < 26.0f);
+
+    /* One-Euro against a double precision reference, reports 4 to 17 ms apart */
+    memset(&ac, 0, sizeof(ac));
+    ac.st_min_cutoff = 1.0f;
+    ac.st_beta       = 0.01f;
+    st               = input(0.0);
+    rate             = 0.0;
+    ac.st_roll       = (float)st;
+    err              = 0.0;
+    for (i = 1, t = 0.0; i <= 400; ++i)
+    {
+        dt = 0.004 + 0.001 * ((i * 7) % 14);
+        t += dt;
+        rate += lp_alpha(dt, WIIUSE_ONE_EURO_D_CUTOFF) * ((input(t) - st) / dt - rate);
+        st += lp_alpha(dt, 1.0 + 0.01 * fabs(rate)) * (input(t) - st);
+        out = smooth(&ac, (float)input(t), (float)dt);
+        err = fmax(err, fabs(out - st));
+    }
+    CHECK(err <= EURO_TOLERANCE);
+
+    return check_result();
+}
@@ -0,0 +1,181 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Speaker stream pacing and ADPCM encoding.
+ *
+ *	Two seconds of a 440 Hz tone at 3000 Hz go out over a socketpair.
+ *	The 0x18 reports must come 75 a second on a steady clock, and decode
+ *	back to the tone.  The output queue paces on the real clock, so the
+ *	test runs in real time.
+ */
+
+#include "check.h"
+
+#include "os.h"       /* for wiiuse_os_ticks */
+#include "outqueue.h" /* for outqueue_flush */
+#include "speaker.h"  /* for speaker_pump, SPEAKER_* */
+
+#include <math.h>       /* for sin, log10 */
+#include <sys/socket.h> /* for socketpair, recv */
+#include <unistd.h>     /* for close, usleep */
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define RATE    3000
+#define SAMPLES (2 * RATE)
+
+/**
+ *	@brief Yamaha ADPCM decoder state, undoes the encoder in speaker.c.
+ */
+struct decoder_t
+{
+    int predicted;
+    int step;
+};
+
+static int decode(struct decoder_t *d, int nibble)
+{
+    static const int diff[8]  = {1, 3, 5, 7, 9, 11, 13, 15};
+    static const int scale[8] = {230, 230, 230, 230, 307, 409, 512, 614};
+    int delta                 = d->step * diff[nibble & 7] / 8;
+
+    d->predicted += (nibble & 8) ? -delta : delta;
+    if (d->predicted > 32767)
+    {
+        d->predicted = 32767;
+    } else if (d->predicted < -32768)
+    {
+        d->predicted = -32768;
+    }
+
+    d->step = (d->step * scale[nibble & 7]) >> 8;
+    if (d->step < SPEAKER_ADPCM_STEP_MIN)
+    {
+        d->step = SPEAKER_ADPCM_STEP_MIN;
+    } else if (d->step > SPEAKER_ADPCM_STEP_MAX)
+    {
+        d->step = SPEAKER_ADPCM_STEP_MAX;
+    }
+    return d->predicted;
+}
+
+int main(void)
+{
+    struct wiimote_t **wiimotes = wiiuse_init(1);
+    struct wiimote_t *wm        = wiimotes[0];
+    static int16_t pcm[SAMPLES];
+    struct decoder_t dec       = {0, SPEAKER_ADPCM_STEP_MIN};
+    double signal              = 0.0;
+    double noise               = 0.0;
+    unsigned long start;
+    unsigned long first        = 0;
+    long max_late              = 0;
+    int reports                = 0;
+    int first_second           = 0;
+    int written                = 0;
+    int decoded                = 0;
+    unsigned long t;
+    byte buf[64];
+    int sv[2];
+    int i, n;
+
+    for (i = 0; i < SAMPLES; ++i)
+    {
+        pcm[i] = (int16_t)(12000 * sin(2 * M_PI * 440 * i / RATE));
+    }
+
+    CHECK(socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) == 0);
+    wm->in_sock = sv[0];
+    WIIMOTE_ENABLE_STATE(wm, WIIMOTE_STATE_CONNECTED);
+
+    wiiuse_set_speaker(wm, 1, RATE, 0x40);
+    CHECK(wm->speaker.rate == RATE);
+    outqueue_flush(wm);
+    while (recv(sv[1], buf, sizeof(buf), MSG_DONTWAIT) > 0)
+        ;
+
+    /* poll every millisecond for two seconds */
+    start = wiiuse_os_ticks();
+    for (t = start; t < start + 2000; t = wiiuse_os_ticks())
+    {
+        if (written < SAMPLES)
+        {
+            written += wiiuse_speaker_write(wm, pcm + written, SAMPLES - written);
+        }
+        speaker_pump(wm, t);
+
+        while ((n = recv(sv[1], buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+        {
+            CHECK(n == 3 + SPEAKER_REPORT_BYTES && buf[1] == WM_CMD_SPEAKER_DATA);
+            CHECK((buf[2] >> 3) == SPEAKER_REPORT_BYTES);
+
+            /* how far off its slot on a steady 75 Hz clock the report is */
+            if (!reports)
+            {
+                first = t;
+            } else
+            {
+                long late = (long)(t - first) - reports * SPEAKER_REPORT_SAMPLES * 1000L / RATE;
+
+                late     = (late < 0) ? -late : late;
+                max_late = (late > max_late) ? late : max_late;
+            }
+            ++reports;
+
+            for (i = 0; i < SPEAKER_REPORT_BYTES && decoded + 1 < SAMPLES; ++i, decoded += 2)
+            {
+                double a = decode(&dec, buf[3 + i] >> 4) - pcm[decoded];
+                double b = decode(&dec, buf[3 + i] & 0x0f) - pcm[decoded + 1];
+
+                noise += a * a + b * b;
+                signal += (double)pcm[decoded] * pcm[decoded] + (double)pcm[decoded + 1] * pcm[decoded + 1];
+            }
+        }
+
+        if (t < start + 1000)
+        {
+            first_second = reports;
+        }
+        usleep(1000);
+    }
+
+    /* 3000 samples a second, 40 in each report */
+    CHECK(first_second >= 74 && first_second <= 76);
+    CHECK(reports == SAMPLES / SPEAKER_REPORT_SAMPLES);
+    CHECK(decoded == SAMPLES);
+
+    /* the stream never fell far enough behind to restart its clock */
+    CHECK(max_late < SPEAKER_MAX_LATE);
+    CHECK(noise > 0.0 && 10.0 * log10(signal / noise) > 15.0);
+
+    WIIMOTE_DISABLE_STATE(wm, WIIMOTE_STATE_CONNECTED);
+    wm->in_sock = -1;
+    close(sv[0]);
+    close(sv[1]);
+    wiiuse_cleanup(wiimotes, 1);
+
+    return check_result();
+}
@@ -0,0 +1,140 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Requests that would not change the wiimote send nothing.
+ *
+ *	Every LED, rumble or report type request that the wiimote already
+ *	has must leave the socketpair empty and count in out.suppressed.
+ */
+
+#include "check.h"
+
+#include "outqueue.h" /* for outqueue_flush */
+#include "wiiuse_internal.h"
+
+#include <sys/socket.h> /* for socketpair, recv */
+#include <unistd.h>     /* for close */
+
+/**
+ *	@brief Count the reports of a type the wiimote was sent.
+ *
+ *	@param last	Set to the first payload byte of the last one.
+ */
+static int sent(struct wiimote_t *wm, int sock, byte type, byte *last)
+{
+    byte buf[32];
+    int count = 0;
+    int n;
+
+    outqueue_flush(wm);
+    while ((n = recv(sock, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+    {
+        if (n >= 3 && buf[1] == type)
+        {
+            ++count;
+            if (last)
+            {
+                *last = buf[n - 1];
+            }
+        }
+    }
+    return count;
+}
+
+int main(void)
+{
+    struct wiimote_t **wiimotes = wiiuse_init(1);
+    struct wiimote_t *wm        = wiimotes[0];
+    unsigned long suppressed;
+    byte last = 0;
+    int sv[2];
+
+    CHECK(socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) == 0);
+    wm->in_sock = sv[0];
+    WIIMOTE_ENABLE_STATE(wm, WIIMOTE_STATE_CONNECTED);
+    suppressed = wm->out.suppressed;
+
+    /* LEDs: only a change is sent, the rumble bits do not count */
+    wiiuse_set_leds(wm, WIIMOTE_LED_1);
+    CHECK(sent(wm, sv[1], WM_CMD_LED, &last) == 1 && (last & 0xF0) == WIIMOTE_LED_1);
+    wiiuse_set_leds(wm, WIIMOTE_LED_1);
+    wiiuse_set_leds(wm, WIIMOTE_LED_1 | 0x03);
+    CHECK(sent(wm, sv[1], WM_CMD_LED, NULL) == 0);
+    CHECK(wm->out.suppressed == suppressed + 2);
+    wiiuse_set_leds(wm, WIIMOTE_LED_2);
+    CHECK(sent(wm, sv[1], WM_CMD_LED, &last) == 1 && (last & 0xF0) == WIIMOTE_LED_2);
+    CHECK(wm->out.suppressed == suppressed + 2);
+
+    /* rumble: switching the motor to the state it has */
+    suppressed = wm->out.suppressed;
+    wiiuse_rumble(wm, 0);
+    CHECK(sent(wm, sv[1], WM_CMD_RUMBLE, NULL) == 0);
+    wiiuse_rumble(wm, 1);
+    CHECK(sent(wm, sv[1], WM_CMD_RUMBLE, &last) == 1 && (last & 0x01));
+    wiiuse_rumble(wm, 1);
+    CHECK(sent(wm, sv[1], WM_CMD_RUMBLE, NULL) == 0);
+    wiiuse_rumble(wm, 0);
+    CHECK(sent(wm, sv[1], WM_CMD_RUMBLE, &last) == 1 && !(last & 0x01));
+    CHECK(wm->out.suppressed == suppressed + 2);
+
+    /* report type: the same type and mode again */
+    suppressed = wm->out.suppressed;
+    CHECK(wiiuse_set_report_type(wm) == WM_RPT_BTN);
+    CHECK(sent(wm, sv[1], WM_CMD_REPORT_TYPE, &last) == 1 && last == WM_RPT_BTN);
+    CHECK(wiiuse_set_report_type(wm) == WM_RPT_BTN);
+    CHECK(sent(wm, sv[1], WM_CMD_REPORT_TYPE, NULL) == 0);
+    CHECK(wm->out.suppressed == suppressed + 1);
+
+    /* the continuous bit alone is a change */
+    WIIMOTE_ENABLE_FLAG(wm, WIIUSE_CONTINUOUS);
+    CHECK(wiiuse_set_report_type(wm) == WM_RPT_BTN);
+    CHECK(sent(wm, sv[1], WM_CMD_REPORT_TYPE, NULL) == 1);
+    CHECK(wm->out.suppressed == suppressed + 1);
+
+    /* changes made while handling input go out once, at the end of the poll */
+    suppressed = wm->out.suppressed;
+    WIIMOTE_ENABLE_STATE(wm, WIIMOTE_STATE_ACC);
+    wiiuse_defer_report_type(wm);
+    wiiuse_defer_report_type(wm);
+    wiiuse_defer_report_type(wm);
+    CHECK(sent(wm, sv[1], WM_CMD_REPORT_TYPE, NULL) == 0);
+    wiiuse_flush_output(wm);
+    CHECK(sent(wm, sv[1], WM_CMD_REPORT_TYPE, &last) == 1 && last == WM_RPT_BTN_ACC);
+    CHECK(wm->out.suppressed == suppressed + 2);
+    wiiuse_flush_output(wm);
+    CHECK(sent(wm, sv[1], WM_CMD_REPORT_TYPE, NULL) == 0);
+
+    /* a forgotten report type, as after a status report, is sent again */
+    wm->out.known &= ~WM_OUT_REPORT;
+    CHECK(wiiuse_set_report_type(wm) == WM_RPT_BTN_ACC);
+    CHECK(sent(wm, sv[1], WM_CMD_REPORT_TYPE, NULL) == 1);
+
+    WIIMOTE_DISABLE_STATE(wm, WIIMOTE_STATE_CONNECTED);
+    wm->in_sock = -1;
+    close(sv[0]);
+    close(sv[1]);
+    wiiuse_cleanup(wiimotes, 1);
+
+    return check_result();
+}
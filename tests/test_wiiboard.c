@@ -0,0 +1,157 @@
+/*
+ *	wiiuse
+ *
+ *	This file is part of wiiuse.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *	$Header$
+ *
+ */
+
+/**
+ *	@file
+ *	@brief Balance board interpolation against the divide-per-report math.
+ *
+ *	wii_board_event() multiplies by slopes computed at the handshake.
+ *	For every raw value it must give what the original division
+ *	(reference() below) gives, for sensors with different calibrations,
+ *	one of them with an empty lower segment.
+ */
+
+#include "check.h"
+
+#include "wiiboard.h" /* for wii_board_event, wii_board_update_coefficients */
+
+#include <math.h>   /* for fabsf */
+#include <string.h> /* for memset */
+
+/* kg: a Q16 kg is 1.5e-5, a float near 34 kg 4e-6; the centre of pressure is a ratio */
+#ifdef WIIUSE_FIXED_POINT
+#define TOLERANCE     5e-5f
+#define COP_TOLERANCE 1e-4f
+#else
+#define TOLERANCE     1e-5f
+#define COP_TOLERANCE 1e-5f
+#endif
+
+/**
+ *	@brief The interpolation as it was, one division per sensor and report.
+ */
+static float reference(uint16_t raw, const uint16_t cal[3])
+{
+    if (raw < cal[0])
+    {
+        return 0.0f;
+    } else if (raw < cal[1])
+    {
+        return ((float)(raw - cal[0]) * 17.0f) / (float)(cal[1] - cal[0]);
+    } else if (raw < cal[2])
+    {
+        return ((float)(raw - cal[1]) * 17.0f) / (float)(cal[2] - cal[1]) + 17.0f;
+    }
+    return 34.0f;
+}
+
+static void set_cal(uint16_t cal[3], uint16_t lo, uint16_t mid, uint16_t hi)
+{
+    cal[0] = lo;
+    cal[1] = mid;
+    cal[2] = hi;
+}
+
+/**
+ *	@brief Largest difference over every raw value of the sensors.
+ *
+ *	The raw value of sensor i is raw + i * skew, wrapped to 16 bits.
+ *	The difference of the centre of pressure, counted from 1 kg on,
+ *	is in \a cop_err.
+ */
+static float max_error(struct wii_board_t *wb, unsigned int skew, float *cop_err)
+{
+    byte msg[8];
+    float ref[4], total, err = 0.0f;
+    unsigned int raw;
+    uint16_t tl, tr, bl, br;
+
+    for (raw = 0; raw < 0x10000; ++raw)
+    {
+        tl = (uint16_t)raw;
+        tr = (uint16_t)(raw + skew);
+        bl = (uint16_t)(raw + 2 * skew);
+        br = (uint16_t)(raw + 3 * skew);
+
+        to_big_endian_uint16_t(msg, tr);
+        to_big_endian_uint16_t(msg + 2, br);
+        to_big_endian_uint16_t(msg + 4, tl);
+        to_big_endian_uint16_t(msg + 6, bl);
+        wii_board_event(wb, msg);
+
+        ref[0] = reference(tl, wb->ctl);
+        ref[1] = reference(tr, wb->ctr);
+        ref[2] = reference(bl, wb->cbl);
+        ref[3] = reference(br, wb->cbr);
+        total  = (ref[0] + ref[1]) + (ref[2] + ref[3]);
+
+        CHECK(wb->rtl == tl && wb->rtr == tr && wb->rbl == bl && wb->rbr == br);
+
+        err = fmaxf(err, fabsf(wb->tl - ref[0]));
+        err = fmaxf(err, fabsf(wb->tr - ref[1]));
+        err = fmaxf(err, fabsf(wb->bl - ref[2]));
+        err = fmaxf(err, fabsf(wb->br - ref[3]));
+        err = fmaxf(err, fabsf(wb->total - total) / 4.0f);
+
+        if (total >= 1.0f)
+        {
+            float cop_x = ((ref[1] + ref[3]) / total) * 2.0f - 1.0f;
+            float cop_y = ((ref[0] + ref[1]) / total) * 2.0f - 1.0f;
+
+            *cop_err = fmaxf(*cop_err, fabsf(wb->cop_x - cop_x));
+            *cop_err = fmaxf(*cop_err, fabsf(wb->cop_y - cop_y));
+        } else if (total == 0.0f)
+        {
+            CHECK(wb->cop_x == 0.0f && wb->cop_y == 0.0f);
+        }
+    }
+
+    return err;
+}
+
+int main(void)
+{
+    struct wii_board_t wb;
+    float cop_err = 0.0f;
+
+    memset(&wb, 0, sizeof(wb));
+    set_cal(wb.ctl, 4120, 5790, 7470);
+    set_cal(wb.ctr, 2350, 4080, 5810);
+    set_cal(wb.cbl, 17030, 18700, 20380);
+    set_cal(wb.cbr, 9000, 9000, 10700);
+    wii_board_update_coefficients(&wb);
+
+    CHECK(max_error(&wb, 0, &cop_err) <= TOLERANCE);
+    CHECK(max_error(&wb, 1237, &cop_err) <= TOLERANCE);
+
+    /* a calibration changed by the application, see wiiuse_set_wii_board_calib() */
+    set_cal(wb.ctl, 100, 65000, 65535);
+    set_cal(wb.cbr, 0, 1, 2);
+    wii_board_update_coefficients(&wb);
+
+    CHECK(max_error(&wb, 0, &cop_err) <= TOLERANCE);
+    CHECK(max_error(&wb, 4099, &cop_err) <= TOLERANCE);
+
+    CHECK(cop_err <= COP_TOLERANCE);
+
+    return check_result();
+}